@@ -0,0 +1,339 @@
+/*
+ *  linux/bench/bench.c
+ */
+
+/*
+ * 用户态微基准测试，仿照lmbench测量系统调用、进程创建、管道和文件读写的开销。
+ *
+ * 这个程序在Linux中用gcc编译，编译时用-I指向内核的include目录，系统调用直接使用内核unistd.h中
+ * 的_syscallN宏，不依赖C库是否提供了对应的函数。gettimeofday()只有滴答(10毫秒)的精度，所以每
+ * 项测试都把循环次数加倍，直到总时间超过MIN_USECS，再取平均值。
+ *
+ * 用法：bench [测试名...]      不带参数时运行全部测试
+ * 每项结果输出一行："名称 数值 单位"。
+ */
+#define __LIBRARY__
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* 与C库中的同名函数区分开 */
+#define __NR_b_getppid		__NR_getppid
+#define __NR_b_gettimeofday	__NR_gettimeofday
+#define __NR_b_sync			__NR_sync
+
+static _syscall0(int,b_getppid)
+static _syscall2(int,b_gettimeofday,struct timeval *,tv,struct timezone *,tz)
+static _syscall0(int,b_sync)
+
+#define MIN_USECS	2000000L		/* 每项测试至少运行2秒 */
+#define MAX_LOOPS	(1L << 20)
+
+#define FILE_NAME	"bench.tmp"		/* 文件读写测试用的文件，在当前目录下 */
+#define FLUSH_NAME	"bench.flush"	/* 用来把FILE_NAME挤出高速缓冲的文件 */
+#define FILE_KB		1024			/* 测试文件大小(KB) */
+#define FLUSH_KB	6144			/* 比16MB内存时的高速缓冲(约3MB)大得多 */
+#define PIPE_KB		64				/* 管道带宽测试每次传送的数据量(KB) */
+
+static char * prog;					/* 本程序的路径，execve测试用 */
+static char buf[4096];
+static struct timeval t0;
+
+static void start(void)
+{
+	b_gettimeofday(&t0, NULL);
+}
+
+/* 从start()以来经过的微秒数 */
+static long stop(void)
+{
+	struct timeval t1;
+
+	b_gettimeofday(&t1, NULL);
+	return (t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_usec - t0.tv_usec);
+}
+
+static void die(char * msg)
+{
+	perror(msg);
+	exit(1);
+}
+
+/* 重复执行fn(n)，n每次加倍，直到用时不少于MIN_USECS。返回每次循环的微秒数 */
+static double timeit(void (*fn)(long))
+{
+	long n, us;
+
+	for (n = 1; ; n <<= 1) {
+		start();
+		fn(n);
+		us = stop();
+		if (us >= MIN_USECS || n >= MAX_LOOPS) {
+			break;
+		}
+	}
+	return (double) us / n;
+}
+
+static void report(char * name, double value, char * unit)
+{
+	printf("%-16s %12.2f %s\n", name, value, unit);
+	fflush(stdout);
+}
+
+static void do_null(long n)
+{
+	while (n--) {
+		b_getppid();
+	}
+}
+
+static void do_fork(long n)
+{
+	while (n--) {
+		switch (fork()) {
+			case -1:
+				die("fork");
+			case 0:
+				_exit(0);
+			default:
+				wait(NULL);
+		}
+	}
+}
+
+static void do_exec(long n)
+{
+	static char * argv[] = { NULL, "-x", NULL };
+	static char * envp[] = { NULL };
+
+	argv[0] = prog;
+	while (n--) {
+		switch (fork()) {
+			case -1:
+				die("fork");
+			case 0:
+				execve(prog, argv, envp);
+				_exit(1);
+			default:
+				wait(NULL);
+		}
+	}
+}
+
+/* 同一进程中经过管道写一个字节再读回来，用来从往返时间中扣除管道本身的开销 */
+static void do_pipe_self(long n)
+{
+	int p[2];
+
+	if (pipe(p) < 0) {
+		die("pipe");
+	}
+	while (n--) {
+		write(p[1], buf, 1);
+		read(p[0], buf, 1);
+	}
+	close(p[0]);
+	close(p[1]);
+}
+
+/* 两个进程经过一对管道来回传递一个字节，每次往返有两次任务切换 */
+static void do_pipe_lat(long n)
+{
+	int p1[2], p2[2], pid;
+
+	if (pipe(p1) < 0 || pipe(p2) < 0) {
+		die("pipe");
+	}
+	if ((pid = fork()) < 0) {
+		die("fork");
+	}
+	if (!pid) {
+		while (read(p1[0], buf, 1) == 1) {
+			write(p2[1], buf, 1);
+		}
+		_exit(0);
+	}
+	while (n--) {
+		write(p1[1], buf, 1);
+		read(p2[0], buf, 1);
+	}
+	close(p1[1]);
+	wait(NULL);
+	close(p1[0]);
+	close(p2[0]);
+	close(p2[1]);
+}
+
+static void do_pipe_bw(long n)
+{
+	int p[2], pid, i, r;
+	long left;
+
+	if (pipe(p) < 0) {
+		die("pipe");
+	}
+	if ((pid = fork()) < 0) {
+		die("fork");
+	}
+	if (!pid) {
+		close(p[0]);
+		for (i = n * (PIPE_KB / 4); i > 0; i--) {
+			write(p[1], buf, 4096);
+		}
+		_exit(0);
+	}
+	close(p[1]);
+	for (left = n * PIPE_KB * 1024L; left > 0; left -= r) {
+		if ((r = read(p[0], buf, 4096)) <= 0) {
+			break;
+		}
+	}
+	close(p[0]);
+	wait(NULL);
+}
+
+/* 写size KB到文件name */
+static void write_file(char * name, int size)
+{
+	int fd;
+
+	if ((fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+		die(name);
+	}
+	while (size--) {
+		if (write(fd, buf, 1024) != 1024) {
+			die("write");
+		}
+	}
+	close(fd);
+}
+
+static void read_file(char * name)
+{
+	int fd;
+
+	if ((fd = open(name, O_RDONLY)) < 0) {
+		die(name);
+	}
+	while (read(fd, buf, 4096) > 0)
+		/* nothing */ ;
+	close(fd);
+}
+
+static void do_write_cached(long n)
+{
+	while (n--) {
+		write_file(FILE_NAME, FILE_KB);
+	}
+}
+
+static void do_write_sync(long n)
+{
+	while (n--) {
+		write_file(FILE_NAME, FILE_KB);
+		b_sync();
+	}
+}
+
+static void do_read_cached(long n)
+{
+	while (n--) {
+		read_file(FILE_NAME);
+	}
+}
+
+/* 以KB/s为单位报告每次循环传送kb KB数据的速度 */
+static void report_bw(char * name, double us, long kb)
+{
+	report(name, kb * 1000000.0 / us, "KB/s");
+}
+
+static void bench_null(void)
+{
+	report("null_syscall", timeit(do_null), "us");
+}
+
+static void bench_fork(void)
+{
+	report("fork_exit", timeit(do_fork), "us");
+}
+
+static void bench_exec(void)
+{
+	report("fork_execve", timeit(do_exec), "us");
+}
+
+static void bench_pipe(void)
+{
+	double self, lat;
+
+	self = timeit(do_pipe_self);
+	lat = timeit(do_pipe_lat);
+	report("pipe_latency", lat, "us");
+	report("ctx_switch", lat / 2 - self, "us");
+	report_bw("pipe_bandwidth", timeit(do_pipe_bw), PIPE_KB);
+}
+
+static void bench_file(void)
+{
+	long total;
+	int i;
+
+	report_bw("write_cached", timeit(do_write_cached), FILE_KB);
+	report_bw("write_sync", timeit(do_write_sync), FILE_KB);
+	write_file(FILE_NAME, FILE_KB);
+	report_bw("read_cached", timeit(do_read_cached), FILE_KB);
+	/* 先读一遍大文件把测试文件挤出高速缓冲，只计读测试文件的时间 */
+	write_file(FLUSH_NAME, FLUSH_KB);
+	b_sync();
+	for (i = 0, total = 0; i < 8 && total < MIN_USECS; i++) {
+		read_file(FLUSH_NAME);
+		start();
+		read_file(FILE_NAME);
+		total += stop();
+	}
+	report_bw("read_uncached", (double) total / i, FILE_KB);
+	unlink(FLUSH_NAME);
+	unlink(FILE_NAME);
+}
+
+static struct {
+	char * name;
+	void (*fn)(void);
+} tests[] = {
+	{ "null", bench_null },
+	{ "fork", bench_fork },
+	{ "exec", bench_exec },
+	{ "pipe", bench_pipe },
+	{ "file", bench_file },
+	{ NULL, NULL }
+};
+
+int main(int argc, char ** argv)
+{
+	int i, j;
+
+	/* execve测试中被执行的子进程 */
+	if (argc == 2 && !strcmp(argv[1], "-x")) {
+		return 0;
+	}
+	prog = argv[0];
+	for (i = 0; tests[i].name; i++) {
+		if (argc == 1) {
+			tests[i].fn();
+			continue;
+		}
+		for (j = 1; j < argc; j++) {
+			if (!strcmp(argv[j], tests[i].name)) {
+				tests[i].fn();
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ *  linux/bench/kprofdump.c
+ */
+
+/*
+ * 控制内核态采样，并把采样结果写到文件中，供主机上的tools/kprof按函数汇总。
+ *
+ * 用法：kprofdump start [粒度]     开始采样，粒度是每个计数器覆盖字节数的对数，默认为4
+ *       kprofdump stop | free      停止采样；free同时释放内核中的计数器数组
+ *       kprofdump read 文件名      把kprof_header和计数器数组原样写到文件中
+ * 需要超级用户运行。
+ */
+#define __LIBRARY__
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/profile.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_BYTES	(sizeof(struct kprof_header) + 128 * 1024)	/* 计数器数组最多128KB */
+
+_syscall3(int,kprof,int,cmd,char *,buf,int,arg)
+
+static char buf[MAX_BYTES];
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: kprofdump start [shift] | stop | free | read file\n");
+	exit(1);
+}
+
+static void check(int r)
+{
+	if (r < 0) {
+		perror("kprof");
+		exit(1);
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	int fd, n;
+
+	if (argc < 2) {
+		usage();
+	}
+	if (!strcmp(argv[1], "start") && argc <= 3) {
+		check(kprof(KPROF_START, NULL, argc == 3 ? atoi(argv[2]) : 4));
+	} else if (!strcmp(argv[1], "stop") && argc == 2) {
+		check(kprof(KPROF_STOP, NULL, 0));
+	} else if (!strcmp(argv[1], "free") && argc == 2) {
+		check(kprof(KPROF_FREE, NULL, 0));
+	} else if (!strcmp(argv[1], "read") && argc == 3) {
+		check(n = kprof(KPROF_READ, buf, MAX_BYTES));
+		if ((fd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+			perror(argv[2]);
+			return 1;
+		}
+		if (write(fd, buf, n) != n) {
+			perror(argv[2]);
+			return 1;
+		}
+		close(fd);
+		printf("%d samples, %d bytes written to %s\n",
+			(int) ((struct kprof_header *) buf)->samples, n, argv[2]);
+	} else {
+		usage();
+	}
+	return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ *  linux/bench/sctop.c
+ */
+
+/*
+ * 按耗时排列系统调用，类似top。数据来自scstat()系统调用(include/sys/scstat.h)。
+ *
+ * 用法：sctop [-p pid] [间隔秒数]
+ *       sctop -on | -off | -reset
+ * 第一种只读取统计：不给间隔时打印开始统计以来的累计值；给出间隔时每隔这么多秒刷新一次屏幕，显
+ * 示这段时间内的调用次数和耗时。-p只看指定进程，否则看全系统。
+ * 第二种(需超级用户)打开、关闭统计或把统计清零。统计本身有开销，测量性能时应该关闭它。
+ */
+#define __LIBRARY__
+#include <unistd.h>
+#include <errno.h>
+#include <sys/scstat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NR_LINES	20			/* 最多显示的行数 */
+
+_syscall3(int,scstat,int,cmd,int,pid,struct sc_stat *,buf)
+
+/* 系统调用名，下标是include/unistd.h中的调用号 */
+static char * names[] = {
+	"setup", "exit", "fork", "read", "write", "open", "close", "waitpid", "creat",
+	"link", "unlink", "execve", "chdir", "time", "mknod", "chmod", "chown",
+	"break", "stat", "lseek", "getpid", "mount", "umount", "setuid", "getuid",
+	"stime", "ptrace", "alarm", "fstat", "pause", "utime", "stty", "gtty",
+	"access", "nice", "ftime", "sync", "kill", "rename", "mkdir", "rmdir", "dup",
+	"pipe", "times", "prof", "brk", "setgid", "getgid", "signal", "geteuid",
+	"getegid", "acct", "phys", "lock", "ioctl", "fcntl", "mpx", "setpgid",
+	"ulimit", "uname", "umask", "chroot", "ustat", "dup2", "getppid", "getpgrp",
+	"setsid", "sigaction", "sgetmask", "ssetmask", "setreuid", "setregid",
+	"sigsuspend", "sigpending", "sethostname", "setrlimit", "getrlimit",
+	"getrusage", "gettimeofday", "settimeofday", "getgroups", "setgroups",
+	"select", "symlink", "lstat", "readlink", "uselib", "bufstat", "bdflush",
+	"epoll_create", "epoll_ctl", "epoll_wait", "kprof", "scstat"
+};
+
+#define NR_NAMES	(sizeof(names) / sizeof(char *))
+
+static struct sc_stat prev[NR_SCSTAT], cur[NR_SCSTAT];
+
+struct line {
+	int nr;
+	unsigned long count;
+	unsigned long errors;
+	double cycles;
+};
+
+static struct line lines[NR_SCSTAT];
+
+static struct {
+	char * opt;
+	int cmd;
+} cmds[] = {
+	{ "-on", SCSTAT_ON },
+	{ "-off", SCSTAT_OFF },
+	{ "-reset", SCSTAT_RESET }
+};
+
+static double cycles_of(struct sc_stat * s)
+{
+	return s->cycles_hi * 4294967296.0 + s->cycles_lo;
+}
+
+static void read_stat(int pid, struct sc_stat * buf)
+{
+	int n;
+
+	if ((n = scstat(SCSTAT_READ, pid, buf)) < 0) {
+		perror("scstat");
+		exit(1);
+	}
+	if (!n) {
+		memset(buf, 0, sizeof(struct sc_stat) * NR_SCSTAT);
+	}
+}
+
+static int by_cycles(const void * a, const void * b)
+{
+	const struct line * x = a, * y = b;
+
+	return x->cycles < y->cycles ? 1 : x->cycles > y->cycles ? -1 : 0;
+}
+
+/* 显示cur与old之差，old为NULL时显示cur本身 */
+static void show(int pid, struct sc_stat * old, int secs)
+{
+	double total = 0;
+	unsigned long calls = 0;
+	int i, n = 0;
+
+	for (i = 0; i < NR_SCSTAT; i++) {
+		lines[n].nr = i;
+		lines[n].count = cur[i].count - (old ? old[i].count : 0);
+		lines[n].errors = cur[i].errors - (old ? old[i].errors : 0);
+		lines[n].cycles = cycles_of(cur + i) - (old ? cycles_of(old + i) : 0);
+		if (lines[n].count) {
+			total += lines[n].cycles;
+			calls += lines[n].count;
+			n++;
+		}
+	}
+	qsort(lines, n, sizeof(struct line), by_cycles);
+	if (secs) {
+		printf("\033[H\033[J%s %d   %lu calls in %d s\n\n", pid ? "pid" : "system", pid,
+			calls, secs);
+	} else {
+		printf("%s %d   %lu calls\n\n", pid ? "pid" : "system", pid, calls);
+	}
+	printf("  nr name            calls   errors    avg cycles    max cycles  time%%\n");
+	for (i = 0; i < n && i < NR_LINES; i++) {
+		printf("%4d %-12s %8lu %8lu %13.0f %13lu %5.1f\n", lines[i].nr,
+			lines[i].nr < NR_NAMES ? names[lines[i].nr] : "?",
+			lines[i].count, lines[i].errors, lines[i].cycles / lines[i].count,
+			cur[lines[i].nr].max, total > 0 ? 100 * lines[i].cycles / total : 0.0);
+	}
+	fflush(stdout);
+}
+
+int main(int argc, char ** argv)
+{
+	int i = 1, pid = 0, secs = 0;
+
+	for (i = 0; argc == 2 && i < sizeof(cmds) / sizeof(cmds[0]); i++) {
+		if (!strcmp(argv[1], cmds[i].opt)) {
+			if (scstat(cmds[i].cmd, 0, NULL) < 0) {
+				perror("scstat");
+				return 1;
+			}
+			return 0;
+		}
+	}
+	i = 1;
+	if (i + 1 < argc && !strcmp(argv[i], "-p")) {
+		pid = atoi(argv[i + 1]);
+		i += 2;
+	}
+	if (i < argc) {
+		secs = atoi(argv[i++]);
+	}
+	if (i != argc || secs < 0) {
+		fprintf(stderr, "usage: sctop [-p pid] [seconds]\n"
+			"       sctop -on | -off | -reset\n");
+		return 1;
+	}
+	read_stat(pid, cur);
+	if (!secs) {
+		show(pid, NULL, 0);
+		return 0;
+	}
+	while (1) {
+		memcpy(prev, cur, sizeof(cur));
+		sleep(secs);
+		read_stat(pid, cur);
+		show(pid, prev, secs);
+	}
+}
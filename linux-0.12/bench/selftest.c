@@ -0,0 +1,112 @@
+/*
+ *  linux/bench/selftest.c
+ */
+
+/*
+ * 内核定时相关的回归测试，与bench.c一样在Linux中编译运行(见rc.bench)。
+ *
+ * 用法：selftest      每项测试输出一行"名称 ok"或"名称 FAIL ..."，有失败时退出码为1。
+ */
+#define __LIBRARY__
+#include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* select()的参数超过3个，系统调用只传递指向参数块的指针 */
+#define __NR_t_select		__NR_select
+#define __NR_t_gettimeofday	__NR_gettimeofday
+
+static _syscall1(int,t_select,unsigned long *,args)
+static _syscall2(int,t_gettimeofday,struct timeval *,tv,struct timezone *,tz)
+
+#define WAIT_USECS	300000L		/* 等待30个滴答 */
+
+static int failed = 0;
+
+static void result(char * name, int ok, char * why)
+{
+	if (ok) {
+		printf("%-16s ok\n", name);
+	} else {
+		printf("%-16s FAIL %s\n", name, why);
+		failed = 1;
+	}
+	fflush(stdout);
+}
+
+/* 不带描述符的select()，tv为NULL时一直等待，否则等待tv指定的时间 */
+static int select_wait(struct timeval * tv)
+{
+	unsigned long args[5];
+
+	args[0] = args[1] = args[2] = args[3] = 0;
+	args[4] = (unsigned long) tv;
+	return t_select(args);
+}
+
+static long elapsed(struct timeval * t0)
+{
+	struct timeval t1;
+
+	t_gettimeofday(&t1, NULL);
+	return (t1.tv_sec - t0->tv_sec) * 1000000L + (t1.tv_usec - t0->tv_usec);
+}
+
+/* 有时限的select()应在到时后返回0，且不早于规定的时间(允许1个滴答的误差) */
+static void test_select_timeout(void)
+{
+	struct timeval t0, tv;
+	int r;
+
+	tv.tv_sec = 0;
+	tv.tv_usec = WAIT_USECS;
+	t_gettimeofday(&t0, NULL);
+	r = select_wait(&tv);
+	result("select_timeout", r == 0 && elapsed(&t0) >= WAIT_USECS - 10000, "returned early");
+}
+
+/*
+ * 子进程执行fn()一直等待。父进程等待几十个滴答后子进程应该仍在等待，然后用SIGKILL结束它。
+ */
+static void test_forever(char * name, void (*fn)(void))
+{
+	struct timeval tv;
+	int pid, r;
+
+	if ((pid = fork()) < 0) {
+		result(name, 0, "fork");
+		return;
+	}
+	if (!pid) {
+		fn();
+		_exit(0);				/* 不应该返回 */
+	}
+	tv.tv_sec = 0;
+	tv.tv_usec = WAIT_USECS;
+	select_wait(&tv);
+	r = waitpid(pid, NULL, WNOHANG);
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	result(name, r == 0, "wait returned");
+}
+
+static void select_forever(void)
+{
+	select_wait(NULL);
+}
+
+static void pause_forever(void)
+{
+	pause();
+}
+
+int main(void)
+{
+	test_select_timeout();
+	test_forever("select_forever", select_forever);
+	test_forever("pause_forever", pause_forever);
+	return failed;
+}
@@ -55,33 +55,142 @@
 			:"0" (0), "r" (nr), "m" (*(addr))); 						\
 		res;})
 
-/**
- * 从addr开始寻找第1个0值位
- * 输入：%0 - ecx（返回值）；%1 - ecx(0)；%2 - esi（addr）
- * 在addr指定地址开始的位图中寻找第1个是0的位，并将其距离addr的位偏移值返回。addr是缓冲块数据区
- * 的地址，扫描寻找的范围是1024字节(8192位)。
- * BSFL指令用于扫描EAX首个非0比特位，并将该比特位偏移值放入EDX中
- * @param[in]	addr	指定地址
- * @retval		返回第一个0值位距离addr的位偏移值
- */
-#define find_first_zero(addr) ({ 										\
+/* 返回w中最低的1值位的位号，w不能为0 */
+#define first_set_bit(w) ({ 											\
 	int __res; 															\
-	__asm__(															\
-			"cld\n"						/*清 方向位 */					 \	
-		"1:\tlodsl\n\t"					/* 取[esi]->eax */				\
-			"notl %%eax\n\t"            /* eax中每位取反 */    			 \
-			"bsfl %%eax, %%edx\n\t"		/* 从位0扫描eax中是1的第1个位，其偏移值->edx */ \
-			"je 2f\n\t"					/* 如果eax中全是0，则向前跳转到标号2处 */	   	\
-			"addl %%edx, %%ecx\n\t"		/* 偏移值加入ecx（ecx是位图首个0值位的偏移值）*/ \
-			"jmp 3f\n"					/* 向前跳转到标号3处（结束） */				   \
-		"2:\taddl $32, %%ecx\n\t"		/* 未找到0值位，则将ecx加1个长字的位偏移量32 */	 \
-			"cmpl $8192, %%ecx\n\t"		/* 已经扫描了8192比特位（1024字节）了吗？ */	\
-			"jl 1b\n"					/* 若还没有扫描完1块数据，则向前跳转到标号1处 */  \
-		"3:"							/* 结束。此时ecx中是位偏移量 */				   \
-		:"=c" (__res)													\
-		:"c" (0), "S" (addr)); 											\
+	__asm__("bsfl %1, %0" : "=r" (__res) : "rm" (w)); 					\
 	__res;})
 
+/**
+ * 从位图addr的第nr位开始寻找第1个0值位
+ * 只在[nr, limit)范围内查找，limit不超过8192(一个1024字节的位图块)。按长字扫描，已满的长字
+ * 一次跳过32位。
+ * @param[in]	addr	位图块数据区地址
+ * @param[in]	nr		起始位号
+ * @param[in]	limit	位图中有效位数
+ * @retval		找到的0值位的位号，没有则返回limit
+ */
+static int find_next_zero(char * addr, int nr, int limit)
+{
+	unsigned long * p;
+	unsigned long w;
+
+	if (nr >= limit) {
+		return limit;
+	}
+	p = (unsigned long *) addr + (nr >> 5);
+	w = ~*p & (~0UL << (nr & 31));
+	nr &= ~31;
+	while (!w) {
+		if ((nr += 32) >= limit) {
+			return limit;
+		}
+		w = ~*++p;
+	}
+	nr += first_set_bit(w);
+	return nr < limit ? nr : limit;
+}
+
+/**
+ * 统计位图addr前limit位中0值位的个数
+ * @param[in]	addr	位图块数据区地址
+ * @param[in]	limit	位图中有效位数(不超过8192)
+ * @retval		0值位的个数
+ */
+static int count_free(char * addr, int limit)
+{
+	unsigned long * p = (unsigned long *) addr;
+	unsigned long w;
+	int nr, free = 0;
+
+	for (nr = 0 ; nr < limit ; nr += 32) {
+		w = ~*p++;
+		if (limit - nr < 32) {
+			w &= (1UL << (limit - nr)) - 1;
+		}
+		for ( ; w ; w &= w - 1) {
+			free++;
+		}
+	}
+	return free;
+}
+
+/* 逻辑块位图和i节点位图中的有效位数。逻辑块位图的第j位对应逻辑块j+s_firstdatazone-1，
+ i节点位图的第j位对应i节点j，两者的第0位都不使用(在read_super()中置位) */
+#define zmap_bits(sb)	((sb)->s_nzones - (sb)->s_firstdatazone + 1)
+#define imap_bits(sb)	((sb)->s_ninodes + 1)
+
+/* 第i个位图块中有效位数 */
+static inline int map_limit(int nbits, int i)
+{
+	nbits -= i << 13;
+	if (nbits <= 0) {
+		return 0;
+	}
+	return nbits < 8192 ? nbits : 8192;
+}
+
+/**
+ * 从位号goal开始，在位图块map[0..nr_map-1]中寻找一个0值位
+ * 先在goal所在的位图块中向后找，然后依次查看后续各块(到末尾后绕回第0块)，最后回到goal所在块
+ * 的开头。空闲位数free[i]为0的块直接跳过，因此在几乎已满的文件系统上也不必逐块扫描。
+ * @param[in]	map		位图块缓冲头指针数组
+ * @param[in]	free	各位图块中的空闲位数
+ * @param[in]	nr_map	位图块数
+ * @param[in]	nbits	位图中有效位数
+ * @param[in]	goal	开始查找的位号
+ * @retval		找到的位号，没有空闲位则返回-1
+ */
+static int find_free_bit(struct buffer_head ** map, unsigned short * free,
+	int nr_map, int nbits, int goal)
+{
+	int i, j, n, k, limit;
+
+	if (goal <= 0 || goal >= nbits) {
+		goal = 1;
+	}
+	i = goal >> 13;
+	j = goal & 8191;
+	if (i >= nr_map) {
+		i = j = 0;
+	}
+	for (n = 0 ; n <= nr_map ; n++, j = 0) {
+		if (free[i] && map[i]) {
+			limit = map_limit(nbits, i);
+			if ((k = find_next_zero(map[i]->b_data, j, limit)) < limit) {
+				return k + (i << 13);
+			}
+		}
+		if (++i >= nr_map) {
+			i = 0;
+		}
+	}
+	return -1;
+}
+
+/**
+ * 初始化超级块中的分配提示
+ * 统计每个i节点位图块和逻辑块位图块中的空闲位数，并把分配起点设为位图开头。在read_super()
+ * 读入位图之后调用。
+ * @param[in]	sb		超级块指针
+ * @retval		void
+ */
+void init_bitmap_hints(struct super_block * sb)
+{
+	int i;
+
+	for (i = 0 ; i < I_MAP_SLOTS ; i++) {
+		sb->s_imap_free[i] = sb->s_imap[i] ?
+			count_free(sb->s_imap[i]->b_data, map_limit(imap_bits(sb), i)) : 0;
+	}
+	for (i = 0 ; i < Z_MAP_SLOTS ; i++) {
+		sb->s_zmap_free[i] = sb->s_zmap[i] ?
+			count_free(sb->s_zmap[i]->b_data, map_limit(zmap_bits(sb), i)) : 0;
+	}
+	sb->s_inode_hint = 1;
+	sb->s_zone_hint = 1;
+}
+
 /**
  * 释放设备dev上数据区中的逻辑块block
  * 复位指定逻辑块block对应的逻辑块位图比特位。
@@ -134,6 +243,8 @@ int free_block(int dev, int block)
 	if (clear_bit(block & 8191, sb->s_zmap[block/8192]->b_data)) {
 		printk("block (%04x:%d) ", dev, block + sb->s_firstdatazone - 1);
 		printk("free_block: bit already cleared\n");
+	} else {
+		sb->s_zmap_free[block/8192]++;
 	}
 	/* 最后置相应逻辑块位图所在缓冲区的已修改标志 */
 	sb->s_zmap[block/8192]->b_dirt = 1;
@@ -142,56 +253,48 @@ int free_block(int dev, int block)
 
 /**
  * 向设备dev申请一个逻辑块
- * 函数首先取得设备的超级块，并在逻辑块位图中寻找第一个0值比特位（代表一个空闲逻辑块）。然后设置该比特位，
+ * 函数首先取得设备的超级块，从逻辑块goal开始在逻辑块位图中寻找第一个0值比特位（代表一个空闲逻辑块），
+ * 使文件的逻辑块在盘上尽量连续。goal无效（例如为0）时从上次分配的位置开始找。然后设置该比特位，
  * 表示期望得到对应的逻辑块。接着为该逻辑块在缓冲区取得一块对应缓冲块。最后将该缓冲块清零，并设置其已更新
  * 标志和已修改标志，并返回逻辑块号。函数执行成功则返回逻辑块号（盘快号），否则返回0
  * @param[in]	dev		设备号
+ * @param[in]	goal	希望分配的逻辑块号
  * @retval		成功返回逻辑块号，失败返回0。
  */
-int new_block(int dev)
+int new_block(int dev, int goal)
 {
 	struct buffer_head * bh;
 	struct super_block * sb;
 	int i, j;
 
-	/*
-	 * 首先获取设备dev的超级块。然后扫描文件系统的8块逻辑块位图，寻找首个0值比特位，以寻找空闲逻辑块，获取
-	 * 放置该逻辑块的块号。如果全部扫描完8块逻辑块位图的所有比特位（i>=8或j>=8192）还没找到0值比特位或者
-	 * 所在的缓冲块指针无效（bh=NULL）则返回0退出（没有空闲逻辑块）
-	 */
 	if (!(sb = get_super(dev))) {
 		panic("trying to get new block from nonexistant device");
 	}
-	/* 扫描文件系统的8块逻辑块位图，寻找首个0值位，以寻找空闲逻辑块，获取设置该逻辑块的块号 */
-	j = 8192;
-	for (i = 0 ; i < 8 ; i++) {
-		if ((bh = sb->s_zmap[i])) {
-			if ((j = find_first_zero(bh->b_data)) < 8192) {
-				break;
-			}
-		}
+	/* 把goal换算成逻辑块位图中的位号，在位图中寻找空闲位。找不到则表示当前没有空闲逻辑块 */
+	if (goal >= sb->s_firstdatazone && goal < sb->s_nzones) {
+		goal -= sb->s_firstdatazone - 1;
+	} else {
+		goal = sb->s_zone_hint;
 	}
-	/* 然后如果全部扫描完8块逻辑块位图的所有位还没有找到0值位或者位图所在的缓冲块指针无效
-	 (bn = NULL)则表示当前没有空闲逻辑块 */
-	if (i >= 8 || !bh || j >= 8192) {
+	if ((j = find_free_bit(sb->s_zmap, sb->s_zmap_free, sb->s_zmap_blocks,
+			zmap_bits(sb), goal)) < 0) {
 		return 0;
 	}
 	/* 设置找到的新逻辑块j对应逻辑块位图中的位，若对应位已经置位，则出错停机 */
 	/*
-	 * 否则置存放位图的对应缓冲区块已修改标志。因为逻辑块位图仅表示盘上数据区中逻辑块的占用情况，
-	 * 即逻辑块位图中比特位偏移值表示从数据区开始处算起的块号，因此这里需要加上数据区第1个逻辑块
-	 * 的块号，把j转换成逻辑块号。如果新逻辑块大于该设备上的总逻辑块数，则说明指定逻辑块在对应设备
-	 * 上不存在。申请失败，返回0退出
+	 * 否则置存放位图的对应缓冲区块已修改标志，并更新该位图块的空闲位数和下次分配的起点。因为逻辑块位图
+	 * 仅表示盘上数据区中逻辑块的占用情况，即逻辑块位图中比特位偏移值表示从数据区开始处算起的块号，因此
+	 * 这里需要加上数据区第1个逻辑块的块号，把j转换成逻辑块号。
 	 */
-	if (set_bit(j, bh->b_data)) {
+	i = j >> 13;
+	bh = sb->s_zmap[i];
+	if (set_bit(j & 8191, bh->b_data)) {
 		panic("new_block: bit already set");
 	}
 	bh->b_dirt = 1;
-	/* 计算该块在逻辑块位图中位偏移值，偏移值大于该设备上的总逻辑块数，则出错 */
-	j += i * 8192 + sb->s_firstdatazone - 1;
-	if (j >= sb->s_nzones) {
-		return 0;
-	}
+	sb->s_zmap_free[i]--;
+	sb->s_zone_hint = j;
+	j += sb->s_firstdatazone - 1;
 	/* 在高速缓冲区中为该设备上指定的逻辑块号取得一个缓冲块，并返回缓冲块头指针 */
 	/* 
 	 * 因为刚取得的逻辑块其引用次数一定为1（getblk()中会设置），因此若不为1则停机。最后 
@@ -236,7 +339,7 @@ void free_inode(struct m_inode * inode)
 	}
 	/* i节点上的设备号字段为0,说明该节点没有使用 */
 	if (!inode->i_dev) {
-		memset(inode, 0, sizeof(*inode));
+		clear_inode(inode);
 		return;
 	}
 	/* 如果此i节点还有其他程序引用，则不释放，说明内核有问题，停机 */ 
@@ -268,10 +371,12 @@ void free_inode(struct m_inode * inode)
 	/* 如果该比特位已经等于0，则显示出错警告信息。最后置i节点位图所在缓冲区已修改标志，并清空该i节点结构所占内存区 */
 	if (clear_bit(inode->i_num & 8191, bh->b_data)) {
 		printk("free_inode: bit already cleared.\n\r");
+	} else {
+		sb->s_imap_free[inode->i_num >> 13]++;
 	}
 	/* 置i节点位图所在缓冲区已修改标志，并清空该i节点结构所占内存区 */
 	bh->b_dirt = 1;
-	memset(inode, 0, sizeof(*inode));
+	clear_inode(inode);
 }
 
 /**
@@ -295,27 +400,21 @@ struct m_inode * new_inode(int dev)
 	if (!(sb = get_super(dev))) {
 		panic("new_inode with unknown device");
 	}
-	/*扫描超级块中8块i节点位图，寻找第1个0位(空闲节点)，获取并设置该i节点的节点号。*/
-	j = 8192;
-	for (i = 0 ; i < 8 ; i++) {
-		if ((bh = sb->s_imap[i])) {
-			if ((j = find_first_zero(bh->b_data)) < 8192) {
-				break;
-			}
-		}
-	}
-	/* 如果全部扫描完还没找到空闲i节点或者位图所在的缓冲块无效(bh = NULL)，则放回先前申请的i节
-	 点表中的i节点，并返回空指针退出 */
-	if (!bh || j >= 8192 || j + i * 8192 > sb->s_ninodes) {
+	/* 从上次分配的i节点号开始在i节点位图中寻找空闲位(空闲i节点)，获取并设置该i节点的节点号。*/
+	if ((j = find_free_bit(sb->s_imap, sb->s_imap_free, sb->s_imap_blocks,
+			imap_bits(sb), sb->s_inode_hint)) < 0) {
 		iput(inode);
 		return NULL;
 	}
-	/* 现在已经找到了还未使用的i节点号j。于是置位i节点j对应的i节点位图相应比特位。然后置i节点位
-	 图所在缓冲块已修改标志 */
-	if (set_bit(j, bh->b_data)) {
+	/* 置位i节点j对应的i节点位图相应比特位。然后置i节点位图所在缓冲块已修改标志 */
+	i = j >> 13;
+	bh = sb->s_imap[i];
+	if (set_bit(j & 8191, bh->b_data)) {
 		panic("new_inode: bit already set");
 	}
 	bh->b_dirt = 1;
+	sb->s_imap_free[i]--;
+	sb->s_inode_hint = j;
 	/* 初始化该i节点结构 */
 	inode->i_count = 1;				/* 引用计数 */
 	inode->i_nlinks = 1;			/* 文件目录项链接数 */
@@ -323,7 +422,8 @@ struct m_inode * new_inode(int dev)
 	inode->i_uid = current->euid;	/* i节点所属用户id */
 	inode->i_gid = current->egid;	/* 组id */
 	inode->i_dirt = 1;				/* 已修改标志置位 */
-	inode->i_num = j + i * 8192;	/* 对应设备中的i节点号 */
+	inode->i_num = j;				/* 对应设备中的i节点号 */
+	insert_inode_hash(inode);
 	inode->i_mtime = inode->i_atime = inode->i_ctime = CURRENT_TIME;	/* 设置时间 */
 	return inode;					/* 返回该i节点指针 */
 }
@@ -85,9 +85,8 @@ int block_write(int dev, long * pos, char * buf, int count)
 		*pos += chars;
 		written += chars;					/* 累计写入字节数 */
 		count -= chars;
-		while (chars-- > 0) {
-			*(p++) = get_fs_byte(buf++);
-		}
+		copy_from_user(p, buf, chars);
+		buf += chars;
 		bh->b_dirt = 1;
 		brelse(bh);
 	}
@@ -152,9 +151,8 @@ int block_read(int dev, unsigned long * pos, char * buf, int count)
 		*pos += chars;
 		read += chars;			/* 累计读入字节数 */
 		count -= chars;
-		while (chars-->0) {
-			put_fs_byte(*(p++), buf++);
-		}
+		copy_to_user(buf, p, chars);
+		buf += chars;
 		brelse(bh);
 	}
 	return read;				/* 返回已读取的字节数，正常退出 */
@@ -28,14 +28,20 @@
  * 要使已更换软盘缓冲失效。
  */
 
+#include <errno.h>			/* 错误号头文件。包含系统中各种出错号 */
+#include <string.h>			/* 字符串头文件。定义了一些有关字符串操作的嵌入函数 */
 #include <stdarg.h>			/* 标准参数头文件。以宏的形式定义变量参数列表。主要说明了一个类型（va_list）和三个宏va_stat、va_arg和va_end，用于vsprintf、vprintf、vfprintf函数 */
 
 #include <linux/config.h>	/* 内核配置头文件。定义键盘语言和硬盘类型（HD_TYPE）选项 */
 #include <linux/sched.h>	/* 调度程序头文件。定义了任务结构task_struct、任务0的数据，还有一些有关描述符参数设置和获取的嵌入式汇编函数宏语句 */
 #include <linux/kernel.h>	/* 内核头文件。含有一些内核常用函数的原型定义 */
 #include <linux/fs.h>
+#include <linux/trace.h>	/* 事件跟踪头文件 */
 #include <asm/system.h>		/* 系统头文件。定义了设置或修改描述符/中断门等的嵌入式汇编宏 */
 #include <asm/io.h>			/* io头文件。定义硬件端口输入/输出宏汇编语句 */
+#include <asm/segment.h>	/* 段操作头文件。定义了有关段寄存器操作的嵌入式汇编函数 */
+#include <sys/bufstat.h>	/* 高速缓冲区统计信息结构 */
+#include <sys/bdflush.h>	/* 回写任务参数编号 */
 
 // buffer_wait变量是等待空闲缓冲块而睡眠的任务队列头指针。它与缓冲块头部结构中b_wait指针的作用
 // 不同。当任务申请一个缓冲块而正好遇到系统缺乏可用空闲缓冲块时，当前任务就会被添加到buffer_wait
@@ -51,15 +57,47 @@ extern int end;
 /* 高速缓冲区开始于内核代码末端位置 */
 struct buffer_head *start_buffer = (struct buffer_head *) &end;
 
-/* 缓冲区Hash表数组，NR_HASH=307项 */
-struct buffer_head *hash_table[NR_HASH];
+/*
+ * 缓冲区Hash表。表的大小在buffer_init()中根据缓冲块数确定，取2的幂，表本身放在缓冲头数组之前。
+ * hash_bits是表大小的位数，nr_hash = 1 << hash_bits。
+ */
+#define MIN_HASH_BITS	8			/* hash表最少256项 */
+#define MAX_HASH_BITS	14			/* hash表最多16384项 */
+
+struct buffer_head **hash_table;
+static int nr_hash = 0;
+static int hash_bits = 0;
+
+/* Hash表查找统计：查找次数、遍历的链表项数以及命中次数，由sys_bufstat()读出 */
+static unsigned long hash_lookups = 0;
+static unsigned long hash_probes = 0;
+static unsigned long hash_hits = 0;
+
+/*
+ * 缓冲块替换链表头指针，按BUF_CLEAN/BUF_LOCKED/BUF_DIRTY分开。每个链表都是双向循环链表，
+ * 链表头同时充当CLOCK算法的"指针"：扫描时前移链表头，新插入的缓冲块放在链表头之前(即最后才
+ * 会被扫描到)，从而得到近似LRU的替换顺序。
+ */
+static struct buffer_head *lru_list[NR_LIST] = { NULL, NULL, NULL };
 
-/* 空闲缓冲块链表头指针 */
-static struct buffer_head *free_list;
+/* 各替换链表上的缓冲块数 */
+int nr_buffers_type[NR_LIST] = { 0, 0, 0 };
 
 /* 等待空闲缓冲块而睡眠的任务队列 */
 static struct task_struct *buffer_wait = NULL;
 
+/*
+ * 缓冲区回写任务(bdflush)的参数，以BDF_*为索引，可由sys_bdflush()调整：
+ * 唤醒间隔、脏块在写盘前最多保留的时间、触发强制回写的脏块比例(占缓冲块总数的百分比)
+ * 以及每一批最多写盘的块数。
+ */
+static int bdf_prm[BDF_NR_PARAM] = { 5 * HZ, 30 * HZ, 40, 64 };
+static int bdf_min[BDF_NR_PARAM] = { HZ / 10, HZ / 10, 1, 1 };
+static int bdf_max[BDF_NR_PARAM] = { 600 * HZ, 600 * HZ, 100, BDF_MAX_BATCH };
+
+/* 回写任务在两次回写之间睡眠的等待队列 */
+static struct task_struct *bdflush_wait = NULL;
+
 /* 
  * 下面定义系统缓冲区中含有的缓冲块个数。这里，NR_BUFFERS是一个定义在linux/fs.h头文件的常量符号，被定义为变量nr_buffers，而变量在fs.h文件被声明为全局变量。大写名称 
  * 通常都是一个宏名称，Linus先生这样编写代码是为了利用这个大写名称来隐含地表示nr_buffers是一个在内核高速缓冲区初始化之后不再改变的“常量”。它将在初始化函数buffer_init()中被设置
@@ -244,16 +282,88 @@ void check_disk_change(int dev)
 	invalidate_buffers(dev);
 }
 
-// hash队列是双向链表结构，空闲缓冲块队列是双向循环链表结构。
+// hash队列是双向链表结构，替换链表是双向循环链表结构。
 //
 // hash表的主要作用是减少查找比较元素所花费的时间。通过在元素的存储位置与关键字之间建立一个对应
-// 关系(hash函数)，我们就可以直接通过函数计算立刻查询到指定的元素。建立函数的方法有多种，这里，
-// Linux0.12主要采用了关键字除余数法。因为我们寻找的缓冲块有两个条件，即设备号dev和缓冲块号
-// block，因此设计的hash函数肯定需要包含这两个关键值。这里两个关键字的异或操作只是计算关键值的
-// 一种方法。再对关键值进行MOD运算就可以保证函数计算得到的值都处于函数数组项范围内。
-#define _hashfn(dev, block) (((unsigned)(dev ^ block)) % NR_HASH)
+// 关系(hash函数)，我们就可以直接通过函数计算立刻查询到指定的元素。因为我们寻找的缓冲块有两个条
+// 件，即设备号dev和缓冲块号block，因此设计的hash函数肯定需要包含这两个关键值。这里把设备号放在
+// 高16位与块号组合成关键值，再采用乘法散列：乘以黄金分割常数2^32*0.618后取乘积的高hash_bits位。
+// 同一设备上连续的块号会被均匀地打散到各项中，并且不需要除法运算。
+#define HASH_MULTIPLIER		0x9E3779B1U
+#define _hashfn(dev, block) \
+	(((((unsigned)(dev) << 16) ^ (unsigned)(block)) * HASH_MULTIPLIER) >> (32 - hash_bits))
 #define hash(dev, block) 	hash_table[_hashfn(dev, block)]
 
+/* 根据缓冲块当前的锁定、修改标志得出它应当所在的替换链表 */
+#define buffer_list_type(bh) \
+	((bh)->b_lock ? BUF_LOCKED : ((bh)->b_dirt ? BUF_DIRTY : BUF_CLEAN))
+
+/**
+ * 从缓冲块所在的替换链表中移除缓冲块
+ * @param[in]	bh		要移除的缓冲区头指针
+ * @retval 		void
+ */
+static inline void remove_from_lru_list(struct buffer_head * bh)
+{
+	if (!(bh->b_prev_free) || !(bh->b_next_free)) {
+		panic("Free block list corrupted");
+	}
+	bh->b_prev_free->b_next_free = bh->b_next_free;
+	bh->b_next_free->b_prev_free = bh->b_prev_free;
+	/* 如果链表头指向本缓冲区，则让其指向下一缓冲区；若本缓冲区是链表中唯一一项则链表变空 */
+	if (lru_list[bh->b_list] == bh) {
+		lru_list[bh->b_list] = bh->b_next_free;
+	}
+	if (lru_list[bh->b_list] == bh) {
+		lru_list[bh->b_list] = NULL;
+	}
+	bh->b_next_free = bh->b_prev_free = NULL;
+	nr_buffers_type[bh->b_list]--;
+}
+
+/**
+ * 将缓冲块插入指定替换链表的末尾(即链表头之前)
+ * @param[in]	bh		要插入的缓冲区头指针
+ * @param[in]	list	链表类型
+ * @retval 		void
+ */
+static inline void insert_into_lru_list(struct buffer_head * bh, int list)
+{
+	struct buffer_head * head = lru_list[list];
+
+	bh->b_list = list;
+	nr_buffers_type[list]++;
+	if (list == BUF_DIRTY) {
+		bh->b_flushtime = jiffies + bdf_prm[BDF_AGE];
+	}
+	if (!head) {
+		lru_list[list] = bh->b_next_free = bh->b_prev_free = bh;
+		return;
+	}
+	bh->b_next_free = head;
+	bh->b_prev_free = head->b_prev_free;
+	head->b_prev_free->b_next_free = bh;
+	head->b_prev_free = bh;
+}
+
+/**
+ * 将缓冲块移到与其当前状态相符的替换链表中
+ * b_dirt和b_lock在很多地方被直接修改(包括中断处理程序)，因此链表归属只是一种提示，
+ * 在brelse()以及getblk()扫描链表时再修正。
+ * @param[in]	bh		缓冲区头指针
+ * @retval 		void
+ */
+static inline void refile_buffer(struct buffer_head * bh)
+{
+	int list = buffer_list_type(bh);
+
+	if (bh->b_list == list) {
+		return;
+	}
+	remove_from_lru_list(bh);
+	insert_into_lru_list(bh, list);
+}
+
 /**
  * 从hash队列和空闲缓冲队列中移走缓冲块。
  * @param[in]	bh		要移除的缓冲区头指针
@@ -274,31 +384,20 @@ static inline void remove_from_queues(struct buffer_head * bh)
 		hash(bh->b_dev,bh->b_blocknr) = bh->b_next;
 	}
 	/* remove from free list */
-	/* 从空闲缓冲块表中移除缓冲块 */
-	if (!(bh->b_prev_free) || !(bh->b_next_free)) {
-		panic("Free block list corrupted");
-	}
-	bh->b_prev_free->b_next_free = bh->b_next_free;
-	bh->b_next_free->b_prev_free = bh->b_prev_free;
-	/* 如果空闲链表头指向本缓冲区，则让其指向下一缓冲区 */
-	if (free_list == bh) {
-		free_list = bh->b_next_free;
-	}
+	/* 从所在的替换链表中移除缓冲块 */
+	remove_from_lru_list(bh);
 }
 
 /**
- * 将缓冲块插入空闲链表尾部，同时放入hash队列中
+ * 将缓冲块插入替换链表尾部，同时放入hash队列中
  * @param[in]	bh		要插入的缓冲区头指针
  * @retval 		void
  */
 static inline void insert_into_queues(struct buffer_head * bh)
 {
 	/* put at end of free list */
-	/* 放在空闲链表末尾处 */
-	bh->b_next_free = free_list;
-	bh->b_prev_free = free_list->b_prev_free;
-	free_list->b_prev_free->b_next_free = bh;
-	free_list->b_prev_free = bh;
+	/* 按缓冲块当前状态放在对应替换链表的末尾处 */
+	insert_into_lru_list(bh, buffer_list_type(bh));
 	/* put the buffer in new hash-queue if it has a device */
 	/* 如果该缓冲块对应一个设备,则将其插入新hash队列中 */
 	/*
@@ -330,8 +429,11 @@ static struct buffer_head * find_buffer(int dev, int block)
 	struct buffer_head * tmp;
 
 	/* 搜索hash表，寻找指定设备和块号的缓冲块 */
+	hash_lookups++;
 	for (tmp = hash(dev, block); tmp != NULL; tmp = tmp->b_next) {
+		hash_probes++;
 		if (tmp->b_dev == dev && tmp->b_blocknr == block) {
+			hash_hits++;
 			return tmp;
 		}
 	}
@@ -371,6 +473,7 @@ struct buffer_head * get_hash_table(int dev, int block)
 		 * 并返回缓冲块头指针。如果在睡眠时该缓冲块的设备号或快号发生了改变，则撤销对它的引用计数，重新寻找
 		 */
 		bh->b_count ++;
+		bh->b_ref = 1;			/* 命中，置CLOCK访问位 */
 		wait_on_buffer(bh);
 		if (bh->b_dev == dev && bh->b_blocknr == block) {
 			return bh;
@@ -401,81 +504,170 @@ struct buffer_head * get_hash_table(int dev, int block)
  *
  * 算法已经作了改变：希望能更好，而且一个难以琢磨的错误已经去除。
  */
-/* 下面宏用于同时判断缓冲块的修改标志和锁定标志，并定义修改标志的权重要比锁定标志大 */
-#define BADNESS(bh) (((bh)->b_dirt << 1) + (bh)->b_lock)
+/*
+ * 为了让缓存未命中时挑选替换块的代价不随缓冲块总数增长，缓冲块按状态分挂在干净、上锁、脏
+ * 三个链表上，替换时只在干净链表上做CLOCK(第二次机会)
+ * 扫描：被引用过的块清除访问位后放过一次，碰到状态已经改变的块就顺便把它移到正确的链表中。
+ * 干净链表中没有可用块时，才去回收已完成I/O的上锁块，或者成批地把脏块写盘。
+ */
+#define NR_FLUSH_BUFFERS	16		/* 找不到干净块时一次最多启动写盘的脏块数 */
+
+/**
+ * 在干净链表和上锁链表中挑选一个可替换的缓冲块
+ * 本函数不会睡眠，因此返回的缓冲块一定没有被占用、没有上锁并且是干净的。
+ * @retval		可替换的缓冲块头指针，没有则返回NULL
+ */
+static struct buffer_head * get_free_buffer(void)
+{
+	struct buffer_head * bh;
+	int n;
+
+	/* 扫描两圈干净链表：第一圈清除访问位，第二圈一定能找到未被引用的块(若存在) */
+	n = nr_buffers_type[BUF_CLEAN] << 1;
+	while (n-- > 0 && (bh = lru_list[BUF_CLEAN])) {
+		lru_list[BUF_CLEAN] = bh->b_next_free;		/* 前移CLOCK指针 */
+		if (bh->b_lock || bh->b_dirt) {
+			refile_buffer(bh);
+			continue;
+		}
+		if (bh->b_count) {
+			continue;
+		}
+		if (bh->b_ref) {
+			bh->b_ref = 0;
+			continue;
+		}
+		return bh;
+	}
+	/* 上锁链表中I/O已经结束的块可以重新归类，其中干净的块可直接使用 */
+	n = nr_buffers_type[BUF_LOCKED];
+	while (n-- > 0 && (bh = lru_list[BUF_LOCKED])) {
+		lru_list[BUF_LOCKED] = bh->b_next_free;
+		if (bh->b_lock) {
+			continue;
+		}
+		refile_buffer(bh);
+		if (!bh->b_count && !bh->b_dirt) {
+			return bh;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * 成批地为脏块启动写盘操作
+ * 从脏链表头部(最早变脏的一端)开始挑选最多nr个未上锁的脏块，all为0时只挑选已经超过写盘时刻
+ * b_flushtime的块。选出的块按设备号和块号排序后再依次交给ll_rw_block()，使请求项以递增的
+ * 块号进入设备队列，便于合并和电梯调度。挑选期间顺便把状态已改变的块移到正确的链表中。
+ * @param[in]	nr		最多写盘的缓冲块数(不超过BDF_MAX_BATCH)
+ * @param[in]	all		非0则不考虑脏块的时间
+ * @retval		启动写盘的缓冲块数
+ */
+static int flush_dirty_buffers(int nr, int all)
+{
+	struct buffer_head * batch[BDF_MAX_BATCH];
+	struct buffer_head * bh, * next;
+	int i, j, n, count = 0, written = 0;
+
+	if (nr > BDF_MAX_BATCH) {
+		nr = BDF_MAX_BATCH;
+	}
+	n = nr_buffers_type[BUF_DIRTY];
+	bh = lru_list[BUF_DIRTY];
+	for ( ; n-- > 0 && bh && count < nr ; bh = next) {
+		next = bh->b_next_free;
+		if (bh->b_lock || !bh->b_dirt) {
+			refile_buffer(bh);
+			continue;
+		}
+		if (!all && (long) (jiffies - bh->b_flushtime) < 0) {
+			continue;
+		}
+		bh->b_count++;			/* 写盘时可能睡眠，先占住该块，防止被挪作它用 */
+		/* 插入排序，batch[]按(设备号,块号)递增 */
+		for (i = count++; i > 0; i--) {
+			if (batch[i-1]->b_dev < bh->b_dev ||
+			    (batch[i-1]->b_dev == bh->b_dev &&
+			     batch[i-1]->b_blocknr < bh->b_blocknr)) {
+				break;
+			}
+			batch[i] = batch[i-1];
+		}
+		batch[i] = bh;
+	}
+	/* ll_rw_block()可能不写(设备没有请求处理函数，或块已被锁定)，只统计真正启动了写盘的块 */
+	for (j = 0; j < count; j++) {
+		bh = batch[j];
+		ll_rw_block(WRITE, bh);
+		if (bh->b_lock || !bh->b_dirt) {
+			written++;
+		}
+		bh->b_count--;
+		refile_buffer(bh);
+	}
+	return written;
+}
+
+/* 脏块数是否超过了bdf_prm[BDF_NFRACT]规定的比例 */
+#define too_many_dirty() \
+	(nr_buffers_type[BUF_DIRTY] * 100 > bdf_prm[BDF_NFRACT] * NR_BUFFERS)
+
+/**
+ * 缓冲区回写任务
+ * 由kernel_thread()创建的内核任务执行，永不返回。每隔bdf_prm[BDF_INTERVAL]个滴答醒来一次，
+ * 先把内存中修改过的i节点写入缓冲区，再把已超过保留时间的脏块写盘；如果脏块数超过规定的比例
+ * (brelse()发现这种情况时也会立即唤醒本任务)，就不论时间地一批批写盘，直到回到比例之下。一批中
+ * 没有块能写盘时就不再重试，等下次醒来，以免在内核态空转。
+ * 本任务不处理信号，发给它的信号直接丢弃。
+ * @retval		void
+ */
+void bdflush_thread(void)
+{
+	for (;;) {
+		current->signal = 0;
+		sync_inodes();
+		while (flush_dirty_buffers(bdf_prm[BDF_NDIRTY], 0) == bdf_prm[BDF_NDIRTY])
+			/* nothing */ ;
+		while (too_many_dirty() && flush_dirty_buffers(bdf_prm[BDF_NDIRTY], 1))
+			/* nothing */ ;
+		current->timeout = jiffies + bdf_prm[BDF_INTERVAL];
+		interruptible_sleep_on(&bdflush_wait);
+		current->timeout = 0;
+	}
+}
 
 /**
  * 取高速缓冲中指定的缓冲块
  * 检查指定(设备号和块号)的缓冲区是否已经在高速缓冲中。如果指定块已经在高速缓冲中，则返回对应缓
  * 冲区头指针退出；如果不在，就需要在高速中中设置一个对应设备号和块号的新项。返回相应缓冲区头指
  * 针
- * @note 		在这里，每次进程执行过wait_on_buffer()睡眠等待，唤醒后需要重新判断等待的缓冲
- *				块是否符合条件。
+ * @note 		在这里，每次进程执行过睡眠等待，唤醒后都要从头重新查找。
  * @param[in] 	dev		设备号
  * @param[in] 	block 	块号
  * @retval	 	对应缓冲区头指针
  */
 struct buffer_head * getblk(int dev, int block)
 {
-	struct buffer_head *tmp, *bh;
+	struct buffer_head * bh;
 
 repeat:
 	/* 搜索hash表，如果指定块已经在高速缓冲中，则返回对应缓冲块的头指针，退出 */
 	if ((bh = get_hash_table(dev, block))) {
+		trace(TRACE_GETBLK, dev, block, 1);
 		return bh;
 	}
-	/* 否则就扫描空闲数据块链表，寻找空闲缓冲块。 */
-	/* 首先让tmp指向空闲链表的第一个空闲缓冲块头，然后执行下面循环中的操作 */
-	tmp = free_list;
-	do {
-		/*
-		 * 如果缓冲块正被使用（引用计数不等于0），则继续扫描下一项。对于b_count=0的块，即高速缓冲中当前没有引用的块不一定就是干净的（b_dirt=0）或没有锁定的（b_lock=0）。
-		 * 因此，我们还是需要继续下面的判断和选择。例如对于一个b_count=0的块，当一个任务改写过一块内容后就释放了，则该块b_count仍会为0，但是b_lock不等于0；当一个任务执行
-		 * breada()预读几个块时，只要ll_rw_block()调用过后，它就会递减b_count；但此时实际上硬盘访问操作可能还在进行，因此此时b_lock=1，但b_count=0
-		 */
-		if (tmp->b_count) {
-			continue;
-		}
-		/*
-		 * 如果缓冲头指针bh为空，或者tmp所指缓冲头的标志（修改、锁定）权重小于bh头标志的权重，则让bh指向tmp缓冲块头。如果该tmp缓冲块头表明缓冲块既没有修改也没有锁定标志置位
-		 * （即BADNESS()=0），则说明已为指定设备上的块取得对应的高速缓冲块，则退出循环。否则我们就继续执行本循环，看看能否找到一个BADNESS()值最小的缓冲块
-		 */
-		if (!bh || BADNESS(tmp) < BADNESS(bh)) {
-			bh = tmp;
-			if (!BADNESS(tmp)) {
-				break;
-			}
-		}
-	/* and repeat until we find something good */
-	/* 重复操作直到找到适合的缓冲块 */
-	} while ((tmp = tmp->b_next_free) != free_list);
 	/*
-	 * 如果循环检查发现所有缓冲块都正在被使用（所有缓冲块的头部引用计数都>0）中，则睡眠等待有空闲缓冲块可用。当有空闲缓冲块可用时本进程会被明确地唤醒。
-	 * 然后我们就跳转到函数开始处重新查找空闲缓冲块
+	 * 挑选可替换的缓冲块。如果没有干净块可用，就成批地把脏块写盘，并等待最早开始I/O的块解锁；
+	 * 如果连脏块也没有(所有块都正被使用)，则睡眠等待有缓冲块被释放。睡眠醒来后指定块可能已经
+	 * 被其他进程加入高速缓冲，因此要从头开始重新查找
 	 */
-	if (!bh) {
-		sleep_on(&buffer_wait);
-		goto repeat;
-	}
-	/* 执行到这里，说明我们已经找到了一个比较合适的空闲缓冲块了。于是先等待该缓冲区解锁（如果已被上锁的话）。如果在我们睡眠阶段该缓冲块又被其他任务使用的话，只好又重复上述寻找过程 */
-	wait_on_buffer(bh);
-	if (bh->b_count) {		/* 又被占用 */
-		goto repeat;
-	}
-	/* 如果该缓冲区已被修改，则将数据写盘，并再次等待缓冲区解锁。同样地，若该缓冲区又被其他任务使用的话，只好再重复上述寻找过程 */
-	while (bh->b_dirt) {
-		sync_dev(bh->b_dev);
-		wait_on_buffer(bh);
-		if (bh->b_count) {		/* 又被占用 */
-			goto repeat;
+	if (!(bh = get_free_buffer())) {
+		flush_dirty_buffers(NR_FLUSH_BUFFERS, 1);
+		if (lru_list[BUF_LOCKED]) {
+			wait_on_buffer(lru_list[BUF_LOCKED]);
+		} else {
+			sleep_on(&buffer_wait);
 		}
-	}
-	/* NOTE!! While we slept waiting for this block, somebody else might */
-	/* already have added "this" block to the cache. check it */
-	/* 注意！当进程为了等待该缓冲块而睡眠时，其他进程可能已经将该缓冲块加入进高速缓冲中，所以我
-	 们也要对此进行检查。 */
-	/* 在hash表中检查指定的缓冲块是否趁我们睡眠之际已经被加入进去。如果是的话，就再次重复上述寻找过程 */
-	if (find_buffer(dev, block)) {
 		goto repeat;
 	}
 	/* OK, FINALLY we know that this buffer is the only one of it's kind, */
@@ -486,12 +678,14 @@ repeat:
 	bh->b_count = 1;
 	bh->b_dirt = 0;
 	bh->b_uptodate = 0;
-	/* 从hash队列和空闲块链表中移出该缓冲头，让该缓冲区用于指定块。然后根据此新设备号和块号重新
-	 插入空闲链表和hash队列新位置处，并最终返回缓冲头指针。*/
+	bh->b_ref = 0;
+	/* 从hash队列和替换链表中移出该缓冲头，让该缓冲区用于指定块。然后根据此新设备号和块号重新
+	 插入替换链表末尾和hash队列新位置处，并最终返回缓冲头指针。*/
 	remove_from_queues(bh);
 	bh->b_dev = dev;
 	bh->b_blocknr = block;
 	insert_into_queues(bh);
+	trace(TRACE_GETBLK, dev, block, 0);
 	return bh;
 }
 
@@ -510,7 +704,11 @@ void brelse(struct buffer_head * buf)
 	if (!(buf->b_count--)) {
 		panic("Trying to free free buffer");
 	}
+	refile_buffer(buf);		/* 使用者可能已修改该块，按新状态重新归类 */
 	wake_up(&buffer_wait);
+	if (buf->b_list == BUF_DIRTY && too_many_dirty()) {
+		wake_up(&bdflush_wait);
+	}
 }
 
 /*
@@ -690,7 +888,7 @@ struct buffer_head * breada(int dev, int first, ...)
  */
 void buffer_init(long buffer_end)
 {
-	struct buffer_head * h = start_buffer;
+	struct buffer_head * h;
 	void * b;
 	int i;
 	/* 跳过640KB~1MB的内存空间，该段空间被显示内存和BIOS占用 */
@@ -704,6 +902,21 @@ void buffer_init(long buffer_end)
 	else {
 		b = (void *) buffer_end;
 	}
+	/*
+	 * 按可用内存粗略估算缓冲块数，据此确定hash表的大小：取不小于缓冲块数一半的2的幂(平均链长不超过
+	 * 2)，并限制在[MIN_HASH_BITS, MAX_HASH_BITS]之间。hash表占用缓冲头数组起始处的内存，缓冲头
+	 * 从表的末端开始存放
+	 */
+	i = ((long) b - (long) start_buffer) / (BLOCK_SIZE + sizeof(struct buffer_head));
+	for (hash_bits = MIN_HASH_BITS; hash_bits < MAX_HASH_BITS; hash_bits++) {
+		if ((1 << hash_bits) >= (i >> 1)) {
+			break;
+		}
+	}
+	nr_hash = 1 << hash_bits;
+	hash_table = (struct buffer_head **) start_buffer;
+	start_buffer = (struct buffer_head *) (hash_table + nr_hash);
+	h = start_buffer;
 	/*
 	 * 下面这段代码用于初始化高速缓冲区，建立空闲缓冲块循环链表，并获取系统中缓冲块数目。操作的过程是从缓冲区高端开始划分1KB大小的缓冲块，与此同时在缓冲区底端建立描述该缓冲块
 	 * 的结构buffer_head，并将这些buffer_head组成双向链表
@@ -716,9 +929,12 @@ void buffer_init(long buffer_end)
 		h->b_count = 0;		/* 缓冲块引用计数 */
 		h->b_lock = 0;		/* 缓冲块锁定标志 */
 		h->b_uptodate = 0;	/* 缓冲块更新标志（或称数据有效标志） */
+		h->b_list = BUF_CLEAN;	/* 初始时所有缓冲块都在干净链表上 */
+		h->b_ref = 0;		/* CLOCK访问位 */
 		h->b_wait = NULL;	/* 指向等待该缓冲块解锁的进程 */
 		h->b_next = NULL;	/* 指向具有相同hash值的下一个缓冲头 */
 		h->b_prev = NULL;	/* 指向具有相同hash值的前一个缓冲头 */
+		h->b_reqnext = NULL;	/* 指向同一请求项中的下一个缓冲头 */
 		h->b_data = (char *) b;	/* 指向对应缓冲块数据块（1024字节） */
 		/* 以下两句形成双向链表 */
 		h->b_prev_free = h - 1;	/* 指向链表中前一项 */
@@ -730,15 +946,103 @@ void buffer_init(long buffer_end)
 			b = (void *) 0xA0000;	/* 让b指向0xA0000(640KB)处 */
 	}
 	/*
-	 * 然后让h指向最后一个缓冲块头，让空闲链表头指向头一个缓冲块头；链表头的b_prev_free指向前一项（即最后一项）；h的下一项指针指向第一项，从而让空闲链表形成双向环形结构。
+	 * 然后让h指向最后一个缓冲块头，让干净链表头指向头一个缓冲块头；链表头的b_prev_free指向前一项（即最后一项）；h的下一项指针指向第一项，从而让干净链表形成双向环形结构。
 	 * 最后初始化hash表，置表中所有指针为NULL
 	 */
 	h --;						/* 让h指向最后一个有效缓冲块头 */
-	free_list = start_buffer;	/* 让空闲链表头指向头一个缓冲块 */
-	free_list->b_prev_free = h; /* 链表头的b_prev_free指向前一项(即最后一项) */
-	h->b_next_free = free_list; /* 表尾指向表头，形成环形双向链表 */
+	lru_list[BUF_CLEAN] = start_buffer;	/* 让干净链表头指向头一个缓冲块 */
+	lru_list[BUF_CLEAN]->b_prev_free = h;	/* 链表头的b_prev_free指向前一项(即最后一项) */
+	h->b_next_free = lru_list[BUF_CLEAN];	/* 表尾指向表头，形成环形双向链表 */
+	nr_buffers_type[BUF_CLEAN] = NR_BUFFERS;
 	/* 初始化hash表 */
-	for (i = 0; i < NR_HASH; i++) {
+	for (i = 0; i < nr_hash; i++) {
 		hash_table[i]=NULL;
 	}
 }	
+
+/**
+ * 读取高速缓冲区统计信息
+ * 返回缓冲块数、hash表大小、各替换链表上的缓冲块数、hash查找统计，以及hash表链长分布：
+ * bs_chain[i]为链长等于i的hash表项数，链长不小于BS_NR_CHAIN-1的表项都计入最后一项。
+ * @param[out]	buf		用户空间中的bufstat结构
+ * @retval		成功返回0，参数无效返回-EINVAL
+ */
+int sys_bufstat(struct bufstat * buf)
+{
+	struct bufstat st;
+	struct buffer_head * bh;
+	unsigned long *lp, *lpend, *dest;
+	int i, len;
+
+	if (!buf) {
+		return -EINVAL;
+	}
+	verify_area(buf, sizeof *buf);
+	memset((char *) &st, 0, sizeof(st));
+	st.bs_nr_buffers = NR_BUFFERS;
+	st.bs_nr_hash = nr_hash;
+	st.bs_nr_clean = nr_buffers_type[BUF_CLEAN];
+	st.bs_nr_locked = nr_buffers_type[BUF_LOCKED];
+	st.bs_nr_dirty = nr_buffers_type[BUF_DIRTY];
+	st.bs_lookups = hash_lookups;
+	st.bs_probes = hash_probes;
+	st.bs_hits = hash_hits;
+	for (i = 0; i < nr_hash; i++) {
+		for (len = 0, bh = hash_table[i]; bh; bh = bh->b_next) {
+			len++;
+		}
+		if (len >= BS_NR_CHAIN) {
+			len = BS_NR_CHAIN - 1;
+		}
+		st.bs_chain[len]++;
+		if (len > st.bs_max_chain) {
+			st.bs_max_chain = len;
+		}
+	}
+	lp = (unsigned long *) &st;
+	lpend = (unsigned long *) (&st + 1);
+	dest = (unsigned long *) buf;
+	for (; lp < lpend; lp++, dest++) {
+		put_fs_long(*lp, dest);
+	}
+	return 0;
+}
+
+/**
+ * 读取或设置缓冲区回写任务的参数
+ * func为BDF_GET(i)时把第i个参数写入用户空间中data所指的long；func为BDF_SET(i)时把第i个参数
+ * 设置为data，只有超级用户可以执行，并且data必须在该参数的允许范围内。func为BDF_FLUSH时立即
+ * 对所有已超时的脏块执行一遍回写。参数编号i见include/sys/bdflush.h。
+ * @param[in]	func	功能号
+ * @param[in]	data	参数值或用户空间中存放参数值的地址
+ * @retval		成功返回0(BDF_FLUSH返回启动写盘的块数)，失败返回错误号
+ */
+int sys_bdflush(int func, long data)
+{
+	int i;
+
+	if (func == BDF_FLUSH) {
+		return flush_dirty_buffers(BDF_MAX_BATCH, 0);
+	}
+	if (func < BDF_GET(0)) {
+		return -EINVAL;
+	}
+	i = (func - BDF_GET(0)) >> 1;
+	if (i >= BDF_NR_PARAM) {
+		return -EINVAL;
+	}
+	if (func == BDF_GET(i)) {
+		verify_area((void *) data, sizeof(long));
+		put_fs_long(bdf_prm[i], (unsigned long *) data);
+		return 0;
+	}
+	if (!suser()) {
+		return -EPERM;
+	}
+	if (data < bdf_min[i] || data > bdf_max[i]) {
+		return -EINVAL;
+	}
+	bdf_prm[i] = data;
+	wake_up(&bdflush_wait);		/* 让新的参数立即生效 */
+	return 0;
+}
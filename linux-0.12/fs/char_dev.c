@@ -9,6 +9,7 @@
 
 #include <linux/sched.h>	/* 调度程序头文件。定义了任务结构task_struct、任务0的数据等 */
 #include <linux/kernel.h>	/* 内核头文件。含有一些内核常用函数的原型定义 */
+#include <linux/trace.h>	/* 事件跟踪头文件 */
 
 #include <asm/segment.h>	/* 段操作头文件。定义了有关段寄存器操作的嵌入式汇编函数 */
 #include <asm/io.h>			/* io头文件。定义硬件端口输入/输出宏汇编语句 */
@@ -106,7 +107,7 @@ static int rw_port(int rw, char * buf, int count, off_t * pos)
 
 /**
  * 内存读写操作函数
- * 内存主设备号是1，这里仅给出0-5子设备的处理
+ * 内存主设备号是1，这里仅给出0-6子设备的处理
  * @param[in]	rw		读写命令
  * @param[in]	buf		缓冲区
  * @param[in]	count	读写字节数
@@ -126,6 +127,8 @@ static int rw_memory(int rw, unsigned minor, char * buf, int count, off_t * pos)
 			return (rw == READ) ? 0 : count;	/* rw_null */
 		case 4:		/* /dev/port */
 			return rw_port(rw, buf, count, pos);
+		case 6:		/* /dev/trace */
+			return (rw == READ) ? trace_read(buf, count) : trace_write(buf, count);
 		default:
 			return -EIO;
 	}
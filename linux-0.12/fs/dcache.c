@@ -0,0 +1,246 @@
+/*
+ *  linux/fs/dcache.c
+ */
+
+/*
+ * 目录项缓存。以(设备号, 目录i节点号, 文件名)为键，记住find_entry()的查找结果：找到的目录项
+ * 在哪个逻辑块的第几项以及它的i节点号，或者该名字在目录中不存在(负目录项，i节点号为0)。命中负
+ * 目录项时不必读任何目录块；命中正目录项时只需读入那一个块，find_entry()还会核对块中的目录项，
+ * 因此缓存内容过时只会导致一次未命中，不会返回错误的结果。负目录项则必须在目录中添加名字时清除，
+ * 这由add_entry()负责。add_entry()同时递增目录的i_dgen，find_entry()据此判断它睡眠期间目录中
+ * 是否添加过名字。
+ *
+ * 所有函数都不会睡眠，所以不需要加锁。调用者给出的文件名在用户空间中(fs段)，与match()相同，
+ * 各函数先把它复制到内核栈上再处理。
+ */
+#include <string.h>			/* 字符串头文件。这里使用了其中的memcmp()和memcpy() */
+
+#include <linux/sched.h>	/* 调度程序头文件。定义了任务结构task_struct、任务0数据等 */
+#include <linux/kernel.h>	/* 内核头文件。含有一些内核常用函数的原型定义 */
+#include <asm/segment.h>	/* 段操作头文件。定义了有关段寄存器操作的嵌入式汇编函数 */
+
+#define NR_DCACHE	128		/* 缓存项数 */
+#define NR_DHASH	64		/* hash表项数(2的幂) */
+
+struct dcache_entry {
+	unsigned short d_dev;					/* 目录所在设备号，0表示空闲 */
+	unsigned short d_dir;					/* 目录i节点号 */
+	unsigned short d_ino;					/* 目录项的i节点号，0表示负目录项 */
+	unsigned short d_block;					/* 目录项所在的逻辑块号 */
+	unsigned short d_entry;					/* 目录项在块中的序号 */
+	unsigned char d_len;					/* 文件名长度 */
+	char d_name[NAME_LEN];					/* 文件名 */
+	struct dcache_entry * d_next;			/* hash队列上的后一项 */
+	struct dcache_entry * d_prev_lru;		/* LRU链表上的前一项 */
+	struct dcache_entry * d_next_lru;		/* LRU链表上的后一项 */
+};
+
+static struct dcache_entry dcache[NR_DCACHE];
+static struct dcache_entry * dhash[NR_DHASH];
+static struct dcache_entry * lru_head = NULL;	/* 最久未使用的一项，替换从这里开始 */
+
+/* 把用户空间中长度为len的文件名复制到内核中的buf */
+static void get_dname(char * buf, const char * name, int len)
+{
+	while (len-- > 0) {
+		*buf++ = get_fs_byte(name++);
+	}
+}
+
+/**
+ * 计算缓存项所在的hash表项
+ * @param[in]	dev		设备号
+ * @param[in]	dir		目录i节点号
+ * @param[in]	name	文件名(内核空间)
+ * @param[in]	len		文件名长度
+ * @retval		hash表项指针
+ */
+static struct dcache_entry ** dhashfn(int dev, int dir, const char * name, int len)
+{
+	unsigned long h = (dev << 16) ^ dir;
+
+	while (len-- > 0) {
+		h = (h << 5) + h + (unsigned char) *name++;
+	}
+	return dhash + ((h ^ (h >> 10)) & (NR_DHASH - 1));
+}
+
+/* 在hash队列中查找缓存项(name在内核空间)，返回指向它的指针的地址，便于删除 */
+static struct dcache_entry ** find_dentry(int dev, int dir, const char * name, int len)
+{
+	struct dcache_entry ** p, * d;
+
+	for (p = dhashfn(dev, dir, name, len); (d = *p); p = &d->d_next) {
+		if (d->d_dev == dev && d->d_dir == dir && d->d_len == len &&
+		    !memcmp(d->d_name, name, len)) {
+			return p;
+		}
+	}
+	return NULL;
+}
+
+// 把缓存项移到LRU链表末尾(最近使用的一端).
+static void touch_entry(struct dcache_entry * d)
+{
+	if (d == lru_head) {
+		lru_head = d->d_next_lru;
+		return;
+	}
+	d->d_prev_lru->d_next_lru = d->d_next_lru;
+	d->d_next_lru->d_prev_lru = d->d_prev_lru;
+	d->d_next_lru = lru_head;
+	d->d_prev_lru = lru_head->d_prev_lru;
+	lru_head->d_prev_lru->d_next_lru = d;
+	lru_head->d_prev_lru = d;
+}
+
+// 从hash队列中取下缓存项(*p == d)并把它移到LRU链表头部,使它最先被重用.
+static void remove_entry(struct dcache_entry ** p, struct dcache_entry * d)
+{
+	*p = d->d_next;
+	d->d_next = NULL;
+	d->d_dev = 0;
+	touch_entry(d);
+	lru_head = d;
+}
+
+/**
+ * 在目录项缓存中查找
+ * @param[in]	dir		目录i节点
+ * @param[in]	name	文件名(用户空间)
+ * @param[in]	len		文件名长度
+ * @param[out]	block	正目录项所在的逻辑块号
+ * @param[out]	entry	正目录项在块中的序号
+ * @retval		命中正目录项返回其i节点号，命中负目录项返回0，未命中返回-1
+ */
+int dcache_lookup(struct m_inode * dir, const char * name, int len,
+	int * block, int * entry)
+{
+	struct dcache_entry ** p, * d;
+	char buf[NAME_LEN];
+
+	if (!len || len > NAME_LEN) {
+		return -1;
+	}
+	get_dname(buf, name, len);
+	if (!(p = find_dentry(dir->i_dev, dir->i_num, buf, len))) {
+		return -1;
+	}
+	d = *p;
+	touch_entry(d);
+	*block = d->d_block;
+	*entry = d->d_entry;
+	return d->d_ino;
+}
+
+/**
+ * 加入或更新一个缓存项
+ * 新的缓存项取自LRU链表头部，它要么空闲，要么是最久未使用的。
+ * @param[in]	dir		目录i节点
+ * @param[in]	name	文件名(用户空间)
+ * @param[in]	len		文件名长度
+ * @param[in]	ino		目录项的i节点号，0表示名字不存在
+ * @param[in]	block	目录项所在的逻辑块号
+ * @param[in]	entry	目录项在块中的序号
+ * @retval		void
+ */
+void dcache_add(struct m_inode * dir, const char * name, int len,
+	int ino, int block, int entry)
+{
+	struct dcache_entry ** p, * d;
+	char buf[NAME_LEN];
+
+	if (!len || len > NAME_LEN) {
+		return;
+	}
+	get_dname(buf, name, len);
+	if ((p = find_dentry(dir->i_dev, dir->i_num, buf, len))) {
+		d = *p;
+	} else {
+		d = lru_head;
+		if (d->d_dev) {
+			p = find_dentry(d->d_dev, d->d_dir, d->d_name, d->d_len);
+			remove_entry(p, d);
+		}
+		d->d_dev = dir->i_dev;
+		d->d_dir = dir->i_num;
+		d->d_len = len;
+		memcpy(d->d_name, buf, len);
+		p = dhashfn(dir->i_dev, dir->i_num, buf, len);
+		d->d_next = *p;
+		*p = d;
+	}
+	d->d_ino = ino;
+	d->d_block = block;
+	d->d_entry = entry;
+	touch_entry(d);
+}
+
+/**
+ * 删除一个缓存项
+ * 在目录中添加或删除名字时调用。
+ * @param[in]	dir		目录i节点
+ * @param[in]	name	文件名(用户空间)
+ * @param[in]	len		文件名长度
+ * @retval		void
+ */
+void dcache_remove(struct m_inode * dir, const char * name, int len)
+{
+	struct dcache_entry ** p;
+	char buf[NAME_LEN];
+
+	if (len > NAME_LEN) {
+		len = NAME_LEN;
+	}
+	if (!len) {
+		return;
+	}
+	get_dname(buf, name, len);
+	if ((p = find_dentry(dir->i_dev, dir->i_num, buf, len))) {
+		remove_entry(p, *p);
+	}
+}
+
+/**
+ * 删除某个目录或某个设备上的所有缓存项
+ * 目录被删除(其i节点号可能被重用)或者文件系统被卸载时调用。
+ * @param[in]	dev		设备号
+ * @param[in]	dir		目录i节点号，0表示该设备上的所有目录
+ * @retval		void
+ */
+void dcache_invalidate(int dev, int dir)
+{
+	struct dcache_entry ** p;
+	int i;
+
+	for (i = 0; i < NR_DHASH; i++) {
+		for (p = dhash + i; *p; ) {
+			if ((*p)->d_dev == dev && (!dir || (*p)->d_dir == dir)) {
+				remove_entry(p, *p);
+			} else {
+				p = &(*p)->d_next;
+			}
+		}
+	}
+}
+
+/**
+ * 初始化目录项缓存
+ * 把所有缓存项链成双向循环的LRU链表。在mount_root()中调用。
+ * @retval		void
+ */
+void dcache_init(void)
+{
+	int i;
+
+	for (i = 0; i < NR_DCACHE; i++) {
+		dcache[i].d_dev = 0;
+		dcache[i].d_next = NULL;
+		dcache[i].d_next_lru = dcache + (i + 1) % NR_DCACHE;
+		dcache[i].d_prev_lru = dcache + (i + NR_DCACHE - 1) % NR_DCACHE;
+	}
+	for (i = 0; i < NR_DHASH; i++) {
+		dhash[i] = NULL;
+	}
+	lru_head = dcache;
+}
@@ -0,0 +1,450 @@
+/*
+ *  linux/fs/eventpoll.c
+ */
+
+/*
+ * epoll：持久的关注集合。select()每次调用都要把所有描述符的等待队列重新登记一遍，被唤醒后还要重新
+ * 检查所有描述符；epoll实例则一直记住关注的文件(epitem)，并把每一项以ep_hook的形式登记在文件的读、
+ * 写等待队列上(按等待队列地址散列)。wake_up()唤醒这些等待队列时调用ep_wakeup()，它把相应的项放到
+ * 实例的就绪链表上并唤醒在epoll_wait()中等待的进程。epoll_wait()只检查就绪链表上的项，所以代价只与
+ * 就绪的描述符数量有关。
+ *
+ * 就绪链表上的项不一定真的就绪(例如另一个进程已经把数据读走)，epoll_wait()会用poll_file()再确认
+ * 一次。默认是水平触发：报告过的项仍留在就绪链表上，下次调用时再检查；EPOLLET的项报告一次后就
+ * 离开链表，直到再次被唤醒。
+ *
+ * wake_up()可能在中断中调用，所以修改散列表和就绪链表时都要关中断。
+ */
+#include <errno.h>			/* 错误号头文件。包含系统中各种出错号 */
+#include <sys/epoll.h>		/* epoll头文件。定义了事件位和struct epoll_event */
+
+#include <linux/sched.h>	/* 调度程序头文件。定义了任务结构task_struct、任务0的数据等 */
+#include <linux/kernel.h>	/* 内核头文件。含有一些内核常用函数的原型定义 */
+#include <linux/slab.h>		/* 对象缓存头文件 */
+#include <asm/segment.h>	/* 段操作头文件。定义了有关段寄存器操作的嵌入式汇编函数 */
+#include <asm/system.h>		/* 系统头文件。定义了cli()、sti()和save_flags()等 */
+
+#define NR_EP_HASH	64		/* 等待队列散列表项数(2的幂) */
+
+struct ep_hook {
+	struct task_struct ** wq;			/* 所登记的等待队列 */
+	struct epitem * item;				/* 所属的项 */
+	struct ep_hook * next;				/* 散列表中的下一个 */
+};
+
+struct epitem {
+	struct eventpoll * ep;				/* 所属的epoll实例 */
+	struct file * file;					/* 关注的文件 */
+	int fd;								/* 添加时使用的描述符 */
+	unsigned long events;				/* 关注的事件 */
+	unsigned long data;					/* 用户数据 */
+	int ready;							/* 是否在就绪链表上 */
+	struct epitem * next;				/* 同一实例中的下一项 */
+	struct epitem * rdnext;				/* 就绪链表上的下一项 */
+	struct epitem * fnext;				/* 关注同一个文件的下一项 */
+	struct ep_hook hook[2];				/* 登记在读、写等待队列上 */
+};
+
+struct eventpoll {
+	struct task_struct * wait;			/* 在epoll_wait()中等待的进程 */
+	struct epitem * items;				/* 所有的项 */
+	struct epitem * rdhead;				/* 就绪链表 */
+	struct epitem * rdtail;
+};
+
+static struct ep_hook * ep_hash[NR_EP_HASH];
+static struct kmem_cache * epitem_cachep;	/* epitem结构的缓存 */
+int ep_nr_hooks = 0;					/* 已登记的ep_hook数，为0时wake_up()不必调用ep_wakeup() */
+
+#define ep_hashfn(wq) (ep_hash + ((((unsigned long) (wq)) >> 2) & (NR_EP_HASH - 1)))
+
+/* 把项加到就绪链表末尾(调用时已关中断) */
+static void ep_set_ready(struct epitem * item)
+{
+	struct eventpoll * ep = item->ep;
+
+	if (item->ready) {
+		return;
+	}
+	item->ready = 1;
+	item->rdnext = NULL;
+	if (ep->rdtail) {
+		ep->rdtail->rdnext = item;
+	} else {
+		ep->rdhead = item;
+	}
+	ep->rdtail = item;
+}
+
+/**
+ * 等待队列被唤醒时调用(由wake_up()调用)
+ * 把登记在该等待队列上的所有项放到各自实例的就绪链表上，并唤醒等待的进程。
+ * @param[in]	p		等待队列头指针的地址
+ * @retval		void
+ */
+void ep_wakeup(struct task_struct ** p)
+{
+	struct ep_hook * h;
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	for (h = *ep_hashfn(p); h; h = h->next) {
+		if (h->wq == p) {
+			ep_set_ready(h->item);
+			wake_up(&h->item->ep->wait);
+		}
+	}
+	restore_flags(flags);
+}
+
+/* 把项登记到等待队列wq上 */
+static void add_hook(struct epitem * item, struct ep_hook * h, struct task_struct ** wq)
+{
+	struct ep_hook ** bucket = ep_hashfn(wq);
+
+	h->wq = wq;
+	h->item = item;
+	h->next = *bucket;
+	*bucket = h;
+	ep_nr_hooks++;
+}
+
+/* 撤销登记 */
+static void del_hook(struct ep_hook * h)
+{
+	struct ep_hook ** p;
+
+	for (p = ep_hashfn(h->wq); *p; p = &(*p)->next) {
+		if (*p == h) {
+			*p = h->next;
+			ep_nr_hooks--;
+			return;
+		}
+	}
+}
+
+/**
+ * 删除一项
+ * 撤销它在等待队列上的登记，并把它从实例、文件和就绪链表中取下。
+ * @param[in]	item	要删除的项
+ * @retval		void
+ */
+static void ep_remove(struct epitem * item)
+{
+	struct eventpoll * ep = item->ep;
+	struct epitem ** p, * prev;
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	del_hook(item->hook);
+	del_hook(item->hook + 1);
+	for (p = &ep->items; *p; p = &(*p)->next) {
+		if (*p == item) {
+			*p = item->next;
+			break;
+		}
+	}
+	for (p = &item->file->f_ep_links; *p; p = &(*p)->fnext) {
+		if (*p == item) {
+			*p = item->fnext;
+			break;
+		}
+	}
+	if (item->ready) {
+		for (prev = NULL, p = &ep->rdhead; *p != item; prev = *p, p = &(*p)->rdnext)
+			/* nothing */ ;
+		*p = item->rdnext;
+		if (ep->rdtail == item) {
+			ep->rdtail = prev;
+		}
+	}
+	restore_flags(flags);
+	kmem_cache_free(epitem_cachep, item);
+}
+
+/**
+ * 建立epitem结构的缓存(在main()中调用)
+ * @retval		void
+ */
+void ep_init(void)
+{
+	if (!(epitem_cachep = kmem_cache_create("epitem", sizeof(struct epitem), NULL))) {
+		panic("ep_init: no memory");
+	}
+}
+
+/**
+ * 文件的最后一个引用被关闭时删除所有关注它的项(由sys_close()调用)
+ * @param[in]	filp	文件结构指针
+ * @retval		void
+ */
+void ep_remove_file(struct file * filp)
+{
+	while (filp->f_ep_links) {
+		ep_remove(filp->f_ep_links);
+	}
+}
+
+/**
+ * 释放epoll实例(由iput()在实例的最后一个引用被释放时调用)
+ * @param[in]	inode	epoll实例的i节点
+ * @retval		void
+ */
+void ep_free(struct m_inode * inode)
+{
+	struct eventpoll * ep = (struct eventpoll *) inode->i_size;
+
+	while (ep->items) {
+		ep_remove(ep->items);
+	}
+	free_s(ep, sizeof(struct eventpoll));
+	inode->i_size = 0;
+}
+
+/* 根据描述符取epoll实例，epfd不是epoll实例时返回NULL */
+static struct eventpoll * get_ep(unsigned int epfd)
+{
+	struct file * f;
+
+	if (epfd >= NR_OPEN || !(f = current->filp[epfd]) || !f->f_inode->i_epoll) {
+		return NULL;
+	}
+	return (struct eventpoll *) f->f_inode->i_size;
+}
+
+/**
+ * 创建一个epoll实例
+ * 实例用一个不属于任何设备的i节点表示(与管道相同)，它的i_size字段指向struct eventpoll。
+ * @param[in]	size	为兼容而保留，必须大于0
+ * @retval		实例的文件描述符，或出错码
+ */
+int sys_epoll_create(int size)
+{
+	struct eventpoll * ep;
+	struct m_inode * inode;
+	struct file * f;
+	int fd, i;
+
+	if (size <= 0) {
+		return -EINVAL;
+	}
+	for (fd = 0; fd < NR_OPEN; fd++) {
+		if (!current->filp[fd]) {
+			break;
+		}
+	}
+	if (fd >= NR_OPEN) {
+		return -EMFILE;
+	}
+	f = 0 + file_table;
+	for (i = 0; i < NR_FILE; i++, f++) {
+		if (!f->f_count) {
+			break;
+		}
+	}
+	if (i >= NR_FILE) {
+		return -ENFILE;
+	}
+	/* 下面分配内存和i节点时可能睡眠，先占住描述符和文件结构 */
+	(current->filp[fd] = f)->f_count++;
+	if (!(ep = (struct eventpoll *) malloc(sizeof(struct eventpoll)))) {
+		i = -ENOMEM;
+		goto fail;
+	}
+	if (!(inode = get_empty_inode())) {
+		free_s(ep, sizeof(struct eventpoll));
+		i = -ENFILE;
+		goto fail;
+	}
+	ep->wait = NULL;
+	ep->items = ep->rdhead = ep->rdtail = NULL;
+	inode->i_size = (unsigned long) ep;
+	inode->i_epoll = 1;
+	f->f_inode = inode;
+	f->f_mode = 1;
+	f->f_flags = 0;
+	f->f_pos = 0;
+	current->close_on_exec &= ~(1 << fd);
+	return fd;
+fail:
+	current->filp[fd] = NULL;
+	f->f_count = 0;
+	return i;
+}
+
+/**
+ * 在epoll实例中添加、修改或删除一项
+ * 参数从用户栈上取：epfd、op、fd、event。只有终端和管道可以被关注。
+ * @param[in]	buffer	指向用户空间中epoll_ctl()的第1个参数
+ * @retval		成功返回0，否则返回出错码
+ */
+int sys_epoll_ctl(unsigned long * buffer)
+{
+	struct task_struct ** in, ** out;
+	struct eventpoll * ep;
+	struct epitem * item;
+	struct epoll_event * event;
+	struct file * f;
+	unsigned long events = 0, data = 0;
+	int op, fd;
+
+	if (!(ep = get_ep(get_fs_long(buffer++)))) {
+		return -EBADF;
+	}
+	op = get_fs_long(buffer++);
+	fd = get_fs_long(buffer++);
+	event = (struct epoll_event *) get_fs_long(buffer);
+	if ((unsigned) fd >= NR_OPEN || !(f = current->filp[fd])) {
+		return -EBADF;
+	}
+	if (op != EPOLL_CTL_DEL) {
+		if (!event) {
+			return -EFAULT;
+		}
+		events = get_fs_long(&event->events);
+		data = get_fs_long(&event->data);
+	}
+	for (item = ep->items; item; item = item->next) {
+		if (item->file == f && item->fd == fd) {
+			break;
+		}
+	}
+	switch (op) {
+		case EPOLL_CTL_ADD:
+			if (item) {
+				return -EEXIST;
+			}
+			if (poll_queues(f->f_inode, &in, &out)) {
+				return -EPERM;
+			}
+			if (!(item = (struct epitem *) kmem_cache_alloc(epitem_cachep))) {
+				return -ENOMEM;
+			}
+			item->ep = ep;
+			item->file = f;
+			item->fd = fd;
+			item->ready = 0;
+			cli();
+			add_hook(item, item->hook, in);
+			add_hook(item, item->hook + 1, out);
+			item->next = ep->items;
+			ep->items = item;
+			item->fnext = f->f_ep_links;
+			f->f_ep_links = item;
+			break;
+		case EPOLL_CTL_MOD:
+			if (!item) {
+				return -ENOENT;
+			}
+			cli();
+			break;
+		case EPOLL_CTL_DEL:
+			if (!item) {
+				return -ENOENT;
+			}
+			ep_remove(item);
+			return 0;
+		default:
+			return -EINVAL;
+	}
+	/* 新添加或修改过的项若已经就绪，先放到就绪链表上，epoll_wait()会再确认 */
+	item->events = events;
+	item->data = data;
+	if (poll_file(f->f_inode) & (events | EPOLLERR | EPOLLHUP)) {
+		ep_set_ready(item);
+		wake_up(&ep->wait);
+	}
+	sti();
+	return 0;
+}
+
+/**
+ * 从就绪链表中收集事件(调用时已关中断)
+ * 链表上的项逐一用poll_file()确认。仍然就绪的水平触发项放回链表末尾，超出max的项原样放回。
+ * @param[in]	ep		epoll实例
+ * @param[out]	ev		事件数组(内核空间)
+ * @param[in]	max		数组大小
+ * @retval		收集到的事件数
+ */
+static int ep_collect(struct eventpoll * ep, struct epoll_event * ev, int max)
+{
+	struct epitem * item, * next;
+	unsigned long mask;
+	int n = 0;
+
+	item = ep->rdhead;
+	ep->rdhead = ep->rdtail = NULL;
+	for ( ; item; item = next) {
+		next = item->rdnext;
+		item->ready = 0;
+		if (n >= max) {
+			ep_set_ready(item);
+			continue;
+		}
+		mask = poll_file(item->file->f_inode) & (item->events | EPOLLERR | EPOLLHUP);
+		if (!mask) {
+			continue;
+		}
+		ev[n].events = mask;
+		ev[n].data = item->data;
+		n++;
+		if (!(item->events & EPOLLET)) {
+			ep_set_ready(item);
+		}
+	}
+	return n;
+}
+
+/**
+ * 等待epoll实例中的事件
+ * 参数从用户栈上取：epfd、events、maxevents、timeout(毫秒，-1表示一直等待，0表示不等待)。
+ * 一次最多返回EP_MAX_EVENTS个事件。
+ * @param[in]	buffer	指向用户空间中epoll_wait()的第1个参数
+ * @retval		就绪的事件数，超时返回0，出错返回出错码
+ */
+int sys_epoll_wait(unsigned long * buffer)
+{
+	struct epoll_event ev[EP_MAX_EVENTS];
+	struct eventpoll * ep;
+	struct epoll_event * events;
+	int maxevents, timeout, n, i;
+
+	if (!(ep = get_ep(get_fs_long(buffer++)))) {
+		return -EBADF;
+	}
+	events = (struct epoll_event *) get_fs_long(buffer++);
+	maxevents = get_fs_long(buffer++);
+	timeout = get_fs_long(buffer);
+	if (maxevents <= 0) {
+		return -EINVAL;
+	}
+	if (maxevents > EP_MAX_EVENTS) {
+		maxevents = EP_MAX_EVENTS;
+	}
+	/* 与select()相同，用进程的timeout字段计时，0表示不超时 */
+	current->timeout = 0;
+	if (timeout > 0) {
+		current->timeout = jiffies + (timeout * HZ + 999) / 1000;
+	}
+	cli();
+	while (!(n = ep_collect(ep, ev, maxevents)) && timeout &&
+	    !(current->signal & ~current->blocked)) {
+		if (timeout > 0 && !current->timeout) {		/* 已超时 */
+			break;
+		}
+		interruptible_sleep_on(&ep->wait);
+	}
+	sti();
+	current->timeout = 0;
+	if (!n && (current->signal & ~current->blocked)) {
+		return -EINTR;
+	}
+	verify_area(events, n * sizeof(struct epoll_event));
+	for (i = 0; i < n; i++) {
+		put_fs_long(ev[i].events, &events[i].events);
+		put_fs_long(ev[i].data, &events[i].data);
+	}
+	return n;
+}
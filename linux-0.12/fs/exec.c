@@ -686,6 +686,7 @@ restart_interp:
 		last_task_used_math = NULL;
 	}
 	current->used_math = 0;
+	current->prof_scale = 0;
 	/*
 	 * 然后我们根据新执行文件头结构中的代码长度字段a_text的值，来修改局部表中描述符基址和段限长，并将128KB的参数和环境空间
 	 * 页面放置在数据段末端。执行下面语句之后，p此时更改成以数据段起始处为原点的偏移值，但仍指向参数和环境空间数据开始处，即已
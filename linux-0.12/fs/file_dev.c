@@ -14,6 +14,56 @@
 #define MIN(a,b) (((a)<(b))?(a):(b))		/* 取a,b中的最小值 */
 #define MAX(a,b) (((a)>(b))?(a):(b))		/* 取a,b中的最大值 */
 
+#define MIN_READAHEAD	4					/* 开始顺序读时的预读窗口(块数) */
+
+/**
+ * 文件顺序读预读
+ * 在file_read()读取数据之前调用。本次读操作所涉及的其余数据块总是先用READA一起发出读请求，让它们在
+ * 块设备队列中合并成一个请求项。若本次读操作紧接着上次读操作结束的位置(顺序读)，则再向后预读f_rawin
+ * 块，并且每次顺序读都把窗口加倍，直到该设备的预读上限read_ahead[]；否则认为是随机读，窗口收缩为0。
+ * 已经发出过预读的块记录在f_raend中，不会重复发出；只有当剩余的预读量不足半个窗口时才补充预读，使每
+ * 批预读都足够大。
+ * @param[in]	*inode	i节点
+ * @param[in]	*filp	文件结构指针
+ * @param[in]	count	本次要读取的字节数
+ * @retval		void
+ */
+static void file_readahead(struct m_inode * inode, struct file * filp, int count)
+{
+	int block, last, end, size, nr, max;
+	struct buffer_head * bh;
+
+	max = read_ahead[MAJOR(inode->i_dev)];
+	if (filp->f_pos == filp->f_ralast) {
+		filp->f_rawin = filp->f_rawin ? MIN(filp->f_rawin << 1, max) : MIN(MIN_READAHEAD, max);
+	} else {
+		filp->f_rawin = 0;
+		filp->f_raend = 0;
+	}
+	block = filp->f_pos / BLOCK_SIZE + 1;
+	last = (filp->f_pos + count - 1) / BLOCK_SIZE;
+	size = (inode->i_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	end = last + 1;
+	if (filp->f_raend < end + (filp->f_rawin >> 1)) {
+		end += filp->f_rawin;
+	}
+	end = MIN(end, size);
+	block = MAX(block, filp->f_raend);
+	/* 与breada()一样，预读块不等待读完，直接递减引用计数 */
+	for ( ; block < end ; block++) {
+		if (!(nr = bmap(inode, block))) {
+			continue;
+		}
+		if ((bh = getblk(inode->i_dev, nr))) {
+			if (!bh->b_uptodate) {
+				ll_rw_block(READA, bh);
+			}
+			bh->b_count--;
+		}
+	}
+	filp->f_raend = MAX(filp->f_raend, end);
+}
+
 /**
  * 文件读函数
  * 根据i节点和文件结构，读取文件中数据。
@@ -38,6 +88,7 @@ int file_read(struct m_inode * inode, struct file * filp, char * buf, int count)
 	if ((left = count) <= 0) {
 		return 0;
 	}
+	file_readahead(inode, filp, count);
 	while (left) {
 		if ((nr = bmap(inode, (filp->f_pos)/BLOCK_SIZE))) {
 			if (!(bh = bread(inode->i_dev, nr))) {
@@ -61,21 +112,18 @@ int file_read(struct m_inode * inode, struct file * filp, char * buf, int count)
 		 * 往用户缓冲区中填入chars个0值字节
 		 */
 		if (bh) {
-			char * p = nr + bh->b_data;
-			while (chars-- > 0) {
-				put_fs_byte(*(p++), buf++);
-			}
+			copy_to_user(buf, nr + bh->b_data, chars);
 			brelse(bh);
 		} else {
-			while (chars-- > 0) {
-				put_fs_byte(0, buf++);
-			}
+			clear_user(buf, chars);
 		}
+		buf += chars;
 	}
 	/*
 	 * 修改该i节点的访问时间为当前时间，返回读取的字节数。若读取字节数为0，则返回出错号。CURRENT_TIME是定义在
 	 * include/linux/sched.h的宏，用于计算UNIX时间。即从1970年1月1日0时0分0秒开始，到当前的时间，单位是秒
 	 */
+	filp->f_ralast = filp->f_pos;		/* 记下本次读结束的位置，用于判断下次是否顺序读 */
 	inode->i_atime = CURRENT_TIME;
 	return (count-left) ? (count-left) : -ERROR;
 }
@@ -151,9 +199,8 @@ int file_write(struct m_inode * inode, struct file * filp, char * buf, int count
 			inode->i_dirt = 1;
 		}
 		i += c;
-		while (c-- > 0) {
-			*(p++) = get_fs_byte(buf++);
-		}
+		copy_from_user(p, buf, c);
+		buf += c;
 		brelse(bh);
 	}
 	/*
@@ -16,7 +16,22 @@
  应子设备号确定的一个子设备上所拥有的数据块总数(1块大小 = 1KB) */
 extern int *blk_size[];
 
-struct m_inode inode_table[NR_INODE]={{0, }, };		/* 内存中i节点表(NR_INODE=32项) */
+struct m_inode * inode_table;		/* 内存中i节点表，由inode_init()在高速缓冲区开头分配 */
+int nr_inodes = 0;					/* i节点表项数NR_INODE */
+
+/*
+ * 内存i节点按(设备号, i节点号)挂在hash队列上，使iget()不必扫描整个i节点表。引用计数为0的i节点
+ * 还挂在一个双向循环的空闲链表上，按放回的先后顺序排列，get_empty_inode()从表头取最久未使用的一项。
+ * i_count在各处被直接递增，所以空闲链表上可能有已被重新使用的i节点，取用时再把它们摘下。
+ */
+static struct m_inode ** inode_hash;
+static int inode_hash_bits;
+static struct m_inode * free_inodes = NULL;	/* 空闲链表头 */
+
+#define MIN_INODE_HASH_BITS	5
+#define _inode_hashfn(dev, nr) \
+	((((unsigned) (dev) << 16 ^ (nr)) * 0x9E3779B1U) >> (32 - inode_hash_bits))
+#define inode_hash_head(dev, nr) (inode_hash[_inode_hashfn(dev, nr)])
 
 static void read_inode(struct m_inode *inode);		/* 读指定i节点号的i节点信息 */
 static void write_inode(struct m_inode *inode);		/* 写i节点信息到高速缓冲中 */
@@ -66,6 +81,142 @@ static inline void unlock_inode(struct m_inode *inode)
 	wake_up(&inode->i_wait);
 }
 
+/**
+ * 把i节点加入hash队列
+ * 在设置了i节点的设备号和i节点号之后调用。
+ * @param[in]	inode	i节点指针
+ * @retval		void
+ */
+void insert_inode_hash(struct m_inode * inode)
+{
+	struct m_inode ** head = &inode_hash_head(inode->i_dev, inode->i_num);
+
+	inode->i_hash_prev = NULL;
+	inode->i_hash_next = *head;
+	if (*head) {
+		(*head)->i_hash_prev = inode;
+	}
+	*head = inode;
+}
+
+/* 把i节点从hash队列中取下(如果在队列中的话) */
+static void remove_inode_hash(struct m_inode * inode)
+{
+	if (inode->i_hash_next) {
+		inode->i_hash_next->i_hash_prev = inode->i_hash_prev;
+	}
+	if (inode->i_hash_prev) {
+		inode->i_hash_prev->i_hash_next = inode->i_hash_next;
+	} else if (inode->i_dev && inode_hash_head(inode->i_dev, inode->i_num) == inode) {
+		inode_hash_head(inode->i_dev, inode->i_num) = inode->i_hash_next;
+	}
+	inode->i_hash_next = inode->i_hash_prev = NULL;
+}
+
+/* 在hash队列中查找指定的i节点 */
+static struct m_inode * find_inode(int dev, int nr)
+{
+	struct m_inode * inode;
+
+	for (inode = inode_hash_head(dev, nr); inode; inode = inode->i_hash_next) {
+		if (inode->i_dev == dev && inode->i_num == nr) {
+			return inode;
+		}
+	}
+	return NULL;
+}
+
+/* 把i节点从空闲链表中取下(如果在链表中的话) */
+static void remove_free_inode(struct m_inode * inode)
+{
+	if (!inode->i_next_free) {
+		return;
+	}
+	if (inode->i_next_free == inode) {
+		free_inodes = NULL;
+	} else {
+		inode->i_prev_free->i_next_free = inode->i_next_free;
+		inode->i_next_free->i_prev_free = inode->i_prev_free;
+		if (free_inodes == inode) {
+			free_inodes = inode->i_next_free;
+		}
+	}
+	inode->i_next_free = inode->i_prev_free = NULL;
+}
+
+/**
+ * 把引用计数刚变为0的i节点放入空闲链表
+ * 仍然有效的i节点放在末尾，以便尽量长久地留在内存中；已清空的i节点放在表头，最先被重用。
+ * @param[in]	inode	i节点指针
+ * @param[in]	first	非0则放在表头
+ * @retval		void
+ */
+static void put_free_inode(struct m_inode * inode, int first)
+{
+	remove_free_inode(inode);
+	if (!free_inodes) {
+		free_inodes = inode->i_next_free = inode->i_prev_free = inode;
+		return;
+	}
+	inode->i_next_free = free_inodes;
+	inode->i_prev_free = free_inodes->i_prev_free;
+	free_inodes->i_prev_free->i_next_free = inode;
+	free_inodes->i_prev_free = inode;
+	if (first) {
+		free_inodes = inode;
+	}
+}
+
+/**
+ * 清空不再使用的i节点
+ * 把i节点从hash队列中取下，内容清零，并放到空闲链表头部。
+ * @param[in]	inode	i节点指针
+ * @retval		void
+ */
+void clear_inode(struct m_inode * inode)
+{
+	remove_inode_hash(inode);
+	remove_free_inode(inode);
+	memset(inode, 0, sizeof(*inode));
+	put_free_inode(inode, 1);
+}
+
+/**
+ * 内存i节点表初始化
+ * 按高速缓冲区的大小确定i节点表项数(每4KB一项，限制在[MIN_NR_INODE, MAX_NR_INODE]之间)和hash表
+ * 大小(不小于表项数一半的2的幂)，二者都从高速缓冲区开头start_buffer处分配，start_buffer随之后移。
+ * 最后把所有i节点放入空闲链表。必须在buffer_init()之前调用。
+ * @param[in]	buffer_end	高速缓冲区结束的内存地址
+ * @retval		void
+ */
+void inode_init(long buffer_end)
+{
+	int i;
+
+	if (buffer_end == 1<<20) {
+		buffer_end = 640*1024;
+	}
+	nr_inodes = (buffer_end - (long) start_buffer) >> 12;
+	if (nr_inodes < MIN_NR_INODE) {
+		nr_inodes = MIN_NR_INODE;
+	} else if (nr_inodes > MAX_NR_INODE) {
+		nr_inodes = MAX_NR_INODE;
+	}
+	for (inode_hash_bits = MIN_INODE_HASH_BITS; (1 << inode_hash_bits) < (nr_inodes >> 1); ) {
+		inode_hash_bits++;
+	}
+	inode_hash = (struct m_inode **) start_buffer;
+	inode_table = (struct m_inode *) (inode_hash + (1 << inode_hash_bits));
+	start_buffer = (struct buffer_head *) (inode_table + nr_inodes);
+	for (i = 0; i < (1 << inode_hash_bits); i++) {
+		inode_hash[i] = NULL;
+	}
+	memset(inode_table, 0, nr_inodes * sizeof(struct m_inode));
+	for (i = 0; i < nr_inodes; i++) {
+		put_free_inode(inode_table + i, 0);
+	}
+}
+
 /** 
  * 释放设备dev在内存i节点表中的所有i节点
  * 扫描内存中的i节点表数组，如果某项是指定设备使用的i节点就释放之
@@ -90,6 +241,7 @@ void invalidate_inodes(int dev)
 			if (inode->i_count)	{	/* 若其引用数不为0，则显示出错警告 */
 				printk("inode in use on removed disk\n\r");
 			}
+			remove_inode_hash(inode);
 			inode->i_dev = inode->i_dirt = 0;	/* 释放i节点(置设备号为0) */
 		}
 	}
@@ -120,6 +272,25 @@ void sync_inodes(void)
 	}
 }
 
+/**
+ * 为文件分配一个逻辑块
+ * 以该文件上次分配的逻辑块的下一块为目标，i节点刚读入时则以文件的第1个数据块为目标，使顺序写入
+ * 的文件在盘上尽量连续，读写时能合并成多扇区的请求。
+ * @param[in]	inode	文件的i节点指针
+ * @retval		成功返回逻辑块号，失败返回0
+ */
+static int alloc_zone(struct m_inode * inode)
+{
+	int zone;
+
+	zone = new_block(inode->i_dev,
+		inode->i_lastzone ? inode->i_lastzone + 1 : inode->i_zone[0]);
+	if (zone) {
+		inode->i_lastzone = zone;
+	}
+	return zone;
+}
+
 /**
  * 文件数据块映射到盘块的处理操作。（block位图处理函数，bmap - block map）
  * 把指定的文件数据块block对应到设备上逻辑块上，并返回逻辑块号。如果创建标志create置位，则在设
@@ -154,7 +325,7 @@ static int _bmap(struct m_inode * inode, int block, int create)
 	if (block < 7) {
 		/* create=1且i节点中对应该块的逻辑块字段为0,则需申请一磁盘块 */
 		if (create && !inode->i_zone[block]) {
-			if ((inode->i_zone[block] = new_block(inode->i_dev))) {
+			if ((inode->i_zone[block] = alloc_zone(inode))) {
 				inode->i_ctime = CURRENT_TIME;
 				inode->i_dirt = 1;
 			}
@@ -174,7 +345,7 @@ static int _bmap(struct m_inode * inode, int block, int create)
 	if (block < 512) {
 		/*  create=1且i_zone[7]是0，表明文件是首次使用间接块，则需申请一磁盘块 */
 		if (create && !inode->i_zone[7]) {
-			if ((inode->i_zone[7] = new_block(inode->i_dev))) {
+			if ((inode->i_zone[7] = alloc_zone(inode))) {
 				inode->i_dirt = 1;
 				inode->i_ctime = CURRENT_TIME;
 			}
@@ -198,7 +369,7 @@ static int _bmap(struct m_inode * inode, int block, int create)
 		i = ((unsigned short *)(bh->b_data))[block];
 		/* i=0说明需要创建一个新逻辑块 */
 		if (create && !i) {
-			if ((i = new_block(inode->i_dev))) {
+			if ((i = alloc_zone(inode))) {
 				((unsigned short *) (bh->b_data))[block] = i;
 				bh->b_dirt = 1;
 			}
@@ -220,7 +391,7 @@ static int _bmap(struct m_inode * inode, int block, int create)
 	block -= 512;
 	/* create && inode->i_zone[8]=0，则需申请一个磁盘块用于存放二次间接块的一级块信息 */
 	if (create && !inode->i_zone[8]) {
-		if ((inode->i_zone[8] = new_block(inode->i_dev))) {
+		if ((inode->i_zone[8] = alloc_zone(inode))) {
 			inode->i_dirt = 1;
 			inode->i_ctime = CURRENT_TIME;
 		}
@@ -245,7 +416,7 @@ static int _bmap(struct m_inode * inode, int block, int create)
 	/* i=0则需申请一磁盘块(逻辑块)作为二次间接块的二级块，并让二次间接块的一级块中第(block/512)
 	 项等于该二级块的块号i */
 	if (create && !i) {
-		if ((i = new_block(inode->i_dev))) {
+		if ((i = alloc_zone(inode))) {
 			((unsigned short *) (bh->b_data))[block >> 9] = i;
 			bh->b_dirt=1; /* 置位一级块的已修改标志 */
 		}
@@ -271,7 +442,7 @@ static int _bmap(struct m_inode * inode, int block, int create)
 	 */
 	/* 第block项中逻辑块号为0的话，则申请一磁盘块(逻辑块)，作为最终存放数据信息的块 */
 	if (create && !i) {
-		if ((i = new_block(inode->i_dev))) {
+		if ((i = alloc_zone(inode))) {
 			((unsigned short *) (bh->b_data))[block & 511] = i;
 			bh->b_dirt = 1;
 		}
@@ -329,16 +500,29 @@ void iput(struct m_inode * inode)
 		if (--inode->i_count) {
 			return;
 		}
-		/* 对于管道节点，inode->i_size存放着内存页地址。参见get_pipe_inode() */
-		free_page(inode->i_size);
+		/* 对于管道节点，inode->i_size指向管道缓冲区。参见get_pipe_inode() */
+		free_pipe_buf(inode);
 		inode->i_count = 0;
 		inode->i_dirt = 0;
 		inode->i_pipe = 0;
+		put_free_inode(inode, 1);
+		return;
+	}
+	/* epoll实例的i节点：最后一个引用被释放时释放实例。参见fs/eventpoll.c */
+	if (inode->i_epoll) {
+		if (--inode->i_count) {
+			return;
+		}
+		ep_free(inode);
+		inode->i_epoll = 0;
+		put_free_inode(inode, 1);
 		return;
 	}
 	/* 设备号=0，则将此节点的引用计数递减1，返回。例如用于管道操作的i节点，其i节点的设备号为0 */
 	if (!inode->i_dev) {
-		inode->i_count--;
+		if (!--inode->i_count) {
+			put_free_inode(inode, 1);
+		}
 		return;
 	}
 	/* 如果是块设备文件的i节点，则i_zone[0]中是设备号，则刷新该设备。并等待i节点解锁 */
@@ -368,54 +552,51 @@ repeat:
 		goto repeat;
 	}
 	/* 程序若能执行到此，说明该i节点的引用计数值i_count是1，链接数不为零，并且内容没有被修
-	 改过。因此此时只要把i节点引用计数递减1，返回。此时该i节点的i_count=0，表示已释放 */
+	 改过。因此此时只要把i节点引用计数递减1，放到空闲链表末尾，返回。此时该i节点的i_count=0，
+	 表示已释放，但它仍留在hash队列中，再次iget()时不必重新读盘 */
 	inode->i_count--;
+	put_free_inode(inode, 0);
 	return;
 }
 
 /**
  * 从i节点表(inode_table)中获取一个空闲i节点项
- * 寻找引用计数count为0的i节点，并将其写盘后清零，返回其指针，引用计数被置1
+ * 从空闲链表头部取最久未使用的i节点，若它已修改则先写盘，清零后返回其指针，引用计数被置1
  * @rerval	空闲i节点项的指针
  */
 struct m_inode * get_empty_inode(void)
 {
 	struct m_inode * inode;
-	static struct m_inode * last_inode = inode_table;	/* 指向i节点表第1项 */
 	int i;
 
-	do {
-		inode = NULL;
-		for (i = NR_INODE; i; i--) {		/* NR_INODE = 64 */
-			if (++last_inode >= inode_table + NR_INODE) {
-				last_inode = inode_table;
-			}
-			/* last_inode所指向的i节点计数值为0，则说明可能找到空闲i节点项 */
-			if (!last_inode->i_count) {
-				inode = last_inode;
-				/* 该i节点的已修改标志和和锁定标志均为0，则可以使用该i节点，退出循环 */
-				if (!inode->i_dirt && !inode->i_lock) {
-					break;
-				}
-			}
-		}
-		/* 如果没有找到空闲i节点(inode=NULL)，则将i节点表打印出来供调试使用，并停机 */
-		if (!inode) {
+	for (;;) {
+		/* 空闲链表为空则i节点都在使用中，将i节点表打印出来供调试使用，并停机 */
+		if (!(inode = free_inodes)) {
 			for (i = 0 ; i < NR_INODE ; i++) {
 				printk("%04x: %6d\t", inode_table[i].i_dev, inode_table[i].i_num);
 			}
 			panic("No free inodes in mem");
 		}
+		/* 已被重新引用的i节点不再是空闲的，从链表中摘下 */
+		if (inode->i_count) {
+			remove_free_inode(inode);
+			continue;
+		}
 		/* 等待该i节点解锁(如果又被上锁的话)。如果该i节点已修改标志被置位的话，则将该i节点
-		 刷新(同步)。因为刷新时可能会睡眠，因此需要再次循环等待i节点解锁 */
-		wait_on_inode(inode);
-		while (inode->i_dirt) {
-			write_inode(inode);
+		 刷新(同步)。因为刷新时可能会睡眠，所以之后要重新检查链表头 */
+		if (inode->i_lock || inode->i_dirt) {
 			wait_on_inode(inode);
+			while (inode->i_dirt) {
+				write_inode(inode);
+				wait_on_inode(inode);
+			}
+			continue;
 		}
-	/* 如果i节点又被其他占用的话，则重新寻找空闲i节点。否则说明已找到符合要求的空闲i节点项 */
-	} while (inode->i_count);
-	/*则将该i节点项内容清零，并置引用计数为1，返回该i节点指针 */
+		break;
+	}
+	/* 则将该i节点从hash队列和空闲链表中取下，内容清零，并置引用计数为1，返回该i节点指针 */
+	remove_inode_hash(inode);
+	remove_free_inode(inode);
 	memset(inode, 0, sizeof(*inode));
 	inode->i_count = 1;
 	return inode;
@@ -423,7 +604,7 @@ struct m_inode * get_empty_inode(void)
 
 /**
  * 获取管道节点
- * 首先扫描i节点表，寻找一个空闲i节点项，然后取得一页空闲内存供管道使用。然后将得到的i节点的引用
+ * 首先扫描i节点表，寻找一个空闲i节点项，然后为它分配管道缓冲区(见fs/pipe.c)。然后将得到的i节点的引用
  * 计数置为2(读/写)，初始化管道头和尾，置i节点的管道类型标志。
  * @retval	返回i节点指针，如果失败，则返回NULL
  */
@@ -435,16 +616,16 @@ struct m_inode * get_pipe_inode(void)
 	if (!(inode = get_empty_inode())) {
 		return NULL;
 	}
-	/* 然后为该i节点申请一页内存。并让节点的i_size字段指向该页面。如果已没有空闲内存，则释放该i节点，并返回NULL。*/
-	if (!(inode->i_size = get_free_page())) {	/* 节点的i_size字段指向缓冲区 */
+	/* 然后为该i节点申请管道缓冲区，并让节点的i_size字段指向它。如果已没有空闲内存，则释放该i节点，并返回NULL。*/
+	if (alloc_pipe_buf(inode)) {				/* 节点的i_size字段指向缓冲区 */
 		inode->i_count = 0;
+		put_free_inode(inode, 1);
 		return NULL;
 	}
-	/* 设置该i节点的引用计数为2，并复位管道头尾指针。i节点逻辑块号数组i_zone[]的i_zone[0]和
-	 i_zone[1]中分别用来存放管道头和管道尾指针。最后设置i节点是管道i节点标志并返回该i节点号 */
+	/* 设置该i节点的引用计数为2(管道头尾指针已由alloc_pipe_buf()清零)。最后设置i节点是管道i节点
+	 标志并返回该i节点号 */
 	inode->i_count = 2;							/* sum of readers/writers */
 												/* 读/写两者总计 */
-	PIPE_HEAD(*inode) = PIPE_TAIL(*inode) = 0;	/* 复位管道头尾指针 */
 	inode->i_pipe = 1;							/* 置节点为管道使用标志 */
 	return inode;
 }
@@ -466,29 +647,22 @@ struct m_inode * iget(int dev, int nr)
 	if (!dev) {
 		panic("iget with dev==0");
 	}
-	/* 预先从i节点表中取一个空闲i节点备用 */
-	empty = get_empty_inode();
-	/* 扫描i节点表。寻找参数指定节点号nr的i节点，并递增该节点的引用次数。如果当前扫描i节点的设备
-	 号不等于指定的设备号或者节点号不等于指定的节点号，则继续扫描 */
-	inode = inode_table;	/* 指向inode表首 */
-	while (inode < NR_INODE + inode_table) {
-		if (inode->i_dev != dev || inode->i_num != nr) {
-			inode++;
-			continue;
-		}
+repeat:
+	/* 在hash队列中寻找参数指定节点号nr的i节点 */
+	if ((inode = find_inode(dev, nr))) {
 		/* 如果找到指定设备号dev和节点号nr的i节点，则等待该节点解锁(如果已上锁的话)。在等待该节
-		 点解锁过程中，i节点可能会发生变化。所以再次进行上述相同判断，如果发生了变化，则重新扫描
-		 整个i节点表 */
+		 点解锁过程中，i节点可能会发生变化。所以再次进行上述相同判断，如果发生了变化，则重新查找 */
 		wait_on_inode(inode);
 		if (inode->i_dev != dev || inode->i_num != nr) {
-			inode = inode_table;
-			continue;
+			goto repeat;
 		}
 		/* 到这里表示找到相应的i节点，于是将该i节点引用计数增1。然后再作进一步检查，看它是否是另
 		 一个文件系统的安装点。若是则寻找被安装文件系统根节点并返回。如果该i节点的确是其他文件系
-		 统的安装点，则在超级块表中搜寻安装在此i节点的超级块。如果没有找到，则显示出错信息，并放
-		 回预获取的空闲节点empty，返回该i节点指针 */
-		inode->i_count++;
+		 统的安装点，则在超级块表中搜寻安装在此i节点的超级块。如果没有找到，则显示出错信息，并返
+		 回该i节点指针 */
+		if (!inode->i_count++) {
+			remove_free_inode(inode);
+		}
 		if (inode->i_mount) {
 			int i;
 			for (i = 0; i < NR_SUPER; i++) {
@@ -498,34 +672,32 @@ struct m_inode * iget(int dev, int nr)
 			}
 			if (i >= NR_SUPER) {
 				printk("Mounted inode hasn't got sb\n");
-				if (empty) {
-					iput(empty);
-				}
 				return inode;
 			}
 			/* 执行到这里表示已经找到安装到inode节点的文件系统超级块。于是将该i节点写盘放回，
 			 并从安装在此i节点上的文件系统超级块中取设备号，并令i节点号为ROOT_INO。然后重新
-			 扫描整个i节点表，以获取该被安装文件系统的根i节点信息 */
+			 查找，以获取该被安装文件系统的根i节点信息 */
 			iput(inode);
 			dev = super_block[i].s_dev;
 			nr = ROOT_INO;
-			inode = inode_table;
-			continue;
-		}
-		/* 如果找到了相应的i节点。因此可以放弃本函数开始申请空闲i节点，返回找到的i节点指针 */
-		if (empty) {
-			iput(empty);
+			goto repeat;
 		}
 		return inode;
-    }
-	/* 如果在i节点表中没有找到指定的i节点，则利用前面申请的空闲i节点empty在i节点表中建立该i节
-	 点。并从相应设备上读取该i节点信息，返回该i节点指针 */
-	if (!empty) {
+	}
+	/* 如果在i节点表中没有找到指定的i节点，则取一个空闲i节点。取空闲i节点时可能睡眠，期间其他进
+	 程可能已经读入了该i节点，所以要再查一次。然后在空闲i节点中建立该i节点，并从相应设备上读取
+	 该i节点信息，返回该i节点指针 */
+	if (!(empty = get_empty_inode())) {
 		return (NULL);
 	}
+	if (find_inode(dev, nr)) {
+		iput(empty);
+		goto repeat;
+	}
 	inode = empty;
 	inode->i_dev = dev;
 	inode->i_num = nr;
+	insert_inode_hash(inode);
 	read_inode(inode);
 	return inode;
 }
@@ -12,6 +12,7 @@
 
 extern int tty_ioctl(int dev, int cmd, int arg);
 extern int pipe_ioctl(struct m_inode *pino, int cmd, int arg);
+extern int blk_ioctl(int dev, int cmd, int arg);
 
 /* 定义输入输出控制(ioctl)函数指针类型 */
 typedef int (*ioctl_ptr)(int dev,int cmd,int arg);
@@ -64,6 +65,10 @@ int sys_ioctl(unsigned int fd, unsigned int cmd, unsigned long arg)
 		return -EINVAL;
 	}
 	dev = filp->f_inode->i_zone[0];		/* 对于设备类文件，此处存有设备号 */
+	/* 块设备文件的IO控制统一由blk_ioctl()处理(kernel/blk_drv/elevator.c) */
+	if (S_ISBLK(mode)) {
+		return blk_ioctl(dev,cmd,arg);
+	}
 	if (MAJOR(dev) >= NRDEVS) {
 		return -ENODEV;
 	}
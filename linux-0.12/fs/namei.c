@@ -193,7 +193,8 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
     const char * name, int namelen, struct dir_entry ** res_dir)
 {
     int entries;
-    int block, i;
+    int block, i, ino, error = 0;
+    unsigned short gen;
     struct buffer_head * bh;
     struct dir_entry * de;
     struct super_block * sb;
@@ -249,6 +250,26 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
             }
         }
     }
+    /*
+     * 先查目录项缓存(fs/dcache.c)。命中负目录项说明名字不存在；命中正目录项则只读入记录的那一块，并核对其中
+     * 的目录项确实还是这个名字和i节点，核对不上就删除该缓存项，按下面的正常方法查找。读目录块时可能睡眠，
+     * 其间别的进程可能在目录中添加了这个名字，所以先记下目录的i_dgen，没找到时目录没有变过才记下负目录项
+     */
+    gen = (*dir)->i_dgen;
+    if (!(ino = dcache_lookup(*dir, name, namelen, &block, &i))) {
+        return NULL;
+    }
+    if (ino > 0) {
+        if ((bh = bread((*dir)->i_dev, block))) {
+            de = i + (struct dir_entry *) bh->b_data;
+            if (de->inode == ino && match(namelen, name, de)) {
+                *res_dir = de;
+                return bh;
+            }
+            brelse(bh);
+        }
+        dcache_remove(*dir, name, namelen);
+    }
     /*
      * 现在我们开始正常操作，查找指定文件的目录项在什么地方。因此我们需要读取目录的数据，即取出目录i节点
      * 对应块设备数据区中的数据块（逻辑块）信息。这些逻辑块的块号被保存在i节点结构的i_zone[]数组中。我们
@@ -278,6 +299,7 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
             bh = NULL;
             if (!(block = bmap(*dir,i/DIR_ENTRIES_PER_BLOCK)) ||
                 !(bh = bread((*dir)->i_dev,block))) {
+                error |= (block != 0);  /* 读块出错时不能断定名字不存在 */
                 i += DIR_ENTRIES_PER_BLOCK;
                 continue;
             }
@@ -288,14 +310,19 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
          * 否则继续在目录项数据块中比较下一个目录项
          */
         if (match(namelen,name,de)) {
+            dcache_add(*dir, name, namelen, de->inode, block,
+                de - (struct dir_entry *) bh->b_data);
             *res_dir = de;
             return bh;
         }
         de++;
         i++;
     }
-    /* 如果指定目录中所有目录项都搜索完后，还没找到相应的目录项，则释放目录的数据块，最后返回NULL（失败） */
+    /* 如果指定目录中所有目录项都搜索完后，还没找到相应的目录项，则释放目录的数据块，记下负目录项，最后返回NULL（失败） */
     brelse(bh);
+    if (!error && (*dir)->i_dgen == gen) {
+        dcache_add(*dir, name, namelen, 0, 0, 0);
+    }
     return NULL;
 }
 
@@ -407,6 +434,9 @@ static struct buffer_head * add_entry(struct m_inode * dir,
             for (i=0; i < NAME_LEN ; i++)
                 de->name[i]=(i<namelen)?get_fs_byte(name+i):0;
             bh->b_dirt = 1;
+            /* 名字写入以后再清除它的负目录项，并让正在睡眠的find_entry()不再记下负目录项 */
+            dir->i_dgen++;
+            dcache_remove(dir, name, namelen);
             *res_dir = de;
             return bh;
         }
@@ -984,7 +1014,7 @@ int sys_mkdir(const char * pathname, int mode)
      * 则放回对应目录的i节点；复位新申请的i节点连接计数；放回该新的i节点，返回没有空间出错码退出。
      * 否则置新的i节点已修改标志
      */
-    if (!(inode->i_zone[0]=new_block(inode->i_dev))) {
+    if (!(inode->i_zone[0]=new_block(inode->i_dev, dir->i_zone[0]))) {
         iput(dir);
         inode->i_nlinks--;          /* i节点关联的目录（文件）项数 */
         iput(inode);
@@ -1228,6 +1258,8 @@ int sys_rmdir(const char * name)
      */
     if (inode->i_nlinks != 2)
         printk("empty directory has nlink!=2 (%d)",inode->i_nlinks);
+    dcache_remove(dir, basename, namelen);
+    dcache_invalidate(inode->i_dev, inode->i_num);  /* 该目录的i节点号可能被重用 */
     de->inode = 0;
     bh->b_dirt = 1;
     brelse(bh);
@@ -1329,6 +1361,7 @@ int sys_unlink(const char * name)
      * 现在我们可以删除文件名对应的目录项了。于是将该文件名目录项中的i节点号字段置为0，表示释放该项目，
      * 并设置包含该目录项的缓冲块已修改标志，释放该高速缓冲块
      */
+    dcache_remove(dir, basename, namelen);
     de->inode = 0;
     bh->b_dirt = 1;
     brelse(bh);
@@ -1392,7 +1425,7 @@ int sys_symlink(const char * oldname, const char * newname)
      * 的逻辑块号，然后置i节点已修改标志。如果申请失败则放回对应目录的i节点；复位新申请的i节点链接计数；放回该新的i节点，
      * 返回没有空间出错码退出
      */
-    if (!(inode->i_zone[0]=new_block(inode->i_dev))) {
+    if (!(inode->i_zone[0]=new_block(inode->i_dev, dir->i_zone[0]))) {
         iput(dir);
         inode->i_nlinks--;
         iput(inode);
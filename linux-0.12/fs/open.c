@@ -416,6 +416,9 @@ int sys_open(const char * filename, int flag, int mode)
 	f->f_count = 1;
 	f->f_inode = inode;
 	f->f_pos = 0;
+	f->f_ralast = 0;
+	f->f_raend = 0;
+	f->f_rawin = 0;
 	return (fd);
 }
 
@@ -465,6 +468,9 @@ int sys_close(unsigned int fd)
 	if (--filp->f_count) {
 		return (0);
 	}
+	if (filp->f_ep_links) {		/* 先从关注该文件的epoll实例中删除 */
+		ep_remove_file(filp);
+	}
 	iput(filp->f_inode);
 	return (0);
 }
@@ -5,6 +5,7 @@
  */
 
 #include <signal.h>			/* 信号头文件。定义信号符号常量，信号结构以及信号操作函数原型 */
+#include <string.h>			/* 字符串头文件。这里使用了其中的memcpy() */
 #include <errno.h>			/* 错误号头文件。包含系统中各种出错号。 */
 #include <termios.h>		/* 终端输入输出函数头文件。主要定义控制异步通信口的终端接口 */
 
@@ -12,6 +13,107 @@
 #include <linux/mm.h>	/* for get_free_page */	/* 使用其中的get_free_page */
 #include <asm/segment.h>	/* 段操作头文件。定义了有关段寄存器操作的嵌入式汇编函数 */
 #include <linux/kernel.h>	/* 内核头文件。含有一些内核常用函数的原型定义 */
+#include <linux/slab.h>		/* 对象缓存头文件 */
+
+/*
+ * 管道缓冲区由PIPE_PAGES个页面组成的环和描述它的pipe_buf结构构成(见include/linux/fs.h)。页面在
+ * 第一次被写入时才分配，所以只传少量数据的管道仍然只占用一个页面。
+ *
+ * 写入一整页且用户缓冲区页面对齐时，写进程的页面本身被放进环中(页面捐赠)：该页面与写进程写时复制
+ * 共享，不必复制数据。读进程读完这样的页面后就释放它，写进程再写自己的缓冲区时只需恢复页面的
+ * 可写标志。管道自己从不写共享页面，写入位置落到这种页面上时先换成一个私有页面。
+ */
+
+#define PIPE_SLOT(pos)	(((pos) >> 12) % PIPE_PAGES)	/* 字节位置pos所在的页面在环中的序号 */
+
+static struct kmem_cache * pipe_cachep;		/* pipe_buf结构的缓存 */
+
+/* pipe_buf的构造函数：空环，没有页面。释放时free_pipe_buf()把它恢复成这个状态 */
+static void pipe_buf_ctor(void * obj)
+{
+	struct pipe_buf * pb = (struct pipe_buf *) obj;
+	int i;
+
+	pb->head = pb->tail = 0;
+	for (i = 0; i < PIPE_PAGES; i++) {
+		pb->page[i] = 0;
+	}
+}
+
+/**
+ * 建立pipe_buf结构的缓存(在main()中调用)
+ * @retval		void
+ */
+void pipe_init(void)
+{
+	if (!(pipe_cachep = kmem_cache_create("pipe_buf", sizeof(struct pipe_buf), pipe_buf_ctor))) {
+		panic("pipe_init: no memory");
+	}
+}
+
+/**
+ * 为管道i节点分配管道缓冲区描述结构
+ * @param[in]	inode	管道i节点
+ * @retval		成功返回0，没有内存时返回-1
+ */
+int alloc_pipe_buf(struct m_inode * inode)
+{
+	struct pipe_buf * pb;
+
+	if (!(pb = (struct pipe_buf *) kmem_cache_alloc(pipe_cachep))) {
+		return -1;
+	}
+	inode->i_size = (unsigned long) pb;
+	return 0;
+}
+
+/**
+ * 释放管道缓冲区(在iput()中管道的最后一个引用被释放时调用)
+ * @param[in]	inode	管道i节点
+ * @retval		void
+ */
+void free_pipe_buf(struct m_inode * inode)
+{
+	struct pipe_buf * pb = PIPE_INFO(*inode);
+	int i;
+
+	for (i = 0; i < PIPE_PAGES; i++) {
+		free_page(pb->page[i]);		/* 0 is ok - ignored */
+		pb->page[i] = 0;
+	}
+	pb->head = pb->tail = 0;
+	kmem_cache_free(pipe_cachep, pb);
+	inode->i_size = 0;
+}
+
+/**
+ * 取环中第slot个页面，用于写入
+ * 页面还没有分配时分配一个；页面是捐赠来的共享页面时复制一个私有页面代替它。取新页面时可能睡眠，
+ * 这期间读进程可能已经释放了原来的页面，所以取到后要重新检查。
+ * @param[in]	pb		管道缓冲区
+ * @param[in]	slot	页面序号
+ * @retval		页面物理地址，没有内存时返回0
+ */
+static unsigned long pipe_write_page(struct pipe_buf * pb, int slot)
+{
+	unsigned long page, old;
+
+	while (!(old = pb->page[slot]) || mem_map[MAP_NR(old)] != 1) {
+		if (!(page = get_free_page())) {
+			return 0;
+		}
+		if (pb->page[slot] != old) {
+			free_page(page);
+			continue;
+		}
+		if (old) {
+			memcpy((char *) page, (char *) old, PAGE_SIZE);
+			free_page(old);
+		}
+		pb->page[slot] = page;
+	}
+	return old;
+}
 
 /**
  * 读管道
@@ -22,7 +124,8 @@
  */
 int read_pipe(struct m_inode * inode, char * buf, int count)
 {
-	int chars, size, read = 0;
+	struct pipe_buf * pb = PIPE_INFO(*inode);
+	int chars, size, offset, slot, read = 0;
 
 	/*
 	 * 如果需要读取的字节计数count大于0，我们就循环执行以下操作。在循环读操作过程中，若当前管道中没有数据（size=0）
@@ -45,29 +148,30 @@ int read_pipe(struct m_inode * inode, char * buf, int count)
 			interruptible_sleep_on(& PIPE_READ_WAIT(*inode));
 		}
 		/*
-		 * 此时说明管道（缓冲区）中有数据。于是我们取管道尾指针到缓冲区末端的字节数chars。如果其大于还需要读取的
-		 * 字节数count，则令其等于count。如果chars大于当前管道中含有数据的长度size，则令其等于size。然后把需读
-		 * 字节数count减去此次可读的字节数chars，并累加已读字节数read
+		 * 此时说明管道（缓冲区）中有数据。每次最多读到管道尾指针所在页面的末端，chars不超过还需要读取的字节数count
+		 * 和管道中的数据长度size
 		 */
-		/* chars表示当次循环可读取的字节数 */
-		chars = PAGE_SIZE - PIPE_TAIL(*inode);
+		offset = pb->tail & (PAGE_SIZE - 1);
+		slot = PIPE_SLOT(pb->tail);
+		chars = PAGE_SIZE - offset;
 		if (chars > count) {
 			chars = count;
 		}
 		if (chars > size) {
 			chars = size;
 		}
-		count -= chars;
-		read += chars;
 		/*
-		 * 再令size指向管道尾指针处，并调整当前管道尾指针（前移chars字节）。若尾指针超过管道末端则绕回。然后
-		 * 将管道中的数据复制到用户缓冲区中。对于管道i节点，其i_size字段中是管道缓冲块指针
+		 * 先复制数据再移动尾指针，这样复制时发生缺页而睡眠，写进程也不会覆盖还没有读走的数据。读完一个页面时，
+		 * 如果它是捐赠来的共享页面就释放它，让写进程的页面尽快恢复独占
 		 */
-		size = PIPE_TAIL(*inode);
-		PIPE_TAIL(*inode) += chars;
-		PIPE_TAIL(*inode) &= (PAGE_SIZE-1);
-		while (chars-->0) {
-			put_fs_byte(((char *)inode->i_size)[size++], buf++);
+		copy_to_user(buf, (char *) pb->page[slot] + offset, chars);
+		buf += chars;
+		count -= chars;
+		read += chars;
+		pb->tail += chars;
+		if (!(pb->tail & (PAGE_SIZE - 1)) && mem_map[MAP_NR(pb->page[slot])] != 1) {
+			free_page(pb->page[slot]);
+			pb->page[slot] = 0;
 		}
 	}
 	/* 当此次读管道操作结束，则唤醒等待该管道的进程，并返回读取的字节数 */
@@ -78,6 +182,8 @@ int read_pipe(struct m_inode * inode, char * buf, int count)
 
 /**
  * 写管道
+ * 不超过PIPE_BUF字节的写操作是原子的：要等管道中有足够的空间一次写完，数据才不会与其他写进程的
+ * 数据交错。
  * @param[in]	inode		管道对应的i节点
  * @param[in]	buf			数据缓冲区指针
  * @param[in]	count		将写入管道的字节数
@@ -85,51 +191,63 @@ int read_pipe(struct m_inode * inode, char * buf, int count)
  */
 int write_pipe(struct m_inode * inode, char * buf, int count)
 {
-	int chars, size, written = 0;
+	struct pipe_buf * pb = PIPE_INFO(*inode);
+	unsigned long page;
+	int chars, size, offset, slot, written = 0;
+	int need = (count <= PIPE_BUF) ? count : 1;
 
 	/*
-	 * 如果要写入的字节数count还大于0，那么我们就循环执行以下操作。在循环操作过程中，如果当前管道中已经满了
-	 * （空闲空间size=0），则唤醒等待该管道的进程，通知唤醒的是读管道进程。如果已没有读管道者，即i节点引用计数
-	 * 值小于2，则向当前进程发送SIGPIPE信号，并返回已写入的字节数退出；若写入0字节，则返回-1.否则让当前进程
-	 * 在该管道上睡眠，以等待读管道进程来读取数据，从而让管道腾出空间。宏PIPE_SIZE()、PIPE_HEAD()等定义在
-	 * 文件include/linux/fs.h中
+	 * 如果要写入的字节数count还大于0，那么我们就循环执行以下操作。在循环操作过程中，如果当前管道中的空闲空间
+	 * 不足need字节，则唤醒等待该管道的进程，通知唤醒的是读管道进程。如果已没有读管道者，即i节点引用计数
+	 * 值小于2，则向当前进程发送SIGPIPE信号，并返回已写入的字节数退出；若写入0字节，则返回-1.如果收到了信号，
+	 * 则返回已写入的字节数或重新启动系统调用号。否则让当前进程在该管道上可中断地睡眠，以等待读管道进程来读取
+	 * 数据，从而让管道腾出空间
 	 */
 	while (count > 0) {
-		while (!(size = (PAGE_SIZE-1) - PIPE_SIZE(*inode))) {
+		while ((size = PIPE_BUF_SIZE - PIPE_SIZE(*inode)) < need) {
 			wake_up(& PIPE_READ_WAIT(*inode));
 			/* 没有读进程，发出SIGPIPE信号并立即返回 */
 			if (inode->i_count != 2) { /* no readers */
 				current->signal |= (1<<(SIGPIPE-1));
 				return written ? written : -1;
 			}
-			sleep_on(& PIPE_WRITE_WAIT(*inode));
+			if (current->signal & ~current->blocked) {
+				return written ? written : -ERESTARTSYS;
+			}
+			interruptible_sleep_on(& PIPE_WRITE_WAIT(*inode));
 		}
+		need = 1;
 		/*
-		 * 程序执行到这里表示管道缓冲区中有可写空间size，于是我们取管道头指针到缓冲区末端空间字节数chars。写管道
-		 * 操作是从管道头指针处开始写的。如果chars大于需要写入的字节数count，则令其等于count，如果chars大于当前
-		 * 管道中空闲空间长度size，则令其等于size。然后把需要写入字节数count减去此次可写入的字节数chars，并把
-		 * 写入字节数累加到written中
+		 * 程序执行到这里表示管道缓冲区中有可写空间size。每次最多写到管道头指针所在页面的末端，chars不超过
+		 * 需要写入的字节数count和空闲空间size
 		 */
-		/* chars表示当次循环可写入的字节数 */
-		chars = PAGE_SIZE - PIPE_HEAD(*inode);
+		offset = pb->head & (PAGE_SIZE - 1);
+		slot = PIPE_SLOT(pb->head);
+		chars = PAGE_SIZE - offset;
 		if (chars > count) {
 			chars = count;
 		}
 		if (chars > size) {
 			chars = size;
 		}
-		count -= chars;
-		written += chars;
-		/* 
-		 * 再令size指向管道数据头指针处，并调整当前管道数据头指针（前移chars字节）。若头指针超过管道末端则绕回。
-		 * 然后从用户缓冲区复制chars个字节到管道头指针开始处。对于管道i节点，其i_size字段中是管道缓冲块指针
+		/*
+		 * 要写满整个页面且用户缓冲区页面对齐时，尝试直接把用户页面放进环中。此时空闲空间至少一页，读进程不会
+		 * 还在使用这个位置上的页面。用户页面不在内存中时退回到复制
 		 */
-		size = PIPE_HEAD(*inode);
-		PIPE_HEAD(*inode) += chars;
-		PIPE_HEAD(*inode) &= (PAGE_SIZE-1);
-		while (chars-->0) {
-			((char *)inode->i_size)[size++] = get_fs_byte(buf++);
+		if (chars == PAGE_SIZE && !((unsigned long) buf & (PAGE_SIZE - 1)) &&
+		    (page = share_user_page(get_base(current->ldt[2]) + (unsigned long) buf))) {
+			free_page(pb->page[slot]);
+			pb->page[slot] = page;
+		} else {
+			if (!(page = pipe_write_page(pb, slot))) {
+				return written ? written : -ENOMEM;
+			}
+			copy_from_user((char *) page + offset, buf, chars);
 		}
+		buf += chars;
+		count -= chars;
+		written += chars;
+		pb->head += chars;
 	}
 	/* 当此次写管道操作结束，则唤醒等待该管道的进程，并返回已写入的字节数，退出 */
 	wake_up(& PIPE_READ_WAIT(*inode));
@@ -24,6 +24,7 @@
 #include <const.h>			/* 常数符号头文件。目前仅定义i节点中i_mode字段的各标志位 */
 #include <errno.h>			/* 错误号头文件。包含系统中各种出错号。 */
 #include <sys/time.h>
+#include <sys/epoll.h>		/* epoll头文件。定义了poll_file()返回的事件位 */
 #include <signal.h>			/* 信号头文件。定义信号符号常量，信号结构以及信号操作函数原型 */
 
 /*
@@ -75,7 +76,7 @@ static void add_wait(struct task_struct ** wait_address, select_table * p)
 	 * 过，若设置过也立刻返回。这个检查主要是针对管道文件描述符。例如若一个管道在等待可以进行读操作，那么其他必定可以立刻
 	 * 进行写操作
 	 */
-	if (!wait_address) {
+	if (!wait_address || !p) {	/* p为NULL表示只查询状态(poll_file()) */
 		return;
 	}
 	for (i = 0; i < p->nr; i++) {
@@ -116,7 +117,7 @@ static void free_wait(select_table * p)
 	for (i = 0; i < p->nr ; i++) {
 		tpp = p->entry[i].wait_address;
 		while (*tpp && *tpp != current) {
-			(*tpp)->state = 0;
+			wake_up_process(*tpp);
 			current->state = TASK_UNINTERRUPTIBLE;
 			schedule();
 		}
@@ -129,7 +130,7 @@ static void free_wait(select_table * p)
 			printk("free_wait: NULL");
 		}
 		if ((*tpp = p->entry[i].old_task)) {
-			(**tpp).state = 0;
+			wake_up_process(*tpp);
 		}
 	}
 	p->nr = 0;
@@ -271,6 +272,54 @@ static int check_ex(select_table * wait, struct m_inode * inode)
 }
 
 
+/**
+ * 不等待地查询文件的就绪状态
+ * 供epoll使用，它只在文件被唤醒后才调用本函数，所以不需要扫描所有描述符。
+ * @param[in]	inode	文件i节点指针
+ * @retval		EPOLLIN、EPOLLOUT、EPOLLHUP的组合
+ */
+int poll_file(struct m_inode * inode)
+{
+	int mask = 0;
+
+	if (check_in(NULL, inode)) {
+		mask |= EPOLLIN;
+	}
+	if (check_out(NULL, inode)) {
+		mask |= EPOLLOUT;
+	}
+	if (check_ex(NULL, inode)) {
+		mask |= EPOLLHUP;
+	}
+	return mask;
+}
+
+/**
+ * 取文件的读、写等待队列
+ * 文件可读或可写时，相应的等待队列一定会被wake_up()。
+ * @param[in]	inode	文件i节点指针
+ * @param[out]	in		读等待队列头指针的地址
+ * @param[out]	out		写等待队列头指针的地址
+ * @retval		文件是终端或管道时返回0，其余文件不支持，返回-1
+ */
+int poll_queues(struct m_inode * inode,
+	struct task_struct *** in, struct task_struct *** out)
+{
+	struct tty_struct * tty;
+
+	if ((tty = get_tty(inode))) {
+		*in = &tty->secondary->proc_list;
+		*out = &tty->write_q->proc_list;
+	} else if (inode->i_pipe) {
+		*in = &PIPE_READ_WAIT(*inode);
+		*out = &PIPE_WRITE_WAIT(*inode);
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
+
 /**
  * do_select()是内核执行select()系统调用的实际处理函数。该函数首先检查描述符集中各个描述符的有
  * 效性，然后分别调用相关描述符集描述符检查函数check_XX()对每个描述符进行检查，同时统计描述符
@@ -431,7 +480,7 @@ int sys_select( unsigned long *buffer )
 	 * 结构中设置的时间值，经转换和加上系统当前滴答值jiffies，最后得到需要等待的时间滴答数值timeout。我们用此值来设置当前进程应该
 	 * 等待的延时。另外，tv_usec字段是微秒值，把它除以1000000后得到对应秒数，再成祎系统每秒滴答数HZ，即把tv_usec转换成滴答值
 	 */
-	timeout = 0xffffffff;
+	timeout = TIMEOUT_FOREVER;
 	if (tvp) {
 		timeout = get_fs_long((unsigned long *)&tvp->tv_usec) / (1000000 / HZ);
 		timeout += get_fs_long((unsigned long *)&tvp->tv_sec) * HZ;
@@ -447,7 +496,7 @@ int sys_select( unsigned long *buffer )
 	 */
 	cli();		/* 禁止响应中断 */
 	i = do_select(in, out, ex, &res_in, &res_out, &res_ex);
-	if (current->timeout > jiffies) {
+	if (current->timeout && !timeout_expired(current->timeout)) {
 		timeout = current->timeout - jiffies;
 	} else {
 		timeout = 0;
@@ -176,6 +176,7 @@ void put_super(int dev)
 	 * 并返回
 	 */
 	lock_super(sb);
+	dcache_invalidate(dev, 0);	/* 丢弃该文件系统的目录项缓存 */
 	sb->s_dev = 0;	/* 置超级块空闲 */
 	/* 释放该设备上文件系统i节点位图和逻辑位图在缓冲区中所占用的缓冲块 */
 	for(i = 0; i < I_MAP_SLOTS; i++) {
@@ -309,6 +310,7 @@ static struct super_block * read_super(int dev)
 	/* 0号i节点和0号逻辑块不可用 */
 	s->s_imap[0]->b_data[0] |= 1;
 	s->s_zmap[0]->b_data[0] |= 1;
+	init_bitmap_hints(s);		/* fs/bitmap.c */
 	free_super(s);
 	return s;
 }
@@ -487,6 +489,7 @@ void mount_root(void)
 		printk("Insert root floppy and press ENTER\n\r");
 		wait_for_keypress();
 	}
+	dcache_init();		/* 初始化目录项缓存 fs/dcache.c */
 	/* 初始化超级块表 */
 	for(p = &super_block[0]; p < &super_block[NR_SUPER]; p++) {
 		p->s_dev = 0;
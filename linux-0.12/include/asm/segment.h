@@ -69,6 +69,99 @@ static inline void put_fs_long(unsigned long val,unsigned long * addr)
 	__asm__ ("movl %0,%%fs:%1"::"r" (val),"m" (*addr));
 }
 
+/*
+ * 成块复制用户空间(fs段)数据。不足8字节时逐字节复制；否则先逐字节复制到目的地址4字节对齐，
+ * 再用rep movsl按长字复制，最后复制剩下的0~3字节。写用户空间之前调用者必须已经对目的区域
+ * 执行过verify_area()(sys_read()已对整个用户缓冲区做过)，否则在386上写时复制不会发生。
+ * 复制过程中可能发生缺页，rep movs指令在缺页处理后会从中断处继续执行。
+ */
+
+/**
+ * 从内核空间复制n字节到用户空间(fs段)
+ * @param[in]	to		用户空间目的地址
+ * @param[in]	from	内核空间源地址
+ * @param[in]	n		字节数
+ */
+static inline void copy_to_user(char * to, const char * from, unsigned long n)
+{
+	int d0, d1, d2;
+
+	__asm__ __volatile__("cld\n\t"
+		"push %%es\n\t"
+		"push %%fs\n\t"
+		"pop %%es\n\t"				/* es = fs，movs的目的操作数总在es段 */
+		"cmpl $8,%%ecx\n\t"
+		"jb 3f\n"
+		"1:\ttestl $3,%%edi\n\t"
+		"je 2f\n\t"
+		"movsb\n\t"
+		"decl %%ecx\n\t"
+		"jmp 1b\n"
+		"2:\tmovl %%ecx,%%eax\n\t"
+		"shrl $2,%%ecx\n\t"
+		"rep ; movsl\n\t"
+		"movl %%eax,%%ecx\n\t"
+		"andl $3,%%ecx\n"
+		"3:\trep ; movsb\n\t"
+		"pop %%es"
+		:"=&c" (d0), "=&D" (d1), "=&S" (d2)
+		:"0" (n), "1" (to), "2" (from)
+		:"ax", "memory");
+}
+
+/**
+ * 从用户空间(fs段)复制n字节到内核空间
+ * @param[in]	to		内核空间目的地址
+ * @param[in]	from	用户空间源地址
+ * @param[in]	n		字节数
+ */
+static inline void copy_from_user(char * to, const char * from, unsigned long n)
+{
+	int d0, d1, d2;
+
+	__asm__ __volatile__("cld\n\t"
+		"cmpl $8,%%ecx\n\t"
+		"jb 3f\n"
+		"1:\ttestl $3,%%edi\n\t"
+		"je 2f\n\t"
+		"fs ; movsb\n\t"			/* 源操作数用fs段超越前缀 */
+		"decl %%ecx\n\t"
+		"jmp 1b\n"
+		"2:\tmovl %%ecx,%%eax\n\t"
+		"shrl $2,%%ecx\n\t"
+		"rep ; fs ; movsl\n\t"
+		"movl %%eax,%%ecx\n\t"
+		"andl $3,%%ecx\n"
+		"3:\trep ; fs ; movsb"
+		:"=&c" (d0), "=&D" (d1), "=&S" (d2)
+		:"0" (n), "1" (to), "2" (from)
+		:"ax", "memory");
+}
+
+/**
+ * 把用户空间(fs段)中的n字节清零
+ * @param[in]	to		用户空间地址
+ * @param[in]	n		字节数
+ */
+static inline void clear_user(char * to, unsigned long n)
+{
+	int d0, d1;
+
+	__asm__ __volatile__("cld\n\t"
+		"push %%es\n\t"
+		"push %%fs\n\t"
+		"pop %%es\n\t"
+		"shrl $2,%%ecx\n\t"
+		"rep ; stosl\n\t"
+		"movl %%edx,%%ecx\n\t"
+		"andl $3,%%ecx\n\t"
+		"rep ; stosb\n\t"
+		"pop %%es"
+		:"=&c" (d0), "=&D" (d1)
+		:"a" (0), "0" (n), "1" (to), "d" (n)
+		:"memory");
+}
+
 /*
  * Someone who knows GNU asm better than I should double check the followig.
  * It seems to work, but I don't know if I'm doing something subtly wrong.
@@ -21,6 +21,10 @@ __asm__ (										\
 #define cli() __asm__ ("cli"::)			/* 关中断 */
 #define nop() __asm__ ("nop"::)			/* 空操作 */
 
+/* 保存/恢复标志寄存器(主要是中断允许标志)，用于可能在关中断时被调用的代码 */
+#define save_flags(x) __asm__ __volatile__("pushfl ; popl %0":"=r" (x)::"memory")
+#define restore_flags(x) __asm__ __volatile__("pushl %0 ; popfl"::"r" (x):"memory")
+
 #define iret() __asm__ ("iret"::)		/* 中断返回 */
 
 /**
@@ -117,3 +121,32 @@ __asm__ (															\
  * @param[in]	addr	描述符项中段的基地址值
  */
 #define set_ldt_desc(n, addr)	_set_tssldt_desc(((char *) (n)),addr, "0x82")
+
+/* 读时间戳计数器，结果的低32位放到lo，高32位放到hi */
+#define rdtsc(lo, hi) __asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi))
+
+/*
+ * CPU是否有时间戳计数器。能改变EFLAGS的ID位(位21)说明CPU支持cpuid指令，cpuid功能1返回的
+ * edx位4是TSC标志。没有TSC时执行rdtsc会产生无效操作码异常。
+ */
+static inline int cpu_has_tsc(void)
+{
+	unsigned long f1, f2, edx;
+
+	__asm__("pushfl\n\t"
+		"popl %0\n\t"
+		"movl %0,%1\n\t"
+		"xorl $0x200000,%0\n\t"
+		"pushl %0\n\t"
+		"popfl\n\t"
+		"pushfl\n\t"
+		"popl %0\n\t"
+		"pushl %1\n\t"
+		"popfl"
+		: "=&r" (f1), "=&r" (f2));
+	if (!((f1 ^ f2) & 0x200000)) {
+		return 0;
+	}
+	__asm__("cpuid" : "=d" (edx) : "a" (1) : "bx", "cx");
+	return (edx & 0x10) != 0;
+}
@@ -60,10 +60,11 @@ void buffer_init(long buffer_end);			/* 高速缓冲区初始化 */
 #define SUPER_MAGIC 	0x137F				/* 文件系统魔数 */
 
 #define NR_OPEN 		20					/* 进程最多打开文件数 */
-#define NR_INODE 		64					/* 系统同时最多使用i节点个数 */
+#define NR_INODE 		nr_inodes			/* 内存i节点表项数，启动时由inode_init()确定 */
+#define MIN_NR_INODE	64					/* 内存i节点表项数的下限 */
+#define MAX_NR_INODE	2048				/* 内存i节点表项数的上限 */
 #define NR_FILE 		64					/* 系统最多文件个数(文件数组长度) */
 #define NR_SUPER 		8					/* 系统所含超级块个数(超级块数组长度) */
-#define NR_HASH 		307					/* 缓冲区Hash表数组长度 */
 #define NR_BUFFERS 		nr_buffers			/* 系统所含缓冲个数，初始化后不再改变 */
 #define BLOCK_SIZE 		1024				/* 数据块长度(字节值) */
 #define BLOCK_SIZE_BITS 10					/* 数据块长度所占比特位数 */
@@ -79,11 +80,42 @@ void buffer_init(long buffer_end);			/* 高速缓冲区初始化 */
 #define PIPE_READ_WAIT(inode) 	((inode).i_wait)
 #define PIPE_WRITE_WAIT(inode) 	((inode).i_wait2)
 
-#define PIPE_HEAD(inode) 		((inode).i_zone[0])		/* 管道头部指针 */
-#define PIPE_TAIL(inode) 		((inode).i_zone[1])		/* 管道尾部指针 */
-#define PIPE_SIZE(inode)		((PIPE_HEAD(inode) - PIPE_TAIL(inode)) & (PAGE_SIZE - 1))	/* 管道大小 */
+/*
+ * 管道缓冲区是由PIPE_PAGES个页面组成的环，页面在第一次写入时才分配。管道i节点的i_size字段指向
+ * 描述该环的pipe_buf结构(见fs/pipe.c)。head和tail是写入和读出的字节总数，二者之差就是管道中的
+ * 数据量，所以整个环都可以装满，不必空出一个字节来区分空和满。
+ */
+#define PIPE_PAGES		4							/* 管道缓冲区页面数 */
+#define PIPE_BUF_SIZE	(PIPE_PAGES * 4096)			/* 管道缓冲区容量 */
+#define PIPE_BUF		4096						/* 不超过该长度的写操作是原子的 */
+
+struct pipe_buf {
+	unsigned long head;							/* 已写入的字节总数 */
+	unsigned long tail;							/* 已读出的字节总数 */
+	unsigned long page[PIPE_PAGES];				/* 环中各页面的物理地址，0表示尚未分配 */
+};
+
+#define PIPE_INFO(inode)		((struct pipe_buf *) (inode).i_size)
+#define PIPE_HEAD(inode) 		(PIPE_INFO(inode)->head)		/* 管道头部指针 */
+#define PIPE_TAIL(inode) 		(PIPE_INFO(inode)->tail)		/* 管道尾部指针 */
+#define PIPE_SIZE(inode)		(PIPE_HEAD(inode) - PIPE_TAIL(inode))	/* 管道大小 */
 #define PIPE_EMPTY(inode) 		(PIPE_HEAD(inode) == PIPE_TAIL(inode))	/* 管道空 */
-#define PIPE_FULL(inode) 		(PIPE_SIZE(inode) == (PAGE_SIZE - 1))	/* 管道满 */
+#define PIPE_FULL(inode) 		(PIPE_SIZE(inode) == PIPE_BUF_SIZE)	/* 管道满 */
+
+/* 块设备ioctl命令(kernel/blk_drv/elevator.c)：查询/设置设备的I/O调度策略 */
+#define BLKGETSCHED		0x1201
+#define BLKSETSCHED		0x1202
+#define BLKRAGET		0x1203		/* 取设备的最大预读块数 */
+#define BLKRASET		0x1204		/* 设置设备的最大预读块数(不超过MAX_READAHEAD) */
+
+#define MAX_READAHEAD	128
+
+/* I/O调度策略编号 */
+#define ELV_NOOP		0		/* 先来先服务 */
+#define ELV_ELEVATOR	1		/* 电梯算法，读请求优先 */
+#define ELV_CLOOK		2		/* 单向循环扫描 */
+#define ELV_DEADLINE	3		/* C-LOOK加读/写期限 */
+#define NR_ELEVATOR		4
 
 #define NIL_FILP	((struct file *)0)	/* 空文件结构指针 */
 #define SEL_IN		1
@@ -106,17 +138,31 @@ struct buffer_head {
 										/* 修改标志：0未修改，1已修改 */
 	unsigned char b_count;				/* users using this block */
 										/* 使用用户数 */
-	unsigned char b_lock;				/* 0 - ok, 1 -locked */	
+	unsigned char b_lock;				/* 0 - ok, 1 -locked */
 										/* 缓冲区是否被锁定 */
+	unsigned char b_list;				/* 所在的替换链表(BUF_CLEAN/BUF_LOCKED/BUF_DIRTY) */
+	unsigned char b_ref;				/* CLOCK算法的访问位，命中时置1 */
+	unsigned long b_flushtime;			/* 脏块最迟应写盘的时刻(滴答数)，进入脏链表时设置 */
 	struct task_struct * b_wait;		/* 指向等待该缓冲区解锁的任务 */
 
 	/* 这四个指针用于缓冲区的管理 */
 	struct buffer_head * b_prev;		/* hash队列上的前一块 */
 	struct buffer_head * b_next;		/* hash队列上的后一块 */
-	struct buffer_head * b_prev_free;	/* 空闲表上的前一块 */
-	struct buffer_head * b_next_free;	/* 空闲表上的后一块 */
+	struct buffer_head * b_prev_free;	/* 替换链表上的前一块 */
+	struct buffer_head * b_next_free;	/* 替换链表上的后一块 */
+	struct buffer_head * b_reqnext;		/* 合并请求项中的下一缓冲块(blk_drv/ll_rw_blk.c) */
 };
 
+/*
+ * 缓冲块替换链表类型。每个缓冲块都挂在其中一个双向循环链表上：干净块可直接被替换，
+ * 脏块需要先写盘，上锁块正在进行I/O。由于b_dirt、b_lock在各处被直接修改，链表归属
+ * 只是一种提示，由refile_buffer()在brelse()和扫描时惰性地修正。
+ */
+#define BUF_CLEAN		0					/* 干净、未上锁 */
+#define BUF_LOCKED		1					/* 正在读写(上锁) */
+#define BUF_DIRTY		2					/* 已修改，等待写盘 */
+#define NR_LIST			3
+
 /* 磁盘上的索引节点(i节点)数据结构 */
 struct d_inode {
 	unsigned short i_mode;				/* 文件类型和属性(rwx位) */
@@ -149,18 +195,32 @@ struct m_inode {
 	unsigned char i_lock;				/* 锁定标志 */
 	unsigned char i_dirt;				/* 已修改(脏)标志 */
 	unsigned char i_pipe;				/* 管道标志 */
+	unsigned char i_epoll;				/* epoll实例标志(i_size指向struct eventpoll) */
 	unsigned char i_mount;				/* 安装标志 */
 	unsigned char i_seek;				/* 搜寻标志(lseek时) */
 	unsigned char i_update;				/* 更新标志 */
+	unsigned short i_lastzone;			/* 最近为该文件分配的逻辑块号，作为下次分配的目标 */
+	unsigned short i_dgen;				/* 目录：添加目录项时加1，见fs/namei.c中的find_entry() */
+	struct m_inode * i_hash_next;		/* hash队列上的后一项 */
+	struct m_inode * i_hash_prev;		/* hash队列上的前一项 */
+	struct m_inode * i_next_free;		/* 空闲链表上的后一项，不在链表上时为NULL */
+	struct m_inode * i_prev_free;		/* 空闲链表上的前一项 */
 };
 
 /* 文件结构(用于在文件句柄与i节点之间建立关系) */
+struct epitem;
+
 struct file {
 	unsigned short f_mode;				/* 文件操作模式(RW位) */
 	unsigned short f_flags;				/* 文件打开和控制的标志 */
 	unsigned short f_count;				/* 对应文件引用计数值 */
 	struct m_inode *f_inode;			/* 指向对应i节点 */
 	off_t f_pos;						/* 文件位置(读写偏移值) */
+	/* 以下用于普通文件的顺序预读(fs/file_dev.c) */
+	off_t f_ralast;						/* 上次读操作结束时的文件位置 */
+	unsigned long f_raend;				/* 已发出预读的最后一块的下一块(文件内块号) */
+	unsigned short f_rawin;				/* 当前预读窗口(块数) */
+	struct epitem * f_ep_links;			/* 监视该文件的epoll项链表(fs/eventpoll.c) */
 };
 
 /* 内存中的超级块结构 */
@@ -184,6 +244,10 @@ struct super_block {
 	unsigned char s_lock;				/* 被锁定标志 */
 	unsigned char s_rd_only;			/* 只读标志 */
 	unsigned char s_dirt;				/* 已修改(脏)标志 */
+	unsigned short s_zmap_free[Z_MAP_SLOTS];	/* 各逻辑块位图块中的空闲位数 */
+	unsigned short s_imap_free[I_MAP_SLOTS];	/* 各i节点位图块中的空闲位数 */
+	unsigned short s_zone_hint;			/* 最近分配的逻辑块在位图中的位号 */
+	unsigned short s_inode_hint;		/* 最近分配的i节点号 */
 };
 
 /* 磁盘上的超级块结构 */
@@ -204,11 +268,14 @@ struct dir_entry {
 	char name[NAME_LEN];				/* 文件名，长度NAME_LEN=14 */
 };
 
-extern struct m_inode inode_table[NR_INODE];	/* 定义i节点表数组(64项) */
+extern struct m_inode * inode_table;			/* i节点表数组(NR_INODE项) */
+extern int nr_inodes;
 extern struct file file_table[NR_FILE];			/* 文件表数组(64项) */
 extern struct super_block super_block[NR_SUPER];/* 超级块数组(8项) */
 extern struct buffer_head * start_buffer;		/* 缓冲区起始内存位置 */
 extern int nr_buffers;
+extern int nr_buffers_type[NR_LIST];			/* 各替换链表上的缓冲块数 */
+extern int read_ahead[];						/* 各块设备的最大预读块数(以主设备号为索引) */
 
 /**** 磁盘操作函数原型 ****/
 /* 检测驱动器中软盘是否改变 */
@@ -264,10 +331,22 @@ extern struct m_inode * get_empty_inode(void);
 
 /* 获取(申请)管道节点 */
 extern struct m_inode * get_pipe_inode(void);
+extern int alloc_pipe_buf(struct m_inode * inode);
+extern void free_pipe_buf(struct m_inode * inode);
+extern void pipe_init(void);
 
 /* 在哈希表中查找指定的数据块 */
 extern struct buffer_head * get_hash_table(int dev, int block);
 
+/* 目录项缓存(fs/dcache.c) */
+extern void dcache_init(void);
+extern int dcache_lookup(struct m_inode * dir, const char * name, int len,
+	int * block, int * entry);
+extern void dcache_add(struct m_inode * dir, const char * name, int len,
+	int ino, int block, int entry);
+extern void dcache_remove(struct m_inode * dir, const char * name, int len);
+extern void dcache_invalidate(int dev, int dir);
+
 /* 从设备读取指定块 */
 extern struct buffer_head * getblk(int dev, int block);
 
@@ -276,6 +355,7 @@ extern void ll_rw_block(int rw, struct buffer_head * bh);
 
 /* 读/写数据页面 */
 extern void ll_rw_page(int rw, int dev, int nr, char * buffer);
+extern void ll_rw_swap(int rw, int dev, int nr, char ** buffers, int count);
 
 /* 释放指定缓冲块 */
 extern void brelse(struct buffer_head * buf);
@@ -289,12 +369,15 @@ extern void bread_page(unsigned long addr, int dev, int b[4]);
 /* 读取头一个指定的数据块，并标记后续将要读的块 */
 extern struct buffer_head * breada(int dev, int block, ...);
 
-/* 向设备dev申请一个磁盘块 */
-extern int new_block(int dev);
+/* 向设备dev申请一个磁盘块，尽量靠近逻辑块goal */
+extern int new_block(int dev, int goal);
 
 /* 释放设备数据区中的逻辑块 */
 extern int free_block(int dev, int block);
 
+/* 统计超级块中各位图块的空闲位数，初始化分配提示 */
+extern void init_bitmap_hints(struct super_block * sb);
+
 /* 为设备dev建立一个新i节点 */
 extern struct m_inode * new_inode(int dev);
 
@@ -304,6 +387,9 @@ extern void free_inode(struct m_inode * inode);
 /* 刷新指定设备缓冲区块 */
 extern int sync_dev(int dev);
 
+/* 缓冲区回写任务的主循环(fs/buffer.c)，由kernel_thread()启动 */
+extern void bdflush_thread(void);
+
 /* 读取指定设备的超级块 */
 extern struct super_block * get_super(int dev);
 
@@ -313,6 +399,27 @@ extern void put_super(int dev);
 /* 释放设备dev在内存i节点表中的所有i节点 */
 extern void invalidate_inodes(int dev);
 
+/* 确定内存i节点表的大小并为其分配内存 */
+extern void inode_init(long buffer_end);
+
+/* 把i节点加入hash队列 */
+extern void insert_inode_hash(struct m_inode * inode);
+
+/* 清空不再使用的i节点 */
+extern void clear_inode(struct m_inode * inode);
+
+/* 不等待地查询文件的就绪状态，以及取得文件的读、写等待队列(fs/select.c) */
+extern int poll_file(struct m_inode * inode);
+extern int poll_queues(struct m_inode * inode,
+	struct task_struct *** in, struct task_struct *** out);
+
+/* epoll(fs/eventpoll.c)。wake_up()在有epoll项挂在等待队列上时调用ep_wakeup() */
+extern int ep_nr_hooks;
+extern void ep_wakeup(struct task_struct ** p);
+extern void ep_remove_file(struct file * filp);
+extern void ep_free(struct m_inode * inode);
+extern void ep_init(void);
+
 extern int ROOT_DEV;
 
 /* 安装根文件系统 */
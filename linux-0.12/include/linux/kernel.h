@@ -10,6 +10,7 @@ void console_print(const char * str);   /* 控制台显示函数 */
 int tty_write(unsigned ch,char * buf,int count);/* 往tty上写指定长度的字符串 */
 void * malloc(unsigned int size);       /* 通用内核内存分配函数 */
 void free_s(void * obj, int size);      /* 释放指定对象占用的内存 */
+void malloc_info(void);                 /* 显示存储桶占用的页面数 */
 extern void hd_times_out(void);         /* 硬盘处理超时 */
 extern void sysbeepstop(void);          /* 停止蜂鸣 */
 extern void blank_screen(void);         /* 黑屏处理 */
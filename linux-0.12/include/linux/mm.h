@@ -11,12 +11,18 @@ extern int SWAP_DEV;
 #define read_swap_page(nr,buffer) ll_rw_page(READ,SWAP_DEV,(nr),(buffer));
 #define write_swap_page(nr,buffer) ll_rw_page(WRITE,SWAP_DEV,(nr),(buffer));
 
+#define SWAP_CLUSTER	8		/* 交换空间按簇分配，一簇的页面一次写出或读入 */
+
 extern unsigned long get_free_page(void);
+extern unsigned long __get_free_pages(int order);
+extern void free_pages(unsigned long addr, int order);
 extern unsigned long put_dirty_page(unsigned long page,unsigned long address);
 extern void free_page(unsigned long addr);
+extern unsigned long share_user_page(unsigned long address);
 extern void init_swapping(void);
 void swap_free(int page_nr);
 void swap_in(unsigned long *table_ptr);
+void swap_read(int swap_nr, char * buffer);
 
 static inline void oom(void)
 {
@@ -39,6 +45,30 @@ extern unsigned long HIGH_MEMORY;		/* 物理内存地址高端 */
 
 extern unsigned char mem_map [ PAGING_PAGES ];
 
+/*
+ * 交换缓存(mm/swap.c)。从交换设备读入后还没有被写过的页面仍占着它的交换页面，swap_cache[]记
+ * 录该页面号，页面再被换出时不必写盘。这种页面以只读方式映射，第一次写时由un_wp_page()把它从缓存
+ * 中删除。
+ */
+extern unsigned short swap_cache [ PAGING_PAGES ];
+
+/* 把物理页面(页面号nr)从交换缓存中删除，释放它的交换页面 */
+static inline void delete_from_swap_cache(unsigned long nr)
+{
+	if (swap_cache[nr]) {
+		swap_free(swap_cache[nr]);
+		swap_cache[nr] = 0;
+	}
+}
+
+/*
+ * 伙伴系统的空闲块链表数。第order个链表中是长度为2^order页、起始页面号按2^order对齐的空闲块，
+ * 所以一次最多能分配连续的2^(NR_MEM_LISTS-1)页(128KB)。
+ */
+#define NR_MEM_LISTS 6
+
+extern int nr_free_pages;
+
 #define PAGE_DIRTY		0x40		/* 脏位 */
 #define PAGE_ACCESSED	0x20		/* 已访问位 */
 #define PAGE_USER		0x04		/* 用户/超级用户位 */
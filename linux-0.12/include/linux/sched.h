@@ -34,6 +34,7 @@
 #include <linux/head.h>
 #include <linux/fs.h>
 #include <linux/mm.h>
+#include <linux/timer.h>
 #include <sys/param.h>
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -102,6 +103,9 @@ struct tss_struct {
 	struct i387_struct i387;
 };
 
+struct prio_array;		/* 就绪队列的优先级数组(kernel/sched.c) */
+struct sc_stat;			/* 系统调用统计(include/sys/scstat.h) */
+
 /* 任务(进程)数据结构，或称为进程描述符 */
 struct task_struct {
 /* these are hardcoded - don't touch */
@@ -113,6 +117,7 @@ struct task_struct {
 	long signal;					/* 信号位图 */
 	struct sigaction sigaction[32];	/* 信号执行属性结构,对应信号将要执行的操作和标志信息 */
 	long blocked;					/* 进程信号屏蔽码(对应信号位图) */ /* bitmap of masked signals */
+	unsigned long sc_start[2];		/* 系统调用开始时的时间戳，由system_call保存(kernel/scstat.c) */
 									
 /* various fields */
 /* 可变字段 */
@@ -153,6 +158,26 @@ struct task_struct {
 	unsigned int flags;					/* per process flags, defined below */
 										/* 各进程的标志 */
 	unsigned short used_math;			/* 是否使用了协处理器的标志 */
+/* run queue */
+	int task_nr;						/* 任务号，即在task[]中的下标 */
+	struct task_struct *run_next;		/* 就绪队列中的后一个任务 */
+	struct task_struct *run_prev;		/* 就绪队列中的前一个任务 */
+	struct prio_array *array;			/* 所在的优先级数组，NULL表示不在就绪队列中 */
+	int rq_prio;						/* 所在队列的序号 */
+	unsigned long sched_epoch;			/* counter最后一次重新计算时的调度周期号 */
+/* pid hash (kernel/pid.c) */
+	struct task_struct *pidhash_next, **pidhash_pprev;	/* 进程号hash队列 */
+	struct task_struct *pg_next, **pg_pprev;			/* 进程组号hash队列 */
+	struct task_struct *sess_next, **sess_pprev;		/* 会话号hash队列 */
+	struct timer_list timeout_timer;	/* 实现timeout的定时器 */
+	struct timer_list real_timer;		/* 实现alarm的定时器 */
+/* profil (kernel/profile.c) */
+	unsigned long prof_buf;				/* 采样计数缓冲区(数据段内偏移)，每个计数器16位 */
+	unsigned long prof_size;			/* 缓冲区字节数 */
+	unsigned long prof_offset;			/* 缓冲区第1个计数器对应的代码地址 */
+	unsigned long prof_scale;			/* 16.16定点比例因子，0表示不采样 */
+/* syscall accounting (kernel/scstat.c) */
+	struct sc_stat * sc_stats;			/* 本进程的系统调用统计表，第一次统计时分配 */
 /* file system info */
 	int tty;		/* -1 if no tty, so it must be signed */
 					/* 进程使用tty终端的子设备号。-1表示没有使用 */
@@ -183,6 +208,7 @@ struct task_struct {
 #define INIT_TASK \
 /* state etc */	{ 0,15,15, \
 /* signals */	0,{{},},0, \
+/* sc_start */	{0,0}, \
 /* ec,brk... */	0,0,0,0,0,0, \
 /* pid etc.. */	0,0,0,0, \
 /* suppl grps*/ {NOGROUP,}, \
@@ -194,6 +220,11 @@ struct task_struct {
 		  {0x7fffffff, 0x7fffffff}, {0x7fffffff, 0x7fffffff}}, \
 /* flags */	0, \
 /* math */	0, \
+/* run queue */	0,NULL,NULL,NULL,0,0, \
+/* pid hash */	NULL,NULL,NULL,NULL,NULL,NULL, \
+/* timers */	{NULL,NULL,0,0,NULL},{NULL,NULL,0,0,NULL}, \
+/* profil */	0,0,0,0, \
+/* sc_stats */	NULL, \
 /* fs info */	-1,0022,NULL,NULL,NULL,NULL,0, \
 /* filp */	{NULL,}, \
 	{ \
@@ -218,11 +249,43 @@ extern int jiffies_offset;					/* 用于累计需要调整的时间滴答数 */
 
 #define CURRENT_TIME (startup_time+(jiffies+jiffies_offset)/HZ)	/* 当前时间(秒数) */
 
-extern void add_timer(long jiffies, void (*fn)(void));
+/*
+ * 任务结构中的timeout是超时时刻的滴答数，0表示不计时，TIMEOUT_FOREVER表示一直等待(可以被唤醒，但
+ * 不会超时)。其他值按与jiffies的有符号差比较，jiffies回绕时也正确。
+ */
+#define TIMEOUT_FOREVER	0xffffffff
+#define timeout_expired(t) ((t) != TIMEOUT_FOREVER && (long) (jiffies - (t)) >= 0)
+
+extern void init_task_timers(struct task_struct * p);
 extern void sleep_on(struct task_struct ** p);
 extern void interruptible_sleep_on(struct task_struct ** p);
 extern void wake_up(struct task_struct ** p);
+extern void wake_up_process(struct task_struct * p);
+extern void wake_up_new_task(struct task_struct * p);
+extern void signal_wake_up(struct task_struct * p);
 extern int in_group_p(gid_t grp);
+extern int kernel_thread(void (*fn)(void));
+
+/* 进程号、进程组号和会话号的hash表(kernel/pid.c)。同一进程组或会话的任务都在同一个hash队列中 */
+#define PIDHASH_SZ		64
+#define pid_hashfn(x)	((((x) >> 6) ^ (x)) & (PIDHASH_SZ - 1))
+
+extern struct task_struct * pidhash[PIDHASH_SZ];
+extern struct task_struct * pghash[PIDHASH_SZ];
+extern struct task_struct * sesshash[PIDHASH_SZ];
+
+extern void hash_task(struct task_struct * p);
+extern void unhash_task(struct task_struct * p);
+extern void set_pgrp(struct task_struct * p, long pgrp);
+extern void set_session(struct task_struct * p, long session);
+extern struct task_struct * find_task_by_pid(long pid);
+extern int pid_in_use(long pid);
+extern int get_task_slot(void);
+extern void put_task_slot(int nr);
+extern void pid_init(void);
+
+/* 释放进程的系统调用统计表(kernel/scstat.c) */
+extern void scstat_release(struct task_struct * p);
 
 /*
  * Entry into gdt where to find first TSS. 0-nul, 1-cs, 2-ds, 3-syscall
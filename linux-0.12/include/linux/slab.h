@@ -0,0 +1,17 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+/*
+ * 内核对象缓存。每种频繁分配释放的内核对象建一个缓存，释放的对象保留在缓存的空闲链表中，下次分
+ * 配时直接取用，不再经过malloc()。对象第一次从malloc()取得时调用构造函数ctor，此后对象在缓存中
+ * 往返都不再构造，所以使用者释放对象前应把它恢复到构造后的状态。
+ */
+struct kmem_cache;
+
+extern struct kmem_cache * kmem_cache_create(const char * name, unsigned int size,
+	void (*ctor)(void *));
+extern void * kmem_cache_alloc(struct kmem_cache * cachep);
+extern void kmem_cache_free(struct kmem_cache * cachep, void * obj);
+extern void kmem_cache_info(void);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef _TIMER_H
+#define _TIMER_H
+
+/*
+ * 内核定时器。定时器结构由使用者提供(静态变量或嵌在其他结构中)，内核只把它挂到时间轮上，所以定
+ * 时器的个数没有限制。到期时在时钟中断中以data为参数调用function，此时定时器已经从时间轮上取下，
+ * function可以再次添加它。function不能睡眠。
+ */
+struct timer_list {
+	struct timer_list * next;				/* 时间轮链表中的下一项 */
+	struct timer_list ** pprev;				/* 指向前一项next字段的指针，NULL表示未添加 */
+	unsigned long expires;					/* 到期时刻(jiffies) */
+	unsigned long data;						/* 传给function的参数 */
+	void (*function)(unsigned long);		/* 到期处理函数 */
+};
+
+/* 初始化定时器，使它处于未添加状态 */
+static inline void init_timer(struct timer_list * timer)
+{
+	timer->next = NULL;
+	timer->pprev = NULL;
+}
+
+/* 定时器是否已添加且尚未到期 */
+static inline int timer_pending(struct timer_list * timer)
+{
+	return timer->pprev != NULL;
+}
+
+extern void add_timer(struct timer_list * timer);
+extern int del_timer(struct timer_list * timer);
+extern void mod_timer(struct timer_list * timer, unsigned long expires);
+
+#endif
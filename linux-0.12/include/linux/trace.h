@@ -0,0 +1,49 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+/*
+ * 内核事件跟踪(kernel/trace.c)。跟踪点把定长的二进制记录放进环形缓冲区，不做任何格式化，由
+ * 用户进程通过/dev/trace(主设备号1，次设备号6)读出，再在主机上用tools/tracedump解码。缓冲区
+ * 满了以后覆盖最早的记录，被覆盖的记录数可以从seq的间断看出来。
+ *
+ * 向/dev/trace写入一个unsigned long设置要记录的事件位图(第n位对应事件n)，开机时全部关闭。
+ */
+
+/* 事件类型，后面是各参数的含义 */
+#define TRACE_SWITCH	1		/* 任务切换：下一个任务的pid、当前任务的state */
+#define TRACE_BLK_ISSUE	2		/* 请求项入队：(请求项序号<<16)|dev、起始扇区、(cmd<<16)|扇区数 */
+#define TRACE_BLK_DONE	3		/* 请求项完成：(请求项序号<<16)|dev、uptodate */
+#define TRACE_NO_PAGE	4		/* 缺页：线性地址、出错码 */
+#define TRACE_WP_PAGE	5		/* 写保护页面：线性地址、出错码 */
+#define TRACE_SWAP_IN	6		/* 换入：交换页号、页表项地址 */
+#define TRACE_SWAP_OUT	7		/* 换出：交换页号、页表项地址、0表示没有I/O(页面在交换缓存中) */
+#define TRACE_GETBLK	8		/* 取缓冲块：dev、块号、1表示已在高速缓冲中 */
+
+#define NR_TRACE_EVENTS	9
+
+/* 跟踪记录，32字节 */
+struct trace_event {
+	unsigned long seq;			/* 记录序号，从0开始连续递增 */
+	unsigned long tsc_lo;		/* 时间戳计数器(CPU不支持rdtsc时为0) */
+	unsigned long tsc_hi;
+	unsigned long jiffies;		/* 滴答数 */
+	unsigned short type;		/* 事件类型 */
+	unsigned short pid;			/* 记录时的当前进程 */
+	unsigned long arg[3];		/* 参数 */
+};
+
+extern unsigned long trace_mask;
+extern void do_trace(int type, unsigned long a0, unsigned long a1, unsigned long a2);
+extern void trace_init(void);
+extern int trace_read(char * buf, int count);
+extern int trace_write(char * buf, int count);
+
+/* 跟踪点。事件没有打开时只有一次位测试 */
+static inline void trace(int type, unsigned long a0, unsigned long a1, unsigned long a2)
+{
+	if (trace_mask & (1 << type)) {
+		do_trace(type, a0, a1, a2);
+	}
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef _SYS_BDFLUSH_H
+#define _SYS_BDFLUSH_H
+
+/* 缓冲区回写任务的参数编号(fs/buffer.c中bdf_prm[]) */
+#define BDF_INTERVAL	0		/* 回写任务的唤醒间隔(滴答数) */
+#define BDF_AGE			1		/* 脏块写盘前最多保留的时间(滴答数) */
+#define BDF_NFRACT		2		/* 脏块超过缓冲块总数的这一百分比时强制回写 */
+#define BDF_NDIRTY		3		/* 每一批最多写盘的块数 */
+#define BDF_NR_PARAM	4
+
+#define BDF_MAX_BATCH	64		/* BDF_NDIRTY的上限 */
+
+/* bdflush()的功能号：立即回写一遍已超时的脏块，读取或设置第i个参数 */
+#define BDF_FLUSH		1
+#define BDF_GET(i)		(2 + ((i) << 1))
+#define BDF_SET(i)		(3 + ((i) << 1))
+
+extern int bdflush(int func, long data);
+
+#endif
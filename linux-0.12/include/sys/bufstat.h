@@ -0,0 +1,23 @@
+#ifndef _SYS_BUFSTAT_H
+#define _SYS_BUFSTAT_H
+
+/* hash表链长分布的统计项数。链长不小于BS_NR_CHAIN-1的表项都计入最后一项 */
+#define BS_NR_CHAIN	16
+
+/* 高速缓冲区统计信息(fs/buffer.c中sys_bufstat()) */
+struct bufstat {
+	long bs_nr_buffers;				/* 缓冲块总数 */
+	long bs_nr_hash;				/* hash表项数(2的幂) */
+	long bs_nr_clean;				/* 干净链表上的缓冲块数 */
+	long bs_nr_locked;				/* 上锁链表上的缓冲块数 */
+	long bs_nr_dirty;				/* 脏链表上的缓冲块数 */
+	unsigned long bs_lookups;		/* hash表查找次数 */
+	unsigned long bs_probes;		/* 查找时遍历的链表项总数 */
+	unsigned long bs_hits;			/* 查找命中次数 */
+	long bs_max_chain;				/* 最长链长(不超过BS_NR_CHAIN-1) */
+	long bs_chain[BS_NR_CHAIN];		/* 链长为i的hash表项数 */
+};
+
+extern int bufstat(struct bufstat * buf);
+
+#endif
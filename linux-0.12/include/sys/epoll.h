@@ -0,0 +1,31 @@
+#ifndef _SYS_EPOLL_H
+#define _SYS_EPOLL_H
+
+/* 事件位。EPOLLERR和EPOLLHUP总是被报告，不必在events中指定 */
+#define EPOLLIN			0x001		/* 可读 */
+#define EPOLLOUT		0x004		/* 可写 */
+#define EPOLLERR		0x008		/* 出错 */
+#define EPOLLHUP		0x010		/* 对端已关闭(管道没有了读者或写者) */
+#define EPOLLET			(1 << 31)	/* 边沿触发：就绪后只报告一次，直到再次被唤醒 */
+
+/* epoll_ctl()的操作 */
+#define EPOLL_CTL_ADD	1
+#define EPOLL_CTL_DEL	2
+#define EPOLL_CTL_MOD	3
+
+#define EP_MAX_EVENTS	64			/* epoll_wait()一次最多返回的事件数 */
+
+struct epoll_event {
+	unsigned long events;
+	unsigned long data;				/* 用户数据，原样返回 */
+};
+
+/*
+ * 与select()相同，epoll_ctl()和epoll_wait()的参数超过3个，系统调用只传递指向第1个参数的指针，
+ * 内核从用户栈上依次取出各参数。epoll_wait()的timeout以毫秒为单位，-1表示一直等待。
+ */
+extern int epoll_create(int size);
+extern int epoll_ctl(int epfd, int op, int fd, struct epoll_event * event);
+extern int epoll_wait(int epfd, struct epoll_event * events, int maxevents, int timeout);
+
+#endif
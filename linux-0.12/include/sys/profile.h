@@ -0,0 +1,37 @@
+#ifndef _SYS_PROFILE_H
+#define _SYS_PROFILE_H
+
+/*
+ * profil()：每个时钟滴答检查一次当前进程的用户态eip，把((eip - offset) * scale) >> 16所指的
+ * 16位计数器加1(按字节下标，低位清零)。scale为0x10000时每2个字节代码对应一个计数器，0x8000时
+ * 每4个字节一个，依次类推。scale为0或1时停止采样。execve()以后采样也会停止，fork()出的子进程
+ * 继承父进程的设置。buf必须2字节对齐。
+ */
+extern int profil(unsigned short * buf, unsigned long bufsiz, unsigned long offset,
+	unsigned long scale);
+
+/*
+ * kprof()的命令。只有超级用户可以使用。KPROF_START的arg是每个计数器覆盖的字节数的对数(2-12)，
+ * 计数器数组最多128KB，粒度太小、放不下时返回-EINVAL。
+ */
+#define KPROF_START		1		/* 开始对内核代码采样，计数器清零 */
+#define KPROF_STOP		2		/* 停止采样，保留已有的计数 */
+#define KPROF_READ		3		/* 读出kprof_header及其后的计数器数组，arg为buf的字节数 */
+#define KPROF_FREE		4		/* 停止采样并释放计数器数组 */
+
+#define KPROF_MAGIC		0x4b50524f
+
+/*
+ * KPROF_READ读出的数据格式。计数器i对应内核代码地址[i << shift, (i + 1) << shift)，最后一个计
+ * 数器还包含了所有超出内核代码段(etext)的采样。用主机上的tools/kprof对照System.map可以按函数汇总。
+ */
+struct kprof_header {
+	unsigned long magic;			/* KPROF_MAGIC */
+	unsigned long shift;			/* 计数器粒度 */
+	unsigned long nr_bins;			/* 计数器个数 */
+	unsigned long samples;			/* 内核态采样总数 */
+};
+
+extern int kprof(int cmd, char * buf, int arg);
+
+#endif
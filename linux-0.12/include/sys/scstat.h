@@ -0,0 +1,28 @@
+#ifndef _SYS_SCSTAT_H
+#define _SYS_SCSTAT_H
+
+/*
+ * 按系统调用号统计的调用次数、出错次数和耗时。耗时是system_call在调用C处理函数前后读到的时间
+ * 戳之差(时钟周期数)，包括调用中睡眠的时间。统计打开以后每个进程第一次完成系统调用时分配自己的
+ * 统计表，全系统的统计表是所有进程之和。没有返回的调用(exit)不计入。
+ */
+#define NR_SCSTAT		128			/* 统计表的项数，调用号不小于它的系统调用不统计 */
+
+struct sc_stat {
+	unsigned long count;			/* 调用次数 */
+	unsigned long errors;			/* 返回负值(出错)的次数 */
+	unsigned long cycles_lo;		/* 总耗时(64位时钟周期数) */
+	unsigned long cycles_hi;
+	unsigned long max;				/* 单次最大耗时，超过32位时记为0xffffffff */
+};
+
+/* scstat()的命令。除SCSTAT_READ外只有超级用户可以使用 */
+#define SCSTAT_ON		1			/* 开始统计，CPU没有时间戳计数器时返回-EINVAL */
+#define SCSTAT_OFF		2			/* 停止统计，保留已有的数据 */
+#define SCSTAT_RESET	3			/* 全系统和各进程的统计清零 */
+#define SCSTAT_READ		4			/* 把pid进程(pid为0时是全系统)的统计表读到buf，buf要能放下NR_SCSTAT项 */
+
+/* 返回值：SCSTAT_READ返回读出的项数(进程还没有统计表时为0)，其他命令返回0 */
+extern int scstat(int cmd, int pid, struct sc_stat * buf);
+
+#endif
@@ -167,6 +167,13 @@
 #define __NR_lstat			84
 #define __NR_readlink		85
 #define __NR_uselib			86
+#define __NR_bufstat		87
+#define __NR_bdflush		88
+#define __NR_epoll_create	89
+#define __NR_epoll_ctl		90
+#define __NR_epoll_wait		91
+#define __NR_kprof			92
+#define __NR_scstat			93
 
 /**** 以下定义系统调用嵌入式汇编宏函数 ****/
 // Tip: 在宏定义中，若在两个标记之间有两个连续的井号'##'，则表示在宏替换时会把这两个标记符号连
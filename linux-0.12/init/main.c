@@ -80,6 +80,7 @@ extern void chr_dev_init(void);					/* 字符设备初始化chr_drv/tty_io.c */
 extern void hd_init(void);						/* 硬盘初始化blk_drv/hd.c */
 extern void floppy_init(void);					/* 软驱初始化blk_drv/floppy.c */
 extern void mem_init(long start, long end);		/* 内存管理初始化mm/memory.c */
+extern void trace_init(void);					/* 事件跟踪缓冲区初始化kernel/trace.c */
 extern long rd_init(long mem_start, int length);/* 虚拟盘初始化blk_drv/ramdisk.c */
 extern long kernel_mktime(struct tm * tm);		/* 计算系统开机启动时间(秒) */
 
@@ -222,13 +223,17 @@ int main(void)		/* This really is void, no error here. */
 
 /* 以下是内核进行所有方面的初始化工作 */
 	mem_init(main_memory_start, memory_end);/* 主内存区初始化 */
+	trace_init();							/* 事件跟踪缓冲区初始化 */
 	trap_init();							/* 陷阱门初始化 */
 	blk_dev_init();							/* 块设备初始化 */
 	chr_dev_init();							/* 字符设备初始化 */
 	tty_init();								/* tty初始化 */
 	time_init();							/* 设置开机启动时间 */
 	sched_init();							/* 调度程序初始化 */
+	inode_init(buffer_memory_end);			/* 内存i节点表初始化 */
 	buffer_init(buffer_memory_end);			/* 缓冲管理初始化 */
+	pipe_init();							/* 管道缓冲区结构缓存初始化 */
+	ep_init();								/* epoll项缓存初始化 */
 	hd_init();								/* 硬盘初始化 */
 	floppy_init();							/* 软驱初始化 */
 
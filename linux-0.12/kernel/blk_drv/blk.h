@@ -1,6 +1,8 @@
 #ifndef _BLK_H
 #define _BLK_H
 
+#include <linux/trace.h>	/* 事件跟踪头文件 */
+
 #define NR_BLK_DEV	7		/* 块设备类型数量 */
 /*
  * NR_REQUEST is the number of entries in the request-queue.
@@ -39,12 +41,21 @@ struct request {
 	int errors;								/* 操作时产生的错误次数 */
 	unsigned long sector;					/* 起始扇区。（1块=2扇区） */
 	unsigned long nr_sectors;				/* 读/写扇区数 */
+	unsigned long current_nr_sectors;		/* 当前缓冲块(bh)中剩余的扇区数 */
 	char * buffer;							/* 数据缓冲区 */
 	struct task_struct * waiting;			/* 任务等待请求完成操作的地方（队列） */
 	struct buffer_head * bh;				/* 缓冲区头指针（include/linux/fs.h） */
+	struct buffer_head * bhtail;			/* 缓冲块链表的最后一块，用于向后合并 */
+	unsigned long deadline;					/* 最迟应开始处理的时间(滴答)，用于deadline调度 */
 	struct request * next;					/* 指向下一请求项 */
 };
 
+/*
+ * 相邻的读/写请求可以合并成一个请求项：bh指向按扇区顺序经b_reqnext链接起来的缓冲块链表，
+ * sector、nr_sectors描述整个请求，而buffer和current_nr_sectors只对应链表中的第一块。
+ * end_request()每次结束一个缓冲块，只有最后一块结束时才释放请求项。
+ */
+
 /*
  * This is used in the elevator algorithm: Note that
  * reads always go before writes. This is natural: reads
@@ -61,12 +72,31 @@ struct request {
 ((s1)->dev < (s2)->dev || ((s1)->dev == (s2)->dev && \
 (s1)->sector < (s2)->sector))))
 
+struct blk_dev_struct;
+
+/*
+ * I/O调度策略操作表(blk_drv/elevator.c)。add_request把新请求项插入到设备队列中当前请求项之后；
+ * next_request在请求项done处理完后返回下一个要处理的请求项，可以调整队列中其余请求项的顺序。
+ * 两者都在关中断时被调用。
+ */
+struct elevator_ops {
+	char * name;
+	void (*add_request)(struct blk_dev_struct * dev, struct request * req);
+	struct request * (*next_request)(struct request * done);
+};
+
 /* 块设备处理结构 */
 struct blk_dev_struct {
 	void (*request_fn)(void);			/* 请求处理函数指针 */
 	struct request * current_request;	/* 当前处理的请求结构 */
+	unsigned long max_sectors;			/* 一个请求项最多可合并到的扇区数，0表示不合并 */
+	struct elevator_ops * elevator;		/* I/O调度策略 */
 };
 
+/* 调度策略表，以ELV_*为索引 */
+extern struct elevator_ops elevator_table[NR_ELEVATOR];
+extern void elevator_add_request(struct blk_dev_struct * dev, struct request * req);
+
 /* 块设备表（数组）。每种块设备占用一项，共7项。表索引值即是主设备号 */
 extern struct blk_dev_struct blk_dev[NR_BLK_DEV];
 /* 	请求项数组，共32项 */
@@ -164,20 +194,38 @@ static void unlock_buffer(struct buffer_head * bh)
  */
 static void end_request(int uptodate)
 {
-	DEVICE_OFF(CURRENT->dev);				/* 关闭设备 */
-	if (CURRENT->bh) {						/* CURRENT为当前请求结构项指针 */
-		CURRENT->bh->b_uptodate = uptodate;	/* 置更新标志 */
-		unlock_buffer(CURRENT->bh);			/* 解锁缓冲区 */
-	}
+	struct buffer_head * bh;
+
 	if (!uptodate) {						/* 若更新标志为0则显示出错信息 */
 		printk(DEVICE_NAME " I/O error\n\r");
-		printk("dev %04x, block %d\n\r",CURRENT->dev,
-			CURRENT->bh->b_blocknr);
+		if (CURRENT->bh)
+			printk("dev %04x, block %d\n\r",CURRENT->dev,
+				CURRENT->bh->b_blocknr);
+	}
+	if ((bh = CURRENT->bh)) {				/* CURRENT为当前请求结构项指针 */
+		CURRENT->bh = bh->b_reqnext;		/* 从请求项中取下第一个缓冲块 */
+		bh->b_reqnext = NULL;
+		bh->b_uptodate = uptodate;			/* 置更新标志 */
+		unlock_buffer(bh);					/* 解锁缓冲区 */
+		/*
+		 * 合并过的请求项中还有后续缓冲块：丢弃本块剩余的扇区(出错时)，让请求项从下一块的起始扇区
+		 * 继续，请求项本身并不释放
+		 */
+		if ((bh = CURRENT->bh)) {
+			CURRENT->nr_sectors -= CURRENT->current_nr_sectors;
+			CURRENT->current_nr_sectors = 2;
+			CURRENT->sector = bh->b_blocknr << 1;
+			CURRENT->buffer = bh->b_data;
+			CURRENT->errors = 0;
+			return;
+		}
 	}
+	DEVICE_OFF(CURRENT->dev);				/* 关闭设备 */
+	trace(TRACE_BLK_DONE, ((CURRENT - request) << 16) | CURRENT->dev, uptodate, 0);
 	wake_up(&CURRENT->waiting);				/* 唤醒等待该请求项的进程 */
 	wake_up(&wait_for_request);				/* 唤醒等待空闲请求项的进程 */
 	CURRENT->dev = -1;						/* 释放该请求项 */
-	CURRENT = CURRENT->next;				/* 指向下一请求项 */
+	CURRENT = blk_dev[MAJOR_NR].elevator->next_request(CURRENT);	/* 由调度策略选出下一请求项 */
 }
 
 /* 如果定义了设备超时符号常量DEVICE_TIMEOUT，则定义CLEAR_DEVICE_TIMEOUT符号常量为”DEVICE_TIMEOUT = 0“。否则定义CLEAR_DEVICE_TIMEOUT为空 */
@@ -0,0 +1,172 @@
+/*
+ *  linux/kernel/blk_drv/elevator.c
+ */
+
+/*
+ * I/O调度策略。每个块设备(blk_dev_struct)都带有一个调度策略操作表elevator，add_request()用它
+ * 决定新请求项在队列中的插入位置，end_request()用它挑选下一个要处理的请求项。
+ *
+ * 调用这些函数时中断都是关闭的，而且队列头(current_request)是设备正在处理的请求项，不能移动。
+ */
+#include <errno.h>			/* 错误号头文件。包含系统中各种错误号 */
+#include <linux/sched.h>	/* 调度程序头文件。定义了任务结构task_struct、jiffies等 */
+#include <linux/kernel.h>	/* 内核头文件。含有一些内核常用函数的原型定义 */
+
+#include "blk.h"			/* 块设备头文件。定义请求数据结构、块设备数据结构和宏等信息 */
+
+/*
+ * deadline策略中请求项的最长等待时间(滴答数)。读请求通常有进程在同步等待，所以期限短得多。
+ */
+#define READ_EXPIRE		(HZ / 2)
+#define WRITE_EXPIRE	(5 * HZ)
+
+/* 只按设备号和扇区号排序，不区分读写，用于C-LOOK */
+#define SECTOR_ORDER(s1,s2) \
+((s1)->dev < (s2)->dev || ((s1)->dev == (s2)->dev && \
+(s1)->sector < (s2)->sector))
+
+// 把req插入到队列中tmp之后.
+static inline void insert_after(struct request * tmp, struct request * req)
+{
+	req->next = tmp->next;
+	tmp->next = req;
+}
+
+// 经典的电梯算法:按IN_ORDER()排序,读请求总排在写请求之前.
+// 交换(分页)请求(bh为NULL)排在所有带缓冲块的请求之前,并按出现的顺序处理.
+static void elevator_add(struct blk_dev_struct * dev, struct request * req)
+{
+	struct request * tmp = dev->current_request;
+
+	for ( ; tmp->next ; tmp = tmp->next) {
+		if (!req->bh) {
+			if (tmp->next->bh)
+				break;
+			else
+				continue;
+		}
+		if ((IN_ORDER(tmp, req)||!IN_ORDER(tmp, tmp->next)) && IN_ORDER(req, tmp->next))
+			break;
+	}
+	insert_after(tmp, req);
+}
+
+// C-LOOK:磁头只沿扇区号增大的方向扫描,到达最大扇区号后直接跳回最小的扇区号重新开始.
+// 队列从当前请求项开始由一段或两段递增序列组成,新请求项插入到它所在的递增段中.
+// 交换请求的处理与elevator_add()相同.
+static void clook_add(struct blk_dev_struct * dev, struct request * req)
+{
+	struct request * tmp = dev->current_request;
+
+	for ( ; tmp->next ; tmp = tmp->next) {
+		if (!req->bh) {
+			if (tmp->next->bh)
+				break;
+			else
+				continue;
+		}
+		if (!tmp->next->bh)
+			continue;
+		if ((SECTOR_ORDER(tmp, req)||!SECTOR_ORDER(tmp, tmp->next)) && SECTOR_ORDER(req, tmp->next))
+			break;
+	}
+	insert_after(tmp, req);
+}
+
+// noop:先来先服务,直接放在队列末尾.用于没有寻道开销的内存虚拟盘.
+static void noop_add(struct blk_dev_struct * dev, struct request * req)
+{
+	struct request * tmp = dev->current_request;
+
+	while (tmp->next)
+		tmp = tmp->next;
+	insert_after(tmp, req);
+}
+
+// 除deadline以外的策略都按队列顺序处理.
+static struct request * fifo_next(struct request * done)
+{
+	return done->next;
+}
+
+// deadline:平时按C-LOOK顺序处理,但若队列中有请求项已超过期限,则优先处理其中期限最早的读请求,
+// 没有超期的读请求时再处理期限最早的写请求.被选中的请求项移到队列头部,其余请求项顺序不变.
+static struct request * deadline_next(struct request * done)
+{
+	struct request * req, * prev, * pick = NULL, * pick_prev = NULL;
+	struct request * first = done->next;
+
+	for (prev = NULL, req = first ; req ; prev = req, req = req->next) {
+		if ((long) (jiffies - req->deadline) < 0)
+			continue;
+		if (!pick || (req->cmd == READ && pick->cmd != READ) ||
+		    (req->cmd == pick->cmd && (long) (req->deadline - pick->deadline) < 0)) {
+			pick = req;
+			pick_prev = prev;
+		}
+	}
+	if (!pick || pick == first)
+		return first;
+	pick_prev->next = pick->next;
+	pick->next = first;
+	return pick;
+}
+
+// 请求项进入队列时设置其期限.对所有策略都设置,这样在运行时切换到deadline也能立即生效.
+static inline void set_deadline(struct request * req)
+{
+	req->deadline = jiffies + (req->cmd == READ ? READ_EXPIRE : WRITE_EXPIRE);
+}
+
+// 调度策略表,以策略编号(ELV_*,见include/linux/fs.h)为索引.
+struct elevator_ops elevator_table[NR_ELEVATOR] = {
+	{ "noop", noop_add, fifo_next },			/* ELV_NOOP */
+	{ "elevator", elevator_add, fifo_next },	/* ELV_ELEVATOR */
+	{ "c-look", clook_add, fifo_next },			/* ELV_CLOOK */
+	{ "deadline", clook_add, deadline_next }	/* ELV_DEADLINE */
+};
+
+// 把请求项加入设备队列(由add_request()在关中断时调用,此时设备一定有当前请求项).
+void elevator_add_request(struct blk_dev_struct * dev, struct request * req)
+{
+	set_deadline(req);
+	(dev->elevator->add_request)(dev, req);
+}
+
+// 块设备I/O控制.用于查询和切换设备的调度策略,以及查询和设置预读块数:
+// BLKGETSCHED返回当前策略编号;BLKSETSCHED把策略切换为arg,只有超级用户可以执行.
+// 已在队列中的请求项保持原有顺序,新的请求项按新策略插入.
+// BLKRAGET返回设备的最大预读块数;BLKRASET把它设置为arg,同样只有超级用户可以执行.
+// 参数不合法返回-EINVAL,不认识的命令与其他设备的ioctl一样返回-ENOTTY.
+int blk_ioctl(int dev, int cmd, int arg)
+{
+	struct blk_dev_struct * bdev;
+
+	if (MAJOR(dev) >= NR_BLK_DEV)
+		return -ENODEV;
+	bdev = blk_dev + MAJOR(dev);
+	if (!bdev->request_fn)
+		return -ENODEV;
+	switch (cmd) {
+		case BLKGETSCHED:
+			return bdev->elevator - elevator_table;
+		case BLKSETSCHED:
+			if (!suser())
+				return -EPERM;
+			if (arg < 0 || arg >= NR_ELEVATOR)
+				return -EINVAL;
+			bdev->elevator = elevator_table + arg;
+			return 0;
+		case BLKRAGET:
+			return read_ahead[MAJOR(dev)];
+		case BLKRASET:
+			if (!suser())
+				return -EPERM;
+			if (arg < 0 || arg > MAX_READAHEAD)
+				return -EINVAL;
+			read_ahead[MAJOR(dev)] = arg;
+			return 0;
+		default:
+			return -ENOTTY;
+	}
+}
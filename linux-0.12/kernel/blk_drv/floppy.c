@@ -179,6 +179,24 @@ static unsigned char current_track = 255;			/* 当前磁头所在磁道号 */
 static unsigned char command = 0;					/* 读/写命令 */
 unsigned char selected = 0;							/* 软驱已选定标志。在处理请求项之前要首先选定软驱 */
 struct task_struct * wait_on_floppy_select = NULL;	/* 等待选定软驱的任务队列 */
+static struct timer_list floppy_timer;				/* 马达启动和选择驱动器的延时定时器 */
+
+static void floppy_timer_fn(unsigned long data)
+{
+	((void (*)(void)) data)();
+}
+
+/* 延时ticks个滴答后调用fn。ticks不大于0时立刻调用 */
+static void floppy_delay(long ticks, void (*fn)(void))
+{
+	if (ticks <= 0) {
+		fn();
+		return;
+	}
+	floppy_timer.data = (unsigned long) fn;
+	floppy_timer.function = floppy_timer_fn;
+	mod_timer(&floppy_timer, jiffies + ticks);
+}
 
 /*
  * 取消选定软驱
@@ -634,7 +652,7 @@ static void floppy_on_interrupt(void)			/* floppy_no() interrupt */
 		current_DOR &= 0xFC;			/* 清除原驱动器选择 */
 		current_DOR |= current_drive;	/* 设置当前选择的驱动器号 */
 		outb(current_DOR,FD_DOR);		/* 向数字输出寄存器输出当前DOR */
-		add_timer(2,&transfer);			/* 添加定时器及其相关执行函数 */
+		floppy_delay(2,&transfer);		/* 添加定时器及其相关执行函数 */
 	} else
 		transfer();						/* 执行软盘读写传输函数 */
 }
@@ -703,7 +721,7 @@ void do_fd_request(void)
 	 * 在设置好所有全局变量值之后，我们可以开始执行请求项操作了。这里，该操作利用定时器来启动。因为需要首先启动驱动器马达并达到正常运转速度，才能对软驱进行读写操作，
 	 * 而这需要一定的时间。因此这里利用ticks_to_floppy_on()来计算启动延时时间，然后使用该延时设定一个定时器。当时间到期时就会调用函数floppy_on_interrupt()
 	 */
-	add_timer(ticks_to_floppy_on(current_drive),&floppy_on_interrupt);
+	floppy_delay(ticks_to_floppy_on(current_drive),&floppy_on_interrupt);
 }
 
 /* 各种类型软驱磁盘含有的数据块总数 */
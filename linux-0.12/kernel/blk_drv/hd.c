@@ -46,6 +46,7 @@ inb_p(0x71); \
 /* 每扇区读/写操作允许的最多出错次数 */
 #define MAX_ERRORS	7		/* 读/写一个扇区时允许的最多出错次数 */
 #define MAX_HD		2		/* 系统支持的最多硬盘数 */
+#define HD_MAX_SECTORS	128	/* 一个请求项(一条读写命令)最多传送的扇区数，不能超过256 */
 
 /* 重新矫正处理函数。复位操作时在硬盘中断处理程序中调用的重新校验函数 */
 static void recal_intr(void);
@@ -232,6 +233,9 @@ int sys_setup(void * BIOS)
 	rd_load();			/* blk_drv/ramdisk.c */
 	init_swapping();	/* mm/swap.c */
 	mount_root();		/* fs/super.c */
+	/* 根文件系统就绪后启动缓冲区回写任务。放在这里而不是main()中，是为了让init仍是任务1 */
+	if (kernel_thread(bdflush_thread) < 0)
+		printk("Unable to start bdflush\n\r");
 	return (0);
 }
 
@@ -433,7 +437,14 @@ static void read_intr(void)
 	CURRENT->errors = 0;					/* 清出错误次数 */
 	CURRENT->buffer += 512;					/* 调整缓冲区指针，指向新的空区 */
 	CURRENT->sector++;						/* 起始扇区号加1 */
+	/*
+	 * 合并过的请求项由多个缓冲块组成，控制器一次命令连续传送所有扇区。当前缓冲块的扇区读完后，由end_request()
+	 * 结束该缓冲块并把buffer指向下一缓冲块
+	 */
+	--CURRENT->current_nr_sectors;
 	if (--CURRENT->nr_sectors) {			/* 如果所需读出的扇区数还没读完，则再置硬盘调用C函数指针为read_intr */
+		if (!CURRENT->current_nr_sectors)
+			end_request(1);
 		SET_INTR(&read_intr);
 		return;
 	}
@@ -463,9 +474,12 @@ static void write_intr(void)
 	 * 的数据。然后再重置硬盘中断处理程序中调用的C函数指针do_hd（指向本函数）。接着向控制器数据端口写入512字节数据，然后函数返回去等待控制器把这些数据写入硬盘后
 	 * 产生中断。
 	 */
+	--CURRENT->current_nr_sectors;
 	if (--CURRENT->nr_sectors) {				/* 若还有扇区要写，*/
 		CURRENT->sector++;						/* 则当前请求起始扇区号+1， */
 		CURRENT->buffer += 512;					/* 调整请求缓冲区指针， */
+		if (!CURRENT->current_nr_sectors)		/* 当前缓冲块已写完，转到下一缓冲块 */
+			end_request(1);
 		SET_INTR(&write_intr);					/* do_hd置函数指针为write_intr() */
 		port_write(HD_DATA,CURRENT->buffer,256);/* 向数据端口写256字 */
 		return;
@@ -532,7 +546,7 @@ void do_hd_request(void)
 	INIT_REQUEST;
 	dev = MINOR(CURRENT->dev);
 	block = CURRENT->sector;		/* 请求的起始扇区 */
-	if (dev >= 5*NR_HD || block+2 > hd[dev].nr_sects) {
+	if (dev >= 5*NR_HD || block+CURRENT->nr_sectors > hd[dev].nr_sects) {
 		end_request(0);
 		goto repeat;				/* 该标号在blk.h最后面 */
 	}
@@ -604,6 +618,7 @@ void do_hd_request(void)
 void hd_init(void)
 {
 	blk_dev[MAJOR_NR].request_fn = DEVICE_REQUEST;	/* do_hd_request() */
+	blk_dev[MAJOR_NR].max_sectors = HD_MAX_SECTORS;	/* 允许合并请求项，一次命令传送多个扇区 */
 	set_intr_gate(0x2E,&hd_interrupt);				/* 设置中断门中处理函数指针 */
 	outb_p(inb_p(0x21)&0xfb,0x21);					/* 复位主片上接联引脚屏蔽位（位2） */
 	outb(inb_p(0xA1)&0xbf,0xA1);					/* 复位从片上硬盘中断请求屏蔽位（位6） */
@@ -40,17 +40,19 @@ struct task_struct * wait_for_request = NULL;
  * blk_dev_struct块设备结构是:(参见文件kernel/blk_drv/blk.h)
  * do_request-address	// 对应主设备号的请求处理程序指针
  * current-request		// 该设备的下一个请求
+ * max_sectors			// 请求项合并后的最大扇区数,由驱动程序初始化时设置
+ * elevator				// I/O调度策略,可用ioctl(BLKSETSCHED)在运行时切换
  */
 // 块设备数组。该数组使用主设备号作为索引。实际内容将在各块设备驱动程序初始化时填入。
 // 例如，硬盘驱动程序初始化时(hd.c)，第一条语句即用于设备blk_dev[3]的内容。
 struct blk_dev_struct blk_dev[NR_BLK_DEV] = {
-	{ NULL, NULL },		/* no_dev */		/* 0 - 无设备 */
-	{ NULL, NULL },		/* dev mem */		/* 1 - 内存 */
-	{ NULL, NULL },		/* dev fd */		/* 2 - 软驱设备 */
-	{ NULL, NULL },		/* dev hd */		/* 3 - 硬盘设备 */
-	{ NULL, NULL },		/* dev ttyx */		/* 4 - ttyx设备 */
-	{ NULL, NULL },		/* dev tty */		/* 5 - tty设备 */
-	{ NULL, NULL }		/* dev lp */		/* 6 - lp打印机设备 */
+	{ NULL, NULL, 0, elevator_table + ELV_ELEVATOR },	/* no_dev */	/* 0 - 无设备 */
+	{ NULL, NULL, 0, elevator_table + ELV_NOOP },		/* dev mem */	/* 1 - 内存 */
+	{ NULL, NULL, 0, elevator_table + ELV_ELEVATOR },	/* dev fd */	/* 2 - 软驱设备 */
+	{ NULL, NULL, 0, elevator_table + ELV_ELEVATOR },	/* dev hd */	/* 3 - 硬盘设备 */
+	{ NULL, NULL, 0, elevator_table + ELV_ELEVATOR },	/* dev ttyx */	/* 4 - ttyx设备 */
+	{ NULL, NULL, 0, elevator_table + ELV_ELEVATOR },	/* dev tty */	/* 5 - tty设备 */
+	{ NULL, NULL, 0, elevator_table + ELV_ELEVATOR }	/* dev lp */	/* 6 - lp打印机设备 */
 };
 
 /*
@@ -69,6 +71,12 @@ struct blk_dev_struct blk_dev[NR_BLK_DEV] = {
 // 设备号确定的一个子设备上所拥有的数据总数(1块大小 = 1KB).
 int * blk_size[NR_BLK_DEV] = { NULL, NULL, };
 
+/*
+ * read_ahead[MAJOR]是普通文件顺序读时最多预读的块数(fs/file_dev.c),可用ioctl(BLKRASET)修改.
+ * 内存虚拟盘没有寻道开销,不需要预读.
+ */
+int read_ahead[NR_BLK_DEV] = { 0, 0, 8, 32, 0, 0, 0 };
+
 // 锁定指定缓冲块
 //
 // 如果指定的缓冲块已经被其他任务锁定,则使自己睡眠(不可中断的等待),直到被执行解锁
@@ -119,6 +127,8 @@ static void add_request(struct blk_dev_struct * dev, struct request * req)
 	struct request * tmp;
 
 	req->next = NULL;
+	trace(TRACE_BLK_ISSUE, ((req - request) << 16) | req->dev, req->sector,
+		(req->cmd << 16) | req->nr_sectors);
 	cli();								// 关中断
 	if (req->bh)
 		req->bh->b_dirt = 0;			// 清缓冲区"脏"标志.
@@ -130,24 +140,54 @@ static void add_request(struct blk_dev_struct * dev, struct request * req)
 		(dev->request_fn)();			// 执行请求函数,对于硬盘是do_hd_request().
 		return;
 	}
-	// 如果目前该设备已经有当前请求项在处理,则首先利用电梯算法搜索最佳插入位置,然后将当前请求项插入到请求链表中.在搜索过程中,如果判断出欲插入
-	// 请求项的缓冲块头指针空,即没有缓冲块,那么就需要找一个项,其已经有可用的缓冲块.因此若当前插入位置(tmp之后)处的空闲项缓冲块头指针不空,就选择这个位置
-	// 于是退出循环并把请求项插入此处.最后开中断并退出函数.电梯算法的作用是让磁盘磁头的移动距离最小,从而改善(减少)硬盘访问时间.
-	// 下面for循环中if语句用于把req所指请求项与请求队列(链表)中已有的请求项作比较,找出req插入该队列的正确位置顺序.然后中断循环,并把req插入到该队列正确位置处.
-	for ( ; tmp->next ; tmp = tmp->next) {
-		if (!req->bh) {
-			if (tmp->next->bh) {
-				break;
-			} else {
-				continue;
-			}
-		}
-		if ((IN_ORDER(tmp, req)||!IN_ORDER(tmp, tmp->next)) && IN_ORDER(req, tmp->next))
-			break;
+	// 如果目前该设备已经有当前请求项在处理,则由设备的I/O调度策略(elevator.c)决定请求项在队列中的插入位置.
+	// 默认的电梯算法让磁盘磁头的移动距离最小,从而改善(减少)硬盘访问时间.最后开中断并退出函数.
+	elevator_add_request(dev, req);
+	sti();
+}
+
+// 尝试把缓冲块合并到已在队列中的请求项里.
+// 只有设备允许合并(max_sectors不为0)时才会合并.设备当前正在处理的请求项(队列头)已经发给了
+// 控制器,不能再修改,因此从它的下一项开始查找.若某个同设备同命令的请求项恰好结束于bh所在扇区
+// 之前(向后合并)或开始于bh之后(向前合并),并且合并后扇区数不超过max_sectors,就把bh链入该请求
+// 项的缓冲块链表.整个查找和修改过程都在关中断下进行,以免与中断处理程序中的end_request()冲突.
+// 返回1表示已合并,0表示需要新建请求项.
+static int merge_request(struct blk_dev_struct * dev, int rw, struct buffer_head * bh)
+{
+	struct request * req;
+	unsigned long sector = bh->b_blocknr << 1;
+
+	if (!dev->max_sectors)
+		return 0;
+	cli();
+	if (!(req = dev->current_request)) {
+		sti();
+		return 0;
+	}
+	for (req = req->next ; req ; req = req->next) {
+		if (req->dev != bh->b_dev || req->cmd != rw || !req->bh)
+			continue;
+		if (req->nr_sectors + 2 > dev->max_sectors)
+			continue;
+		if (req->sector + req->nr_sectors == sector) {		// 向后合并
+			bh->b_reqnext = NULL;
+			req->bhtail->b_reqnext = bh;
+			req->bhtail = bh;
+		} else if (sector + 2 == req->sector) {				// 向前合并
+			bh->b_reqnext = req->bh;
+			req->bh = bh;
+			req->buffer = bh->b_data;
+			req->current_nr_sectors = 2;
+			req->sector = sector;
+		} else
+			continue;
+		req->nr_sectors += 2;
+		bh->b_dirt = 0;										// 与add_request()一样清除脏标志.
+		sti();
+		return 1;
 	}
-	req->next = tmp->next;
-	tmp->next = req;
 	sti();
+	return 0;
 }
 
 // 创建请求项并插入请求队列中.
@@ -180,6 +220,9 @@ static void make_request(int major, int rw, struct buffer_head * bh)
 		unlock_buffer(bh);
 		return;
 	}
+	// 能与队列中相邻的请求项合并,就不必再占用新的请求项.
+	if (merge_request(major + blk_dev, rw, bh))
+		return;
 repeat:
 	/* we don't allow the write-requests to fill up the queue completely:
 	 * we want some room for reads: they take precedence. The last third
@@ -220,33 +263,29 @@ repeat:
 	req->errors = 0;									// 操作时产生的错误次数.
 	req->sector = bh->b_blocknr << 1;					// 起始扇区.块号转换成扇区号(1块=2扇区).
 	req->nr_sectors = 2;								// 本请求项需要读写的扇区数.
+	req->current_nr_sectors = 2;						// 当前缓冲块的扇区数.
 	req->buffer = bh->b_data;							// 请求项缓冲区指针指向需读写的数据缓冲区.
 	req->waiting = NULL;								// 任务等待操作执行完成的地方.
 	req->bh = bh;										// 缓冲块头指针.
+	req->bhtail = bh;									// 缓冲块链表尾.
+	bh->b_reqnext = NULL;
 	req->next = NULL;									// 指向下一请求项.
 	add_request(major + blk_dev, req);					// 将请求项加入队列中(blk_dev[major],reg).
 }
 
-// 低级页面读写函数(Low Level Read Write Pagk).
-// 以页面(4K)为单位访问设备数据,即每次读/写8个扇区.参见下面ll_rw_blk()函数.
-void ll_rw_page(int rw, int dev, int page, char * buffer)
+// 交换I/O使用的缓冲块头.每个页面拆成4个1KB的缓冲块,与合并过的请求项一样链在请求项上,所以内存中不连续的
+// 页面也能由一条读写命令连续传送.这些缓冲块头不在高速缓冲的链表中,同一时刻只能有一批交换I/O使用它们.
+static struct buffer_head swap_bh[SWAP_CLUSTER * 4];
+static int swap_bh_busy = 0;
+static struct task_struct * swap_bh_wait = NULL;
+
+// 取一个空闲请求项,没有时睡眠等待.
+static struct request * get_request_wait(void)
 {
 	struct request * req;
-	unsigned int major = MAJOR(dev);
 
-	// 首先对函数参数的合法性进行检测.如果设备主设备号不存在或者该设备的请求操作函数不存在,则显示出错信息,并返回.如果参数给出的命令既不是
-	// READ也不是WRITE,则表示内核程序有错,显示出错信息并停机.
-	if (major >= NR_BLK_DEV || !(blk_dev[major].request_fn)) {
-		printk("Trying to read nonexistent block-device\n\r");
-		return;
-	}
-	if (rw != READ && rw != WRITE)
-		panic("Bad block dev command, must be R/W");
-	// 在参数检测操作完成后,我们现在需要为本次操作建立请求项.首先我们需要在请求数组中寻找到一个空闲项(糟)来存放新请求项.搜索过程从请求数组末端
-	// 开始.于是我们开始从后向前搜索,当请求结构request的设备字段值<0时,表示该项未被占用(空闲).如果没有一项是空闲的(此时请求项数组指针已经搜索越过
-	// 头部),则让本次请求操作先睡眠(以等待请求队列腾出空项),过一会再来搜索请求队列.
 repeat:
-	req = request + NR_REQUEST;							// 将指针指向队列尾部.
+	req = request + NR_REQUEST;							// 从队列尾部开始搜索.
 	while (--req >= request)
 		if (req->dev < 0)
 			break;
@@ -254,25 +293,81 @@ repeat:
 		sleep_on(&wait_for_request);					// 睡眠,过会再查看请求队列.
 		goto repeat;
 	}
-	/* fill up the request-info, and add it to the queue */
-	/* 向空闲请求项中填写请求信息,并将其加入队列中 */
-	// OK,程序执行到这里表示已找到一个空闲请求项.于是我们设置好新请求项,把当前进程置为不可中断睡眠中断后,就去调用add_request()把它添加到请求队列中,
-	// 然后直接调用调度函数让当前进程睡眠等待页面从交换设备中读入.这里不像make_request()函数那样直接退出函数而调用了schedule(),是因为make_request()
-	// 函数仅读2个扇区数据.而这里需要对交换设备读/写8个扇区,需要花较长的时间.因此当前进程肯定需要等待而睡眠.因此这里直接就让进程去睡眠了,省得在程序其他地方
-	// 还要进行这些判断操作.
-	req->dev = dev;										// 设备号
-	req->cmd = rw;										// 命令(READ/WRITE)start_code
-	req->errors = 0;									// 读写操作错误计数
-	req->sector = page << 3;							// 起始读写扇区
-	req->nr_sectors = 8;								// 读写扇区数
-	req->buffer = buffer;								// 数据缓冲区
-	req->waiting = current;								// 当前进程进入该请求等待队列
-	req->bh = NULL;										// 无缓冲块头指针(不用高速缓冲)
-	req->next = NULL;									// 下一个请求项指针
-	current->state = TASK_UNINTERRUPTIBLE;				// 置为不可中断状态
-	add_request(major + blk_dev, req);					// 将请求项加入队列中.
-	// 当前进程需要读取8个扇区的数据因此需要睡眠，因此调用调度程序选择进程运行
-	schedule();
+	return req;
+}
+
+// 成批读写交换设备上连续的页面(Low Level Read Write Swap).
+// 参数page是第一个页面在设备上的页面号,buffers[]是nr个页面的内存地址,nr不超过SWAP_CLUSTER.
+// 各页面的缓冲块按扇区顺序链入请求项,每个请求项不超过设备的max_sectors;不允许合并的设备每个请求项只含一块.
+// 所有请求项发出后才等待它们完成,因此是一次连续的磁盘传送而不是逐页的寻道.
+void ll_rw_swap(int rw, int dev, int page, char ** buffers, int nr)
+{
+	struct blk_dev_struct * bdev;
+	struct request * req = NULL;
+	struct buffer_head * bh;
+	unsigned long max;
+	int i;
+
+	if (MAJOR(dev) >= NR_BLK_DEV || !(blk_dev[MAJOR(dev)].request_fn)) {
+		printk("Trying to read nonexistent block-device\n\r");
+		return;
+	}
+	if (rw != READ && rw != WRITE)
+		panic("Bad block dev command, must be R/W");
+	if (nr > SWAP_CLUSTER)
+		panic("ll_rw_swap: too many pages");
+	bdev = blk_dev + MAJOR(dev);
+	max = bdev->max_sectors ? bdev->max_sectors : 2;
+	while (swap_bh_busy)
+		sleep_on(&swap_bh_wait);
+	swap_bh_busy = 1;
+	for (i = 0, bh = swap_bh; i < nr * 4; i++, bh++) {
+		bh->b_data = buffers[i >> 2] + ((i & 3) << 10);
+		bh->b_blocknr = (page << 2) + i;
+		bh->b_dev = dev;
+		bh->b_uptodate = 0;
+		bh->b_lock = 1;
+		bh->b_wait = NULL;
+		bh->b_reqnext = NULL;
+		// 能接在当前请求项后面就接上,否则把当前请求项加入队列,另取一个.
+		if (req && req->nr_sectors + 2 <= max) {
+			req->bhtail->b_reqnext = bh;
+			req->bhtail = bh;
+			req->nr_sectors += 2;
+			continue;
+		}
+		if (req)
+			add_request(bdev, req);
+		req = get_request_wait();
+		req->dev = dev;
+		req->cmd = rw;
+		req->errors = 0;
+		req->sector = bh->b_blocknr << 1;
+		req->nr_sectors = 2;
+		req->current_nr_sectors = 2;
+		req->buffer = bh->b_data;
+		req->waiting = NULL;
+		req->bh = bh;
+		req->bhtail = bh;
+		req->next = NULL;
+	}
+	add_request(bdev, req);
+	// 等待所有缓冲块传送完毕.
+	for (i = 0, bh = swap_bh; i < nr * 4; i++, bh++) {
+		cli();
+		while (bh->b_lock)
+			sleep_on(&bh->b_wait);
+		sti();
+	}
+	swap_bh_busy = 0;
+	wake_up(&swap_bh_wait);
+}
+
+// 低级页面读写函数(Low Level Read Write Page).
+// 以页面(4K)为单位访问设备数据,即每次读/写8个扇区.
+void ll_rw_page(int rw, int dev, int page, char * buffer)
+{
+	ll_rw_swap(rw, dev, page, &buffer, 1);
 }
 
 // 低级数据块读写函数(Low Level Read Write Block)
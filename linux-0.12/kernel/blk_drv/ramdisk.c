@@ -47,7 +47,7 @@ void do_rd_request(void)
 	 */
 	INIT_REQUEST;
 	addr = rd_start + (CURRENT->sector << 9);
-	len = CURRENT->nr_sectors << 9;
+	len = CURRENT->current_nr_sectors << 9;	/* 合并过的请求项每次只处理第一个缓冲块 */
 	/*
 	 * 如果当前请求项中子设备号不为1或者对应内存起始位置大于虚拟盘末尾，则结束该请求项，并跳转到repeat处去处理下一个虚拟盘请求。标号repeat
 	 * 定义在宏INIT_REQUEST内，位于宏的开始处，参见blk.h文件
@@ -70,7 +70,7 @@ void do_rd_request(void)
 			      len);
 	} else
 		panic("unknown ramdisk-command");
-	/* 然后在请求项成功后处理，置更新标志，并继续处理本设备的下一请求项 */
+	/* 然后在请求项成功后处理，置更新标志，并继续处理本请求项的下一缓冲块或本设备的下一请求项 */
 	end_request(1);
 	goto repeat;
 }
@@ -91,6 +91,7 @@ long rd_init(long mem_start, int length)
 	char	*cp;
 
 	blk_dev[MAJOR_NR].request_fn = DEVICE_REQUEST;	/* do_rd_request() */
+	blk_dev[MAJOR_NR].max_sectors = 256;			/* 内存盘没有传送长度限制，允许合并请求项 */
 	rd_start = (char *) mem_start;					/* 对于16MB系统该值为4MB */
 	rd_length = length;								/* 虚拟盘区域长度值 */
 	cp = rd_start;
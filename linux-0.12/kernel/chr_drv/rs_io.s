@@ -179,11 +179,15 @@ write_char:
  */
 .align 2
 write_buffer_empty:
-	movl proc_list(%ecx),%ebx	# wake up sleeping process	/* 唤醒等待的进程，取等待该队列的进程的指针，并判断是否为空 */
-	testl %ebx,%ebx			# is there any?	/* 有等待的进程吗？ */
-	je 1f					/* 无，则向前跳转到标号1处 */
-	movl $0,(%ebx)			/* 否则将进程置为可运行状态（唤醒进程） */
-1:	incl %edx				/* 指向端口0x3f8（0x2f9） */
+	pushl %edx				/* 队列已空，调用wake_up()唤醒等待的进程，同时通知epoll */
+	pushl %ecx
+	leal proc_list(%ecx),%ebx
+	pushl %ebx
+	call wake_up
+	addl $4,%esp
+	popl %ecx
+	popl %edx
+	incl %edx				/* 指向端口0x3f8（0x2f9） */
 	inb %dx,%al				/* 读取中断允许寄存器IER */
 	jmp 1f					/* 稍作延迟 */
 1:	jmp 1f					/* 屏蔽发送保持寄存器空中断（位1） */
@@ -388,6 +388,7 @@ int tty_read(unsigned channel, char * buf, int nr)
 	struct tty_struct * tty;
 	struct tty_struct * other_tty = NULL;
 	char c, * b=buf;
+	char tmp[64], * t;		/* 取出的字符先放在这里，攒够一批再复制到用户缓冲区 */
 	int minimum,time;
 
 	/*
@@ -423,10 +424,10 @@ int tty_read(unsigned channel, char * buf, int nr)
 	 */
 	if (L_CANON(tty)) {
 		minimum = nr;
-		current->timeout = 0xffffffff;
+		current->timeout = TIMEOUT_FOREVER;
 		time = 0;
 	} else if (minimum)
-		current->timeout = 0xffffffff;
+		current->timeout = TIMEOUT_FOREVER;
 	else {
 		minimum = nr;
 		if (time)
@@ -470,6 +471,7 @@ int tty_read(unsigned channel, char * buf, int nr)
 		 * 数据缓冲区buf中，并把欲读字符数减1。此时如果欲读字符数已为0则中断循环。另外，如果终端处于规范模式并且读取的字符是换行符NL（10），则也退出循环。除此之外，
 		 * 只要还没有取完欲读字符数nr并且辅助队列不空，就继续去队列中的字符
 		 */
+		t = tmp;
 		do {
 			GETCH(tty->secondary,c);
 			if ((EOF_CHAR(tty) != _POSIX_VDISABLE &&
@@ -479,13 +481,20 @@ int tty_read(unsigned channel, char * buf, int nr)
 			     c==EOF_CHAR(tty)) && L_CANON(tty))
 				break;
 			else {
-				put_fs_byte(c,b++);
+				*t++ = c;
+				if (t == tmp + sizeof(tmp)) {
+					copy_to_user(b, tmp, sizeof(tmp));
+					b += sizeof(tmp);
+					t = tmp;
+				}
 				if (!--nr)
 					break;
 			}
 			if (c==10 && L_CANON(tty))
 				break;
 		} while (nr>0 && !EMPTY(tty->secondary));
+		copy_to_user(b, tmp, t - tmp);
+		b += t - tmp;
 		/*
 		 * 执行到此，那么如果tty终端处于规范模式下，说明我们可能读到了换行符或者遇到了文件结束符。如果是处于非规范模式下，那么说明我们已经读取了nr个字符，或者辅助队列已经被取空了。
 		 * 于是我们首先唤醒等待读队列的进程，然后看看是否设置过超时定时值time。如果超时定时值time不为0，我们就要求等待一定的时间让其他进程可以把字符写入读队列中。于是设置进程读超时
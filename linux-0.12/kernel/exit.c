@@ -38,31 +38,37 @@ int sys_close(int fd);		/* 关闭指定文件的系统调用（fs/open.c） */
 		return;
 	}
 	/*
-	 * 扫描任务结构指针数组，寻找指定的任务p。如果找到，则置空任务指针数组中对应项，并且更新任务结构之间的关联指针，释放任务p数据结构占用的内存页面
-	 * 最后在执行调度程序返回后退出。如果没有找到指定的任务p，则说明内核代码出错了，则显示出错信息并死机。更新链接部分的代码会把指定任务p从双向链表中删除
+	 * 由任务号找到任务p所在的任务槽。如果找到，则置空任务指针数组中对应项并放回空闲任务槽栈，把任务从pid hash表中删除，并且更新任务结构之间的关联指针，
+	 * 释放任务p数据结构占用的内存页面，最后在执行调度程序返回后退出。如果任务槽中不是任务p，则说明内核代码出错了，则显示出错信息并死机。更新链接部分的
+	 * 代码会把指定任务p从双向链表中删除
 	 */
-	for (i = 1 ; i < NR_TASKS ; i++)
-		if (task[i] == p) {
-			task[i] = NULL;
-			/* Update links */	/* 更新链接 */
-			/*
-			 * 如果p不是最后（最老）的子进程，则让比其老的比邻进程执行比它新的比邻进程。如果p不是最新的子进程，则让比其新的比邻子进程执行比邻的老进程。如果
-			 * 任务p就是最新的子进程，则还需要更新其父进程的最新子进程指针cptr为指向p的比邻子进程
-			 * 指针osptr（old sibling pointer）指向比p先创建的兄弟进程
-			 * 指针ysptr（younger sibling pointer）指向比p后创建的兄弟进程
-			 * 指针pptr（parent pointer）指向p的父进程
-			 * 指针cptr（child pointer）是父进程指向最新（最后）创建的子进程
-			 */
-			if (p->p_osptr)
-				p->p_osptr->p_ysptr = p->p_ysptr;
-			if (p->p_ysptr)
-				p->p_ysptr->p_osptr = p->p_osptr;
-			else
-				p->p_pptr->p_cptr = p->p_osptr;
-			free_page((long)p);
-			schedule();
-			return;
-		}
+	i = p->task_nr;
+	if (i > 0 && i < NR_TASKS && task[i] == p) {
+		task[i] = NULL;
+		put_task_slot(i);
+		unhash_task(p);
+		del_timer(&p->timeout_timer);
+		del_timer(&p->real_timer);
+		scstat_release(p);
+		/* Update links */	/* 更新链接 */
+		/*
+		 * 如果p不是最后（最老）的子进程，则让比其老的比邻进程执行比它新的比邻进程。如果p不是最新的子进程，则让比其新的比邻子进程执行比邻的老进程。如果
+		 * 任务p就是最新的子进程，则还需要更新其父进程的最新子进程指针cptr为指向p的比邻子进程
+		 * 指针osptr（old sibling pointer）指向比p先创建的兄弟进程
+		 * 指针ysptr（younger sibling pointer）指向比p后创建的兄弟进程
+		 * 指针pptr（parent pointer）指向p的父进程
+		 * 指针cptr（child pointer）是父进程指向最新（最后）创建的子进程
+		 */
+		if (p->p_osptr)
+			p->p_osptr->p_ysptr = p->p_ysptr;
+		if (p->p_ysptr)
+			p->p_ysptr->p_osptr = p->p_osptr;
+		else
+			p->p_pptr->p_cptr = p->p_osptr;
+		free_page((long)p);
+		schedule();
+		return;
+	}
 	panic("trying to release non-existent task");
 }
 
@@ -191,7 +197,7 @@ static inline int send_sig(long sig,struct task_struct * p,int priv)
 	 */
 	if ((sig == SIGKILL) || (sig == SIGCONT)) {
 		if (p->state == TASK_STOPPED)
-			p->state = TASK_RUNNING;
+			wake_up_process(p);
 		p->exit_code = 0;
 		p->signal &= ~( (1<<(SIGSTOP-1)) | (1<<(SIGTSTP-1)) |
 				(1<<(SIGTTIN-1)) | (1<<(SIGTTOU-1)) );
@@ -211,17 +217,18 @@ static inline int send_sig(long sig,struct task_struct * p,int priv)
 	/* Actually deliver the signal */
 	/* 最后，我们向进程p发送信号p */
 	p->signal |= (1<<(sig-1));
+	signal_wake_up(p);
 	return 0;
 }
 
-/* 根据进程组号pgrp取得进程组所属的会话号。扫描任务数组，寻找进程组号为pgrp的进程，并返回其会话号。如果没有找到指定进程组号为pgrp的任何进程，则返回-1 */
+/* 根据进程组号pgrp取得进程组所属的会话号。在进程组hash队列中寻找进程组号为pgrp的进程，并返回其会话号。如果没有找到指定进程组号为pgrp的任何进程，则返回-1 */
 int session_of_pgrp(int pgrp)
 {
-	struct task_struct **p;
+	struct task_struct *p;
 
- 	for (p = &LAST_TASK ; p > &FIRST_TASK ; --p)
-		if ((*p)->pgrp == pgrp)
-			return((*p)->session);
+	for (p = pghash[pid_hashfn(pgrp)] ; p ; p = p->pg_next)
+		if (p->pgrp == pgrp)
+			return(p->session);
 	return -1;
 }
 
@@ -233,16 +240,16 @@ int session_of_pgrp(int pgrp)
  */
 int kill_pg(int pgrp, int sig, int priv)
 {
-	struct task_struct **p;
+	struct task_struct *p;
 	int err,retval = -ESRCH;		/* -ESRCH表示指定的进程不存在 */
 	int found = 0;
 
-	/* 首先判断给定的信号和进程组号是否有效，然后扫描系统中所有任务。若扫描到进程组号为pgrp的进程，就向其发送信号sig。只要有一次信号发送成功，函数最后就会返回0 */
+	/* 首先判断给定的信号和进程组号是否有效，然后扫描进程组hash队列。若扫描到进程组号为pgrp的进程，就向其发送信号sig。只要有一次信号发送成功，函数最后就会返回0 */
 	if (sig<1 || sig>32 || pgrp<=0)
 		return -EINVAL;
- 	for (p = &LAST_TASK ; p > &FIRST_TASK ; --p)
-		if ((*p)->pgrp == pgrp) {
-			if (sig && (err = send_sig(sig,*p,priv)))
+	for (p = pghash[pid_hashfn(pgrp)] ; p ; p = p->pg_next)
+		if (p->pgrp == pgrp) {
+			if (sig && (err = send_sig(sig,p,priv)))
 				retval = err;
 			else
 				found++;
@@ -258,13 +265,12 @@ int kill_pg(int pgrp, int sig, int priv)
  */
 int kill_proc(int pid, int sig, int priv)
 {
- 	struct task_struct **p;
+ 	struct task_struct *p;
 
 	if (sig<1 || sig>32)
 		return -EINVAL;
-	for (p = &LAST_TASK ; p > &FIRST_TASK ; --p)
-		if ((*p)->pid == pid)
-			return(sig ? send_sig(sig,*p,priv) : 0);
+	if ((p = find_task_by_pid(pid)))
+		return(sig ? send_sig(sig,p,priv) : 0);
 	return(-ESRCH);
 }
 
@@ -332,30 +338,29 @@ int sys_kill(int pid,int sig)
  */
 int is_orphaned_pgrp(int pgrp)
 {
-	struct task_struct **p;
+	struct task_struct *p;
 
-	for (p = &LAST_TASK ; p > &FIRST_TASK ; --p) {
-		if (!(*p) ||
-		    ((*p)->pgrp != pgrp) || 
-		    ((*p)->state == TASK_ZOMBIE) ||
-		    ((*p)->p_pptr->pid == 1))
+	for (p = pghash[pid_hashfn(pgrp)] ; p ; p = p->pg_next) {
+		if ((p->pgrp != pgrp) || 
+		    (p->state == TASK_ZOMBIE) ||
+		    (p->p_pptr->pid == 1))
 			continue;
-		if (((*p)->p_pptr->pgrp != pgrp) &&
-		    ((*p)->p_pptr->session == (*p)->session))
+		if ((p->p_pptr->pgrp != pgrp) &&
+		    (p->p_pptr->session == p->session))
 			return 0;
 	}
 	return(1);	/* (sighing) "Often!" */ /* （唉）是孤儿进程组！ */
 }
 
-/* 判断进程组中是否含有处于停止状态的作业（进程组）。有则返回1；无则返回0。查找方法是扫描整个任务数组。检查属于指定组pgrp的任何进程是否处于停止状态 */
+/* 判断进程组中是否含有处于停止状态的作业（进程组）。有则返回1；无则返回0。查找方法是扫描进程组hash队列。检查属于指定组pgrp的任何进程是否处于停止状态 */
 static int has_stopped_jobs(int pgrp)
 {
-	struct task_struct ** p;
+	struct task_struct * p;
 
-	for (p = &LAST_TASK ; p > &FIRST_TASK ; --p) {
-		if ((*p)->pgrp != pgrp)
+	for (p = pghash[pid_hashfn(pgrp)] ; p ; p = p->pg_next) {
+		if (p->pgrp != pgrp)
 			continue;
-		if ((*p)->state == TASK_STOPPED)
+		if (p->state == TASK_STOPPED)
 			return(1);
 	}
 	return(0);
@@ -423,6 +428,7 @@ volatile void do_exit(long code)
 	}
 	/* Let father know we died */	/* 通知父进程当前进程将终止 */
 	current->p_pptr->signal |= (1<<(SIGCHLD-1));
+	signal_wake_up(current->p_pptr);
 	
 	/*
 	 * This loop does two things:
@@ -445,8 +451,10 @@ volatile void do_exit(long code)
 	if ((p = current->p_cptr)) {
 		while (1) {
 			p->p_pptr = task[1];
-			if (p->state == TASK_ZOMBIE)
+			if (p->state == TASK_ZOMBIE) {
 				task[1]->signal |= (1<<(SIGCHLD-1));
+				signal_wake_up(task[1]);
+			}
 			/*
 			 * process group orphan check
 			 * Case ii: Our child is in a different pgrp 
@@ -493,10 +501,10 @@ volatile void do_exit(long code)
 	}
 	/*
 	 * 如果当前进程是会话头领（leader）进程，那么若它又控制终端，则首先向使用该控制终端的进程组发送挂断信号SIGHUP，然后释放该终端。
-	 * 接着扫描任务数组，把属于当前进程会话中进程的终端置空（取消）
+	 * 接着扫描会话hash队列，把属于当前进程会话中进程的终端置空（取消）
 	 */
 	if (current->leader) {
-		struct task_struct **p;
+		struct task_struct *p;
 		struct tty_struct *tty;
 
 		if (current->tty >= 0) {
@@ -506,9 +514,9 @@ volatile void do_exit(long code)
 			tty->pgrp = 0;
 			tty->session = 0;
 		}
-	 	for (p = &LAST_TASK ; p > &FIRST_TASK ; --p)
-			if ((*p)->session == current->session)
-				(*p)->tty = -1;
+		for (p = sesshash[pid_hashfn(current->session)] ; p ; p = p->sess_next)
+			if (p->session == current->session)
+				p->tty = -1;
 	}
 	/*
 	 * 如果当前进程上次使用过协处理器，则把记录此信息的指针置空。若定义了调试进程树符号，则调用进程树检测显示函数。最后调用调度函数
@@ -548,16 +556,23 @@ void sys_exit(int error_code)
 int sys_waitpid(pid_t pid,unsigned long * stat_addr, int options)
 {
 	int flag;					/* 该标志用于后面表示所选出的子进程处于就绪或睡眠态 */
-	struct task_struct *p;
+	struct task_struct *p, *first;
 	unsigned long oldblocked;
 
 	/*
-	 * 首先验证将要存放状态信息的位置处内存空间足够。然后复位标志flag。接着从当前进程的最年轻子进程开始扫描子进程兄弟链表
+	 * 首先验证将要存放状态信息的位置处内存空间足够。然后复位标志flag。接着从当前进程的最年轻子进程开始扫描子进程兄弟链表。等待指定pid的
+	 * 子进程时直接从pid hash表中找到它，只检查这一个进程
 	 */
 	verify_area(stat_addr,4);
 repeat:
 	flag=0;
-	for (p = current->p_cptr ; p ; p = p->p_osptr) {
+	first = current->p_cptr;
+	if (pid>0) {
+		first = find_task_by_pid(pid);
+		if (first && first->p_pptr != current)
+			first = NULL;
+	}
+	for (p = first ; p ; p = (pid>0) ? NULL : p->p_osptr) {
 		/* 如果等待的子进程号pid>0，并且与被扫描子进程p的pid不相等，说明它是当前进程另外的子进程。于是跳过，接着扫描下一进程。否则表示找到等待的子进程pid，于是执行switch*/
 		if (pid>0) {
 			if (p->pid != pid)
@@ -68,8 +68,8 @@ void verify_area(void * addr, int size)
 /**
  * 复制内存页表
  * 该函数为新任务在线性地址空间中设置代码段和数据段基址，限长，并复制页表。由于Linux系统采用写时复制
- * (copy on write)技术，因此这里仅为新进程设置自己的页目录表项和页表项，而没有实际为新进程分配物理内
- * 存页面。此时新进程与其父进程共享所有内存页面。
+ * (copy on write)技术，因此这里仅为新进程设置自己的页目录表项，页表和物理内存页面都与父进程共享，
+ * 直到有一方写时才复制(见mm/memory.c中的copy_page_tables())。
  * @param[in]		nr		新任务号
  * @param[in]		p		新任务的数据结构指针
  * @retval			成功返回0，失败返回出错号
@@ -144,6 +144,7 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
      */
     p = (struct task_struct *) get_free_page();
     if (!p) {
+        put_task_slot(nr);
         return -EAGAIN;
     }
     task[nr] = p;
@@ -155,14 +156,17 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
      * 其子进程在内核和用户态运行时间统计值，还设置进程开始运行的系统时间start_time
      */
     p->state = TASK_UNINTERRUPTIBLE;
+    p->task_nr = nr;                    /* 任务号 */
     p->pid = last_pid;                  /* 新进程号。也由find_empty_process()得到 */
     p->counter = p->priority;           /* 运行时间片值（滴答数） */
     p->signal = 0;                      /* 信号位图 */
     p->alarm = 0;                       /* 报警定时值（滴答数） */
+    init_task_timers(p);                /* 复制来的定时器不能沿用 */
     p->leader = 0;		/* process leadership doesn't inherit */    /* 进程的领导权是不能继承的 */
     p->utime = p->stime = 0;            /* 用户态时间和核心态运行时间 */
     p->cutime = p->cstime = 0;          /* 子进程用户态和和心态运行时间 */
     p->start_time = jiffies;            /* 进程开始运行时间（当前时间滴答数） */
+    p->sc_stats = NULL;                 /* 子进程的系统调用统计从零开始 */
 
     /* 修改任务状态段TSS内容 */
     /*
@@ -204,6 +208,7 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
     /* 在线性地址空间中设置新任务代码段和数据段描述符中的基地址和限长，并复制页表。如果出错（返回值不是0），则复位任务数组中相应项并释放为该新任务分配的用于任务结构的内存页 */
     if (copy_mem(nr,p)) {       /* 返回不为0表示出错 */
         task[nr] = NULL;
+        put_task_slot(nr);
         free_page((long) p);
         return -EAGAIN;
     }
@@ -249,8 +254,9 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
         p->p_osptr->p_ysptr = p;
     }
     current->p_cptr = p;            /* 让当前进程最新子进程指针指向新进程 */
+    hash_task(p);                   /* 按pid、pgrp和session加入hash表 */
 
-    p->state = TASK_RUNNING;	/* do this last, just in case */
+    wake_up_new_task(p);	/* do this last, just in case */    /* 置为就绪状态并放入就绪队列 */
 
     return last_pid;
 }
@@ -263,27 +269,89 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs, long none,
  */
 int find_empty_process(void)
 {
-    int i;
-
     /*
-     * 首先获取新的进程号。如果last_pid增1后超出进程号的正数表示范围，则重新从1开始使用pid号。然后在任务数组中搜索刚设置的pid号是否已经被任何任务使用。
-     * 如果是则跳转到函数开始处重新获得一个pid号。接着在任务数组中为新任务寻找一个空闲项，并返回项号。last_pid是一个全局变量，不用返回。如果此时任务数组
-     * 中64个项已经被全部占用，则返回出错码
+     * 首先获取新的进程号。如果last_pid增1后超出进程号的正数表示范围，则重新从1开始使用pid号。然后在hash表中查找刚设置的pid号是否已经被任何任务用作
+     * 进程号、进程组号或会话号，如果是则跳转到函数开始处重新获得一个pid号。接着从空闲任务槽栈中为新任务取一个任务槽，并返回项号。last_pid是一个全局变量，
+     * 不用返回。如果此时任务数组中64个项已经被全部占用，则返回出错码。取到的任务槽若最终没有使用，调用者要用put_task_slot()放回
      */
     repeat:
         if ((++last_pid) < 0) {
             last_pid = 1;
         }
-        for(i = 0; i < NR_TASKS; i++) {
-            if (task[i] && ((task[i]->pid == last_pid) ||
-                        (task[i]->pgrp == last_pid))) {
-                goto repeat;
-            }
-        }
-    for(i = 1; i < NR_TASKS; i++) {        /* 任务0项呗排除在外 */
-        if (!task[i]) {
-            return i;
+        if (pid_in_use(last_pid)) {
+            goto repeat;
         }
+    return get_task_slot();             /* 取空闲任务槽，任务0项不在其中 */
+}
+
+/**
+ * 创建内核任务
+ * 新任务在特权级0上从fn开始执行，使用内核代码段和数据段(0x08/0x10)以及任务0的页目录，
+ * 栈就是任务结构所在页面的顶端。它不复制任何用户内存，也不继承打开的文件和当前目录，因此
+ * 只能调用内核函数而不能执行系统调用。由于内核态代码不会被时钟中断抢占，fn必须自己睡眠以
+ * 让出CPU；fn不能返回。新任务屏蔽所有可屏蔽信号，并作为任务0的子进程挂入进程树。
+ * @param[in]	fn		任务入口函数
+ * @retval		成功返回新任务的进程号，失败返回错误号
+ */
+int kernel_thread(void (*fn)(void))
+{
+    struct task_struct *p;
+    int nr;
+
+    if ((nr = find_empty_process()) < 0) {
+        return nr;
+    }
+    p = (struct task_struct *) get_free_page();
+    if (!p) {
+        put_task_slot(nr);
+        return -EAGAIN;
     }
-    return -EAGAIN;
+    task[nr] = p;
+    *p = *task[0];                      /* 以任务0为模板：LDT基址为0，页目录为pg_dir，没有文件 */
+
+    p->state = TASK_UNINTERRUPTIBLE;
+    p->task_nr = nr;
+    p->pid = last_pid;
+    p->pgrp = p->session = 0;
+    p->leader = 0;
+    p->counter = p->priority;
+    p->signal = 0;
+    p->blocked = ~0;                    /* SIGKILL和SIGSTOP除外，见schedule() */
+    p->alarm = p->timeout = 0;
+    init_task_timers(p);
+    p->utime = p->stime = 0;
+    p->cutime = p->cstime = 0;
+    p->start_time = jiffies;
+    p->tty = -1;
+
+    p->tss.back_link = 0;
+    p->tss.esp0 = PAGE_SIZE + (long) p;
+    p->tss.ss0 = 0x10;
+    p->tss.eip = (long) fn;
+    p->tss.eflags = 0x200;              /* 只置中断允许标志IF */
+    p->tss.eax = p->tss.ecx = p->tss.edx = p->tss.ebx = 0;
+    p->tss.esp = PAGE_SIZE + (long) p;  /* 特权级0的任务在中断时不切换栈，esp0实际上不使用 */
+    p->tss.ebp = p->tss.esi = p->tss.edi = 0;
+    p->tss.cs = 0x08;
+    p->tss.es = p->tss.ss = p->tss.ds = 0x10;
+    p->tss.fs = p->tss.gs = 0x10;
+    p->tss.ldt = _LDT(nr);
+    p->tss.trace_bitmap = 0x80000000;
+
+    set_tss_desc(gdt+(nr<<1)+FIRST_TSS_ENTRY, &(p->tss));
+    set_ldt_desc(gdt+(nr<<1)+FIRST_LDT_ENTRY, &(p->ldt));
+
+    p->p_pptr = task[0];
+    p->p_cptr = 0;
+    p->p_ysptr = 0;
+    p->p_osptr = task[0]->p_cptr;
+    if (p->p_osptr) {
+        p->p_osptr->p_ysptr = p;
+    }
+    task[0]->p_cptr = p;
+    hash_task(p);
+
+    wake_up_new_task(p);
+
+    return last_pid;
 }
@@ -16,6 +16,8 @@
 void math_error(void)
 {
 	__asm__("fnclex");									/* 清除状态字中所有异常标志位和忙位 */
-	if (last_task_used_math)							/* 若用过协处理器，则设置其出错信号 */
+	if (last_task_used_math) {							/* 若用过协处理器，则设置其出错信号 */
 		last_task_used_math->signal |= 1<<(SIGFPE-1);
+		signal_wake_up(last_task_used_math);
+	}
 }
@@ -0,0 +1,195 @@
+/*
+ *  linux/kernel/pid.c
+ */
+
+/*
+ * 按进程号、进程组号和会话号查找任务，以及任务槽的分配。
+ *
+ * 每个任务(任务0除外)按它的pid、pgrp和session分别挂在三个hash表的双向链表上，同一进程组或同一会
+ * 话的任务都在同一个hash队列中，所以向进程组发信号、判断孤儿进程组等操作只需查看一个队列，而不必
+ * 扫描整个task[]数组。hash表只在进程上下文中修改，但键盘中断等会通过kill_pg()读取它们，所以修改
+ * 时要关中断。
+ *
+ * 空闲的任务槽放在一个栈中，find_empty_process()从栈中取槽，任务被释放时放回。注意任务数的上限
+ * NR_TASKS不能随意增大：任务号同时决定了任务在GDT中的TSS和LDT描述符，以及任务在线性地址空间中的
+ * 位置(nr * TASK_SIZE，见copy_mem())，它受段式内存布局的限制。
+ */
+#include <errno.h>			/* 错误号头文件。包含系统中各种出错号 */
+
+#include <linux/sched.h>	/* 调度程序头文件。定义了任务结构task_struct、任务0数据等 */
+#include <linux/kernel.h>	/* 内核头文件。含有一些内核常用函数的原型定义 */
+#include <asm/system.h>		/* 系统头文件。定义了设置或修改描述符/中断门等的嵌入式汇编宏 */
+
+struct task_struct * pidhash[PIDHASH_SZ];	/* 进程号hash表 */
+struct task_struct * pghash[PIDHASH_SZ];	/* 进程组号hash表 */
+struct task_struct * sesshash[PIDHASH_SZ];	/* 会话号hash表 */
+
+static int free_slots[NR_TASKS];			/* 空闲任务槽栈 */
+static int nr_free_slots = 0;
+
+/* 把任务p插入以*head开头的链表。next和pprev是p中对应链表的两个链接字段 */
+#define hash_add(head, p, next, pprev) do {			\
+	if (((p)->next = *(head))) {					\
+		(p)->next->pprev = &(p)->next;				\
+	}												\
+	*(head) = (p);									\
+	(p)->pprev = (head);							\
+} while (0)
+
+/* 把任务p从它所在的链表中删除 */
+#define hash_del(p, next, pprev) do {				\
+	if ((p)->next) {								\
+		(p)->next->pprev = (p)->pprev;				\
+	}												\
+	*(p)->pprev = (p)->next;						\
+} while (0)
+
+/**
+ * 把新任务加入三个hash表
+ * 在任务的pid、pgrp和session都设置好以后调用。
+ * @param[in]	p		任务结构指针
+ * @retval		void
+ */
+void hash_task(struct task_struct * p)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	hash_add(pidhash + pid_hashfn(p->pid), p, pidhash_next, pidhash_pprev);
+	hash_add(pghash + pid_hashfn(p->pgrp), p, pg_next, pg_pprev);
+	hash_add(sesshash + pid_hashfn(p->session), p, sess_next, sess_pprev);
+	restore_flags(flags);
+}
+
+/**
+ * 把任务从三个hash表中删除
+ * @param[in]	p		任务结构指针
+ * @retval		void
+ */
+void unhash_task(struct task_struct * p)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	hash_del(p, pidhash_next, pidhash_pprev);
+	hash_del(p, pg_next, pg_pprev);
+	hash_del(p, sess_next, sess_pprev);
+	restore_flags(flags);
+}
+
+/**
+ * 改变任务的进程组号
+ * @param[in]	p		任务结构指针
+ * @param[in]	pgrp	新的进程组号
+ * @retval		void
+ */
+void set_pgrp(struct task_struct * p, long pgrp)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	hash_del(p, pg_next, pg_pprev);
+	p->pgrp = pgrp;
+	hash_add(pghash + pid_hashfn(pgrp), p, pg_next, pg_pprev);
+	restore_flags(flags);
+}
+
+/**
+ * 改变任务的会话号
+ * @param[in]	p		任务结构指针
+ * @param[in]	session	新的会话号
+ * @retval		void
+ */
+void set_session(struct task_struct * p, long session)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	hash_del(p, sess_next, sess_pprev);
+	p->session = session;
+	hash_add(sesshash + pid_hashfn(session), p, sess_next, sess_pprev);
+	restore_flags(flags);
+}
+
+/**
+ * 按进程号查找任务
+ * @param[in]	pid		进程号
+ * @retval		任务结构指针，不存在时返回NULL
+ */
+struct task_struct * find_task_by_pid(long pid)
+{
+	struct task_struct * p;
+
+	for (p = pidhash[pid_hashfn(pid)]; p; p = p->pidhash_next) {
+		if (p->pid == pid) {
+			return p;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * 判断进程号是否正被某个任务用作进程号、进程组号或会话号
+ * @param[in]	pid		进程号
+ * @retval		正被使用返回1，否则返回0
+ */
+int pid_in_use(long pid)
+{
+	struct task_struct * p;
+
+	if (find_task_by_pid(pid)) {
+		return 1;
+	}
+	for (p = pghash[pid_hashfn(pid)]; p; p = p->pg_next) {
+		if (p->pgrp == pid) {
+			return 1;
+		}
+	}
+	for (p = sesshash[pid_hashfn(pid)]; p; p = p->sess_next) {
+		if (p->session == pid) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * 取一个空闲的任务槽
+ * 任务槽在调用者把任务结构放入task[]之前就已经被占用，所以中间睡眠也不会被别人取走。
+ * @retval		任务号，没有空闲槽时返回-EAGAIN
+ */
+int get_task_slot(void)
+{
+	if (!nr_free_slots) {
+		return -EAGAIN;
+	}
+	return free_slots[--nr_free_slots];
+}
+
+/**
+ * 释放任务槽
+ * @param[in]	nr		任务号
+ * @retval		void
+ */
+void put_task_slot(int nr)
+{
+	free_slots[nr_free_slots++] = nr;
+}
+
+/**
+ * 初始化空闲任务槽栈
+ * 按任务号从大到小压栈，使小的任务号先被使用。在sched_init()中调用。
+ * @retval		void
+ */
+void pid_init(void)
+{
+	int i;
+
+	for (i = NR_TASKS - 1; i > 0; i--) {
+		put_task_slot(i);
+	}
+}
@@ -0,0 +1,220 @@
+/*
+ *  linux/kernel/profile.c
+ */
+
+/*
+ * 基于时钟滴答的程序计数器采样。
+ *
+ * 时钟中断发生时，timer_interrupt把被中断代码的eip传给do_timer()，再由profile_tick()记录下来：
+ * 用户态的采样按profil()的约定累加到进程自己的计数缓冲区中；内核态的采样累加到kprof()分配的
+ * 内核计数器数组中，每个计数器覆盖内核代码的2^shift个字节。内核从线性地址0开始，所以计数器下标
+ * 左移shift位就是System.map中的地址。
+ *
+ * 用户缓冲区是在时钟中断中写的，不能引起缺页：这里自己查页表，页面不存在或不可写(还没有被写过
+ * 的共享页面)时就丢掉这次采样。
+ */
+#include <errno.h>			/* 错误号头文件。包含系统中各种出错号 */
+
+#include <linux/sched.h>	/* 调度程序头文件。定义了任务结构task_struct、任务0数据等 */
+#include <linux/kernel.h>	/* 内核头文件。含有一些内核常用函数的原型定义 */
+#include <linux/mm.h>		/* 内存管理头文件。含有页面大小定义和一些页面释放函数原型 */
+#include <asm/segment.h>	/* 段操作头文件。定义了有关段寄存器操作的嵌入式汇编函数 */
+#include <asm/system.h>		/* 系统头文件。定义了设置或修改描述符/中断门等的嵌入式汇编宏 */
+#include <sys/profile.h>	/* 采样接口头文件 */
+#include <string.h>			/* 字符串头文件。字符串或内存字节序列操作函数 */
+
+extern int etext;			/* 内核代码段结束处，由链接程序设置 */
+
+static unsigned long * prof_buffer = NULL;	/* 内核计数器数组，NULL表示没有在采样 */
+static unsigned long * prof_pages = NULL;	/* 计数器数组所在的页面，停止采样后仍保留 */
+static int prof_order = 0;					/* 计数器数组的页面阶数 */
+static unsigned long prof_shift = 0;		/* 计数器粒度 */
+static unsigned long prof_len = 0;			/* 计数器个数 */
+static unsigned long prof_samples = 0;		/* 内核态采样总数 */
+
+/*
+ * 把当前进程计数缓冲区中字节下标为idx的16位计数器加1。idx是偶数，缓冲区2字节对齐，所以计数器
+ * 不会跨页。直接在物理页面上累加，因此要自己设置页表项的脏位，否则页面换出时计数会丢失。页表
+ * 与子进程共享(目录项只读)或页面写时复制时不计数。
+ */
+static void profil_inc(unsigned long idx)
+{
+	unsigned long addr, * pte;
+
+	addr = get_base(current->ldt[2]) + current->prof_buf + idx;
+	pte = (unsigned long *) pg_dir[addr >> 22];
+	if (((unsigned long) pte & (PAGE_PRESENT | PAGE_RW)) != (PAGE_PRESENT | PAGE_RW)) {
+		return;
+	}
+	pte = (unsigned long *) ((unsigned long) pte & 0xfffff000) + ((addr >> 12) & 0x3ff);
+	if ((*pte & (PAGE_PRESENT | PAGE_RW)) != (PAGE_PRESENT | PAGE_RW)) {
+		return;
+	}
+	*pte |= PAGE_DIRTY;
+	(*(unsigned short *) ((*pte & 0xfffff000) + (addr & 0xfff)))++;
+}
+
+/**
+ * 记录一次采样
+ * 在do_timer()中调用，此时中断是关闭的。
+ * @param[in]	cpl		被中断代码的特权级
+ * @param[in]	eip		被中断代码的eip(用户态时是段内偏移)
+ * @retval		void
+ */
+void profile_tick(long cpl, unsigned long eip)
+{
+	unsigned long idx;
+
+	if (cpl) {
+		if (!current->prof_scale || eip < current->prof_offset) {
+			return;
+		}
+		idx = ((unsigned long long) (eip - current->prof_offset) *
+			current->prof_scale >> 16) & ~1UL;
+		if (idx + 2 <= current->prof_size) {
+			profil_inc(idx);
+		}
+	} else if (prof_buffer) {
+		idx = eip >> prof_shift;
+		if (idx >= prof_len) {
+			idx = prof_len - 1;
+		}
+		prof_buffer[idx]++;
+		prof_samples++;
+	}
+}
+
+/**
+ * 设置用户态采样
+ * 参数超过3个，buffer指向用户栈上的参数：buf、bufsiz、offset和scale。
+ * @param[in]	buffer	参数指针
+ * @retval		成功返回0，出错返回错误号
+ */
+int sys_prof(unsigned long * buffer)
+{
+	unsigned long buf, size, offset, scale;
+
+	buf = get_fs_long(buffer++);
+	size = get_fs_long(buffer++);
+	offset = get_fs_long(buffer++);
+	scale = get_fs_long(buffer);
+	if (scale <= 1) {
+		current->prof_scale = 0;
+		return 0;
+	}
+	if ((buf & 1) || buf + size < buf) {
+		return -EINVAL;
+	}
+	/* 先把缓冲区中的共享页面复制出来，这样大部分采样从一开始就能写进去 */
+	verify_area((void *) buf, size);
+	cli();
+	current->prof_buf = buf;
+	current->prof_size = size;
+	current->prof_offset = offset;
+	current->prof_scale = scale;
+	sti();
+	return 0;
+}
+
+/* 停止内核态采样。计数器数组保留，直到KPROF_FREE或以不同的粒度重新开始 */
+static void kprof_stop(void)
+{
+	cli();
+	prof_buffer = NULL;
+	sti();
+}
+
+/* 开始内核态采样，计数器清零 */
+static int kprof_start(unsigned long shift)
+{
+	unsigned long len;
+	int order;
+
+	if (shift < 2 || shift > 12) {
+		return -EINVAL;
+	}
+	len = (((unsigned long) &etext) >> shift) + 1;
+	if (!prof_pages || shift != prof_shift) {
+		for (order = 0; order < NR_MEM_LISTS && (PAGE_SIZE << order) < len * 4; order++)
+			/* nothing */ ;
+		if (order >= NR_MEM_LISTS) {
+			return -EINVAL;
+		}
+		kprof_stop();
+		if (prof_pages) {
+			free_pages((unsigned long) prof_pages, prof_order);
+			prof_pages = NULL;
+		}
+		if (!(prof_pages = (unsigned long *) __get_free_pages(order))) {
+			return -ENOMEM;
+		}
+		prof_order = order;
+	}
+	cli();
+	memset(prof_pages, 0, len * 4);
+	prof_shift = shift;
+	prof_len = len;
+	prof_samples = 0;
+	prof_buffer = prof_pages;
+	sti();
+	return 0;
+}
+
+/* 把采样结果复制到用户缓冲区，返回复制的字节数 */
+static int kprof_read(unsigned long * buf, int size)
+{
+	struct kprof_header hdr;
+	unsigned long * p;
+	int i, n;
+
+	if (!prof_pages) {
+		return -EINVAL;
+	}
+	n = sizeof(hdr) + prof_len * 4;
+	if (size < n) {
+		return -EINVAL;
+	}
+	verify_area(buf, n);
+	hdr.magic = KPROF_MAGIC;
+	hdr.shift = prof_shift;
+	hdr.nr_bins = prof_len;
+	hdr.samples = prof_samples;
+	for (p = (unsigned long *) &hdr, i = 0; i < sizeof(hdr) / 4; i++) {
+		put_fs_long(*p++, buf++);
+	}
+	for (p = prof_pages, i = 0; i < prof_len; i++) {
+		put_fs_long(*p++, buf++);
+	}
+	return n;
+}
+
+/**
+ * 内核态采样控制
+ * @param[in]	cmd		KPROF_START、KPROF_STOP、KPROF_READ或KPROF_FREE
+ * @param[in]	buf		KPROF_READ的用户缓冲区
+ * @param[in]	arg		KPROF_START的粒度，KPROF_READ的缓冲区字节数
+ * @retval		KPROF_READ返回读出的字节数，其他命令返回0，出错返回错误号
+ */
+int sys_kprof(int cmd, char * buf, int arg)
+{
+	if (!suser()) {
+		return -EPERM;
+	}
+	switch (cmd) {
+		case KPROF_START:
+			return kprof_start(arg);
+		case KPROF_STOP:
+			kprof_stop();
+			return 0;
+		case KPROF_READ:
+			return kprof_read((unsigned long *) buf, arg);
+		case KPROF_FREE:
+			kprof_stop();
+			if (prof_pages) {
+				free_pages((unsigned long) prof_pages, prof_order);
+				prof_pages = NULL;
+			}
+			return 0;
+	}
+	return -EINVAL;
+}
@@ -19,6 +19,7 @@
 #include <linux/sched.h>
 #include <linux/kernel.h>		/* 内核头文件。含有一些内核常用函数的原型定义 */
 #include <linux/sys.h>			/* 系统调用头文件。含有82个系统调用C函数程序，以'sys_'开头 */
+#include <linux/trace.h>		/* 事件跟踪头文件 */
 #include <linux/fdreg.h>		/* 软驱头文件。含有软盘控制器参数的一些定义 */
 #include <asm/system.h>			/* 系统头文件。定义了设置或修改描述符/中断门等的嵌入式汇编宏 */
 #include <asm/io.h>				/* io头文件。定义硬件端口输入/输出宏汇编语句 */
@@ -89,6 +90,7 @@ extern void mem_use(void);		/* 没有任何地方定义和引用该函数 */
 
 extern int timer_interrupt(void);	/* 定时中断程序（kernel/system_call.s）*/
 extern int system_call(void);		/* 系统调用中断程序（kernel/system_call.s） */
+extern void profile_tick(long cpl, unsigned long eip);	/* 记录eip采样（kernel/profile.c） */
 
 /*
  * 每个任务（进程）在内核态运行时都有自己的内核态堆栈。这里定义了任务的内核态堆栈结构。这里定义任务联合（任务结构成员和stack字符数组成员）。
@@ -190,80 +192,174 @@ void math_state_restore()
  * 任务0中的状态信息'state'是从来不用的。
  * 
  */
-void schedule(void)
+
+/*
+ * 就绪队列。原来的调度程序每次都扫描整个任务数组，选出counter最大的就绪任务；所有就绪任务的
+ * counter都为0时，再对所有任务(包括睡眠的)执行一遍counter = counter/2 + priority。这里保持同样
+ * 的选择规则，只是把就绪任务按counter挂在优先级数组的链表上：
+ *
+ * - 每个优先级数组有MAX_PRIO个循环双向链表，任务挂在第counter个链表上(counter大于MAX_PRIO-1的
+ *   都挂在最后一个)，bitmap中的位表示对应链表非空。选择下一个任务只需找bitmap中最高的置位。
+ * - 正在运行的任务不在队列中。它的counter会被do_timer()递减，直到它再次调用schedule()时才按新
+ *   的counter重新入队。counter已经用完的任务放入expired数组，active数组空了就交换两个数组，这
+ *   相当于原来的一次全体重新计算，用sched_epoch记录这样的周期数。
+ * - 放入expired数组的任务直接预先算好下一周期的counter(即priority)。睡眠的任务则在被唤醒入队时
+ *   按它错过的周期数补算counter，所以长时间睡眠的交互式任务醒来后的counter接近2*priority，会排
+ *   在计算密集的任务前面，与原来的行为相同。
+ *
+ * 队列可能在中断处理程序中被wake_up()修改，所以操作队列时要关中断。
+ */
+#define MAX_PRIO	64
+
+struct prio_array {
+	int nr_active;								/* 数组中的任务数 */
+	unsigned long bitmap[MAX_PRIO / 32];		/* 非空链表的位图 */
+	struct task_struct * queue[MAX_PRIO];		/* 各链表的头 */
+};
+
+static struct prio_array prio_arrays[2];
+static struct prio_array * active = prio_arrays;		/* 本周期还有时间片的任务 */
+static struct prio_array * expired = prio_arrays + 1;	/* 时间片已用完，等待下一周期的任务 */
+static unsigned long sched_epoch = 0;					/* 调度周期号 */
+
+/* 把任务p加到优先级数组array的第counter个链表尾 */
+static void enqueue_task(struct task_struct * p, struct prio_array * array)
 {
-	int i, next, c;
-	struct task_struct ** p;	/* 任务结构指针的指针 */
-
-/* check alarm, wake up any interruptible tasks that have got a signal */
-/* 检测alarm（进程的报警定时值），唤醒任何已得到信号的可中断任务 */
-/* 从任务数组中最后一个任务开始循环检测alarm。在循环时跳过空指针项 */
-	for(p = &LAST_TASK ; p > &FIRST_TASK ; --p)
-		if (*p) {
-			/* 如果设置过任务超时定时值timeout，并且已经超时，则复位超时定时值，并且如果任
-			 务处于可中断睡眠状态TASK_INTERRUPTIBLE下，将其置为就绪状态（TASK_RUNNING） */
-			if ((*p)->timeout && (*p)->timeout < jiffies) {
-				(*p)->timeout = 0;
-				if ((*p)->state == TASK_INTERRUPTIBLE) {
-					(*p)->state = TASK_RUNNING;
-				}
-			}
-			/* 如果设置过任务的SIGALRM信号超时定时器值alarm，并且已经过期(alarm<jiffies)，
-			 则在信号位图中置SIGALRM信号，即向任务发送SIGALRM信号。然后清alarm。该信号的默
-			 认操作是终止进程。jiffies是系统从开机开始算起的滴答数（10ms/滴答）（sched.h） */
-			if ((*p)->alarm && (*p)->alarm < jiffies) {
-				(*p)->signal |= (1 << (SIGALRM - 1));
-				(*p)->alarm = 0;
-			}
-			/* '~(_BLOCKABLE & (*p)->blocked)'用于忽略被阻塞的信号，除被阻塞的信号外还有其
-			 他信号，并且任务处于可中断状态，则置任务为就绪状态。SIGKILL和SIGSTOP不能被阻塞 */
-			if (((*p)->signal & ~(_BLOCKABLE & (*p)->blocked)) &&
-			(*p)->state == TASK_INTERRUPTIBLE) {
-				(*p)->state = TASK_RUNNING;		/* 置为就绪（可执行）状态 */
-			}
+	int prio = p->counter < MAX_PRIO ? p->counter : MAX_PRIO - 1;
+	struct task_struct ** head = array->queue + prio;
+
+	if (*head) {
+		p->run_next = *head;
+		p->run_prev = (*head)->run_prev;
+		p->run_prev->run_next = p;
+		(*head)->run_prev = p;
+	} else {
+		*head = p->run_next = p->run_prev = p;
+		array->bitmap[prio >> 5] |= 1UL << (prio & 31);
+	}
+	p->array = array;
+	p->rq_prio = prio;
+	array->nr_active++;
+}
+
+/* 把任务p从它所在的优先级数组中取下 */
+static void dequeue_task(struct task_struct * p)
+{
+	struct prio_array * array = p->array;
+	int prio = p->rq_prio;
+
+	if (p->run_next == p) {
+		array->queue[prio] = NULL;
+		array->bitmap[prio >> 5] &= ~(1UL << (prio & 31));
+	} else {
+		p->run_prev->run_next = p->run_next;
+		p->run_next->run_prev = p->run_prev;
+		if (array->queue[prio] == p) {
+			array->queue[prio] = p->run_next;
 		}
+	}
+	p->array = NULL;
+	array->nr_active--;
+}
 
-/* this is the scheduler proper: */
-/* 这里是调度程序的主要部分 */
+/*
+ * 把就绪任务p放入就绪队列。先补算它错过的周期的counter(移位32次以后旧值已全部移出，因此最多算32
+ * 次)，counter不为0就放入active数组，否则放入expired数组并预先算好下一周期的counter。
+ */
+static void activate_task(struct task_struct * p)
+{
+	unsigned long n = sched_epoch - p->sched_epoch;
 
-	while (1) {
-		c = -1;
-		next = 0;
-		i = NR_TASKS;
-		p = &task[NR_TASKS];
-		/* 这段代码也是从任务组的最后一个任务开始循环处理，并跳过不含任务的数组槽。它比较每个就绪状态任务的counter（任务运行时间的递减滴答计数）值，
-		 * 哪一个值大，就表示相应任务的运行时间还有很多，next就指向哪个任务号
+	if (n > 32) {
+		n = 32;
+	}
+	while (n--) {
+		p->counter = (p->counter >> 1) + p->priority;
+	}
+	if (p->counter > 0) {
+		p->sched_epoch = sched_epoch;
+		enqueue_task(p, active);
+	} else {
+		p->counter = p->priority;
+		p->sched_epoch = sched_epoch + 1;
+		enqueue_task(p, expired);
+	}
+}
+
+/* 找出优先级数组中最大的非空链表号。数组不能为空 */
+static inline int find_first_prio(struct prio_array * array)
+{
+	int i, bit;
+
+	for (i = MAX_PRIO / 32 - 1; !array->bitmap[i]; i--)
+		/* nothing */ ;
+	__asm__("bsrl %1,%0":"=r" (bit):"rm" (array->bitmap[i]));
+	return (i << 5) + bit;
+}
+
+void schedule(void)
+{
+	struct task_struct * next;
+	struct prio_array * array;
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (current != task[0]) {
+		/*
+		 * 当前任务将要可中断睡眠，但已经超时或者已收到未被屏蔽的信号，就不必再睡眠了。超时定时值还没
+		 * 到的话，按它设置任务的超时定时器。
 		 */
-		/* 找到就绪状态下时间片最大的任务，用next指向该任务 */
-		while (--i) {
-			if (!*--p) {
-				continue;
-			}
-			if ((*p)->state == TASK_RUNNING && (*p)->counter > c) {
-				c = (*p)->counter, next = i;
+		if (current->timeout && timeout_expired(current->timeout)) {
+			current->timeout = 0;
+			if (current->state == TASK_INTERRUPTIBLE) {
+				current->state = TASK_RUNNING;
 			}
 		}
-		/*
-		 * 如果比较得出有counter值不等于0的结果，或者系统中没有一个可运行的任务在（此时c仍然为-1，next=0），则退出外层while循环，并执行后面的任务切换操作。
-		 * 否则根据每个任务的优先权值，更新每一个任务的counter值，然后再回到重新比较。counter值的计算方式为counter=counter/2+priority，
-		 * 注意，这里计算过程不考虑进程的状态
-		 */
-		/* c = -1，没有可以运行的任务（此时next=0，会切去任务0）；c > 0，找到了可以切换的任务 */
-		if (c) {
-			break;
+		if (current->timeout && current->timeout != TIMEOUT_FOREVER &&
+		    (!timer_pending(&current->timeout_timer) ||
+		     current->timeout_timer.expires != current->timeout)) {
+			mod_timer(&current->timeout_timer, current->timeout);
 		}
-		/* 除任务0以外，存在处于就绪状态但时间片都为0的任务，则更新counter值，然后重新寻找 */
-		for(p = &LAST_TASK ; p > &FIRST_TASK ; --p) {
-			if (*p) {
-				(*p)->counter = ((*p)->counter >> 1) + (*p)->priority;
+		if ((current->signal & ~(_BLOCKABLE & current->blocked)) &&
+		    current->state == TASK_INTERRUPTIBLE) {
+			current->state = TASK_RUNNING;
+		}
+		/* 仍然就绪的当前任务按它现在的counter重新入队 */
+		if (current->state == TASK_RUNNING) {
+			activate_task(current);
+		}
+	}
+	/*
+	 * 从active数组中取counter最大的任务。active数组空了就与expired数组交换，开始新的周期；两个数
+	 * 组都空说明没有可运行的任务，切换到任务0。队列中的任务正常情况下都是就绪的，不是的话就丢掉。
+	 */
+	while (1) {
+		if (!active->nr_active) {
+			if (!expired->nr_active) {
+				next = task[0];
+				break;
 			}
+			array = active;
+			active = expired;
+			expired = array;
+			sched_epoch++;
+		}
+		next = active->queue[find_first_prio(active)];
+		dequeue_task(next);
+		if (next->state == TASK_RUNNING) {
+			break;
 		}
 	}
 	/*
-	 * 下面宏（在sched.h中）把上面选出来的任务next作为当前任务current，并切换到该任务中运行。因为next在前面被初始化为0，因此若系统中没有任何其他任务可运行时，
-	 * 则next始终未0。结果是调度函数会在系统空闲时去执行任务0。此时任务0仅执行pause()系统调用，并又会调用本函数
+	 * 切换时保持关中断，否则在切换之前唤醒当前任务的中断会因为它还是current而不把它放入队列。新任
+	 * 务从它自己上次调用switch_to()的地方继续执行，恢复它自己保存的标志寄存器。
 	 */
-	switch_to(next);		/* 切换到任务号为next的任务，并运行之 */
+	if (next != current) {
+		trace(TRACE_SWITCH, next->pid, current->state, 0);
+	}
+	switch_to(next->task_nr);		/* 切换到任务号为next的任务，并运行之 */
+	restore_flags(flags);
 }
 
 /**
@@ -319,7 +415,7 @@ repeat:	schedule();
 	 * 即要等待这些后续进入队列的任务被唤醒后才用wake_up()唤醒本任务。然后跳转至repeat标号处重新执行调度函数
 	 */
 	if (*p && *p != current) {
-		(**p).state = TASK_RUNNING;
+		wake_up_process(*p);
 		current->state = TASK_UNINTERRUPTIBLE;
 		goto repeat;
 	}
@@ -331,7 +427,7 @@ repeat:	schedule();
 		printk("Warning: *P = NULL\n\r");
 	}
 	if ((*p = tmp)) {
-		tmp->state = 0;
+		wake_up_process(tmp);
 	}
 }
 
@@ -361,6 +457,10 @@ void sleep_on(struct task_struct **p)
  */
 void wake_up(struct task_struct **p)
 {
+	/* 有epoll项登记在这个等待队列上时，即使没有进程在睡眠也要通知epoll(fs/eventpoll.c) */
+	if (ep_nr_hooks && p) {
+		ep_wakeup(p);
+	}
 	if (p && *p) {
 		if ((**p).state == TASK_STOPPED) {		/* 处于停止状态 */
 			printk("wake_up: TASK_STOPPED");
@@ -368,7 +468,54 @@ void wake_up(struct task_struct **p)
 		if ((**p).state == TASK_ZOMBIE) {		/* 处于僵死状态 */
 			printk("wake_up: TASK_ZOMBIE");
 		}
-		(**p).state = TASK_RUNNING;				/* 置为就绪状态TASK_RUNNING */
+		wake_up_process(*p);					/* 置为就绪状态TASK_RUNNING */
+	}
+}
+
+/**
+ * 唤醒任务
+ * 把任务置为就绪状态并放入就绪队列。正在运行的当前任务不在队列中，它在调用schedule()时才入队，
+ * 所以这里只改它的状态。可以在中断处理程序中调用。
+ * @param[in]	p		任务结构指针
+ * @retval		void
+ */
+void wake_up_process(struct task_struct * p)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	p->state = TASK_RUNNING;
+	if (p != current && p != task[0] && !p->array) {
+		activate_task(p);
+	}
+	restore_flags(flags);
+}
+
+/**
+ * 让新创建的任务第一次就绪
+ * 新任务的counter已经由fork设置为priority，从当前周期开始计算。
+ * @param[in]	p		新任务的任务结构指针
+ * @retval		void
+ */
+void wake_up_new_task(struct task_struct * p)
+{
+	p->array = NULL;
+	p->sched_epoch = sched_epoch;
+	wake_up_process(p);
+}
+
+/**
+ * 向任务发送信号之后调用
+ * 任务处于可中断睡眠状态且收到了未被屏蔽的信号，就唤醒它。
+ * @param[in]	p		任务结构指针
+ * @retval		void
+ */
+void signal_wake_up(struct task_struct * p)
+{
+	if ((p->signal & ~(_BLOCKABLE & p->blocked)) &&
+	    p->state == TASK_INTERRUPTIBLE) {
+		wake_up_process(p);
 	}
 }
 
@@ -381,16 +528,6 @@ void wake_up(struct task_struct **p)
  * 好了，从这里开始是一些有关软盘的子程序，本不应该放在内核的主要部分中的
  * 将它们放在这里是因为软驱需要定时处理，而放在这里是最方便的
  */
-/*
- * 下面代码用于处理软驱定时，在阅读这段代码之前请先看一下块设备中有关软盘驱动程序floppy.c后面说明，或者到阅读软盘块设备驱动程序时再来看这段代码
- *
- * 数组wait_motor[]用于存放等待马达启动到正常转速的进程指针。数组索引0-3分别对应软驱A-D
- * 数组mon_timer[]存放各软驱马达启动所需的滴答数。默认启动时间为50个滴答（0.5秒）
- * 数组moff_timer[]存放各软驱在马达停转之前需维持的时间。程序中设定为10000个滴答（100秒）
- */
-static struct task_struct * wait_motor[4] = {NULL, NULL, NULL, NULL};
-static int  mon_timer[4] = {0, 0, 0, 0};
-static int moff_timer[4] = {0, 0, 0, 0};
 /*
  * 下面变量对应软驱控制器中当前数字输出寄存器（DOR）。该寄存器每位的定义如下：
  * 位7-4：分别控制驱动器D-A马达的启动。1-启动；0-关闭
@@ -401,6 +538,43 @@ static int moff_timer[4] = {0, 0, 0, 0};
  */
 unsigned char current_DOR = 0x0C;
 
+/*
+ * 下面代码用于处理软驱定时，在阅读这段代码之前请先看一下块设备中有关软盘驱动程序floppy.c后面说明，或者到阅读软盘块设备驱动程序时再来看这段代码
+ *
+ * 数组wait_motor[]用于存放等待马达启动到正常转速的进程指针。数组索引0-3分别对应软驱A-D
+ * 定时器motor_on[]在马达启动到正常转速时(默认50个滴答，0.5秒)唤醒等待的进程
+ * 定时器motor_off[]到期时关闭马达。开启马达时设为10000个滴答（100秒），floppy_off()把它改为3秒
+ */
+static struct task_struct * wait_motor[4] = {NULL, NULL, NULL, NULL};
+
+static void motor_on_callback(unsigned long nr)
+{
+	wake_up(wait_motor + nr);
+}
+
+static void motor_off_callback(unsigned long nr)
+{
+	unsigned char mask = 0x10 << nr;
+
+	if (current_DOR & mask) {
+		current_DOR &= ~mask;
+		outb(current_DOR, FD_DOR);
+	}
+}
+
+static struct timer_list motor_on[4] = {
+	{ NULL, NULL, 0, 0, motor_on_callback },
+	{ NULL, NULL, 0, 1, motor_on_callback },
+	{ NULL, NULL, 0, 2, motor_on_callback },
+	{ NULL, NULL, 0, 3, motor_on_callback }
+};
+static struct timer_list motor_off[4] = {
+	{ NULL, NULL, 0, 0, motor_off_callback },
+	{ NULL, NULL, 0, 1, motor_off_callback },
+	{ NULL, NULL, 0, 2, motor_off_callback },
+	{ NULL, NULL, 0, 3, motor_off_callback }
+};
+
 /*
  * 指定软驱启动到正常运转状态所需等待时间
  * 参数nr-软驱号（0-3），返回值为滴答数
@@ -410,12 +584,13 @@ int ticks_to_floppy_on(unsigned int nr)
 {
 	extern unsigned char selected;
 	unsigned char mask = 0x10 << nr;
+	long ticks;
 
 	/* 系统最多4个软驱。首先预先设置好指定软驱nr停转之前需要经过的时间（100秒）。然后取当前数字输出寄存器DOR值到临时变量mask中，并把指定软驱的马达启动标志置位*/
 	if (nr>3) {
 		panic("floppy_on: nr>3");
 	}
-	moff_timer[nr] = 10000;		/* 100 s = very big :-) */ /* 停转维持时间 */
+	mod_timer(motor_off + nr, jiffies + 10000);		/* 100 s = very big :-) */ /* 停转维持时间 */
 	cli();				/* use floppy_off to turn it off */ /* 关中断 */
 	mask |= current_DOR;
 	/* 如果当前没有选择软驱，则首先复位其他软驱的选择位，然后置指定软驱选择位 */
@@ -425,25 +600,28 @@ int ticks_to_floppy_on(unsigned int nr)
 	}
 	/*
 	 * 如果数字输出寄存器DOR的当前值与要求值不同，则向FDC数字输出端口FD_DOR输出新值（mask），并且如果要求启动的马达还没有启动，则置响应软驱的马达启动定时器值（HZ/2=0.5秒
-	 * 或50个滴答）。若已经启动，则再设置启动定时为2个滴答，能满足下面do_floppy_timer()中线递减后判断的要求。此后更新当前数字输出寄存器current_DOR
+	 * 或50个滴答）。若已经启动，则至少再等2个滴答，让新选择的驱动器稳定。此后更新当前数字输出寄存器current_DOR
 	 * outb中的FD_DOR是软驱数字输出寄存器DOR的端口（0x3F2）
 	 */
 	if (mask != current_DOR) {
 		outb(mask, FD_DOR);
 		if ((mask ^ current_DOR) & 0xf0) {
-			mon_timer[nr] = HZ / 2;
-		} else if (mon_timer[nr] < 2) {
-			mon_timer[nr] = 2;
+			mod_timer(motor_on + nr, jiffies + HZ / 2);
+		} else if (!timer_pending(motor_on + nr) ||
+		           (long) (motor_on[nr].expires - jiffies) < 2) {
+			mod_timer(motor_on + nr, jiffies + 2);
 		}
 		current_DOR = mask;
 	}
+	/* 最后返回启动马达还需的时间值 */
+	ticks = timer_pending(motor_on + nr) ? (long) (motor_on[nr].expires - jiffies) : 0;
 	sti();		/* 开中断 */
-	return mon_timer[nr];  /* 最后返回启动马达所需的时间值 */
+	return ticks > 0 ? ticks : 0;
 }
 
 /*
  * 等待指定软驱马达启动所需的一段时间
- * 设置指定软驱的马达启动到正常转速所需的延时，然后睡眠等待。在定时中断过程中会一直递减判断这里设定的延时值。当延时到期，就会唤醒这里的等待进程 
+ * 设置指定软驱的马达启动到正常转速所需的延时，然后睡眠等待。定时器motor_on[nr]到期时唤醒这里的等待进程
  */
 void floppy_on(unsigned int nr)
 {
@@ -458,91 +636,223 @@ void floppy_on(unsigned int nr)
 /* 设置关闭相应软驱马达停转定时器（3秒）。若不使用该函数明确关闭指定的软驱马达，则在马达开启100秒之后也会被关闭 */
 void floppy_off(unsigned int nr)
 {
-	moff_timer[nr] = 3 * HZ;
+	mod_timer(motor_off + nr, jiffies + 3 * HZ);
 }
 
 /*
- * 软盘定时器处理子程序。更新马达启动定时值和马达关闭停转计时值。该子程序会在时钟定时中断过程中被调用，因此系统每经过一个滴答（10ms）就会被调用一次，
- * 随时更新马达开启或停转定时器的值。如果某一个马达停转定时到，则将数字输出寄存器马达启动位复位
+ * 下面是内核定时器，采用分级时间轮。tv1有256个槽，按到期时刻的低8位挂入将在256个滴答内到期的定
+ * 时器；tvn[0]~tvn[3]各有64个槽，依次容纳更远的定时器，每级按到期时刻中更高的6位选槽。tv1每转完
+ * 一圈，就把tvn[0]中下一个槽的定时器按剩余时间重新分配到tv1中，tvn[0]转完一圈时再从tvn[1]中分
+ * 配，依此类推。这样添加和删除定时器都是O(1)的，每个滴答也只需处理tv1中的一个槽。
+ */
+#define TVN_BITS	6
+#define TVR_BITS	8
+#define TVN_SIZE	(1 << TVN_BITS)
+#define TVR_SIZE	(1 << TVR_BITS)
+#define TVN_MASK	(TVN_SIZE - 1)
+#define TVR_MASK	(TVR_SIZE - 1)
+
+static struct timer_list * tv1[TVR_SIZE];
+static struct timer_list * tvn[4][TVN_SIZE];
+static unsigned long timer_jiffies = 0;		/* 下一个要处理的滴答 */
+
+/*
+ * 到期时刻早于timer_jiffies不超过MAX_TIMER_LAG个滴答的定时器视为已经到期，更早的实际上是很久以后
+ * 的时刻(例如jiffies加上一个很大的值)，与其他远期定时器一样挂到最后一级
  */
-void do_floppy_timer(void)
+#define MAX_TIMER_LAG	(1L << 30)
+
+/* 第n级tvn中与timer_jiffies对应的槽号 */
+#define INDEX(n) ((timer_jiffies >> (TVR_BITS + (n) * TVN_BITS)) & TVN_MASK)
+
+/* 按到期时刻把定时器挂到时间轮的相应槽中。调用时已关中断 */
+static void internal_add_timer(struct timer_list * timer)
 {
-	int i;
-	unsigned char mask = 0x10;
-
-	/* 针对系统中具有的4个软驱，逐一检查使用中的软驱。如果不是DOR指定的马达，则跳过。如果马达启动定时到则唤醒相应进程。如果马达停转定时到，则复位DOR中相应马达启动位 */
-	for (i=0 ; i<4 ; i++,mask <<= 1) {
-		if (!(mask & current_DOR))		/* 如果不是DOR指定的马达则跳过 */
-			continue;
-		if (mon_timer[i]) {				/* 如果马达启动定时到则唤醒进程 */
-			if (!--mon_timer[i]) {
-				wake_up(i+wait_motor);
-			}
-		} else if (!moff_timer[i]) {	/* 如果马达停转定时到则复位相应马达启动位，并且更新数字输出寄存器 */
-			current_DOR &= ~mask;
-			outb(current_DOR, FD_DOR);
-		} else {
-			moff_timer[i] --;			/* 否则马达停转计时递减 */
-		}
+	unsigned long expires = timer->expires;
+	unsigned long idx = expires - timer_jiffies;
+	struct timer_list ** vec;
+
+	if ((long) idx < 0 && (long) idx >= -MAX_TIMER_LAG) {
+		vec = tv1 + (timer_jiffies & TVR_MASK);		/* 已经到期的在下一个滴答处理 */
+	} else if (idx < TVR_SIZE) {
+		vec = tv1 + (expires & TVR_MASK);
+	} else if (idx < 1 << (TVR_BITS + TVN_BITS)) {
+		vec = tvn[0] + ((expires >> TVR_BITS) & TVN_MASK);
+	} else if (idx < 1 << (TVR_BITS + 2 * TVN_BITS)) {
+		vec = tvn[1] + ((expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK);
+	} else if (idx < 1 << (TVR_BITS + 3 * TVN_BITS)) {
+		vec = tvn[2] + ((expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK);
+	} else {
+		vec = tvn[3] + ((expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK);
+	}
+	if ((timer->next = *vec)) {
+		timer->next->pprev = &timer->next;
 	}
+	*vec = timer;
+	timer->pprev = vec;
 }
 
-/* 下面是关于内核定时器的代码。最多可有64个定时器 */
-#define TIME_REQUESTS 64
+/* 把定时器从时间轮上取下。调用时已关中断 */
+static inline void detach_timer(struct timer_list * timer)
+{
+	if (timer->next) {
+		timer->next->pprev = timer->pprev;
+	}
+	*timer->pprev = timer->next;
+	timer->next = NULL;
+	timer->pprev = NULL;
+}
 
-/*
- * 定时器链表结构和定时器数组。该定时器链表专用于供软驱关闭马达和启动马达定时操作。这种类型定时器类似现代Linux系统中的动态定时器（Dynamic Timer）。仅供内核使用
+/**
+ * 添加定时器
+ * 调用前要设置好expires、data和function，定时器不能已经被添加。
+ * @param[in]	timer	定时器
+ * @retval		void
  */
-static struct timer_list {
-	long jiffies;									/* 定时滴答数 */
-	void (*fn)();									/* 定时处理程序 */
-	struct timer_list * next;						/* 链接指向下一个定时器 */
-} timer_list[TIME_REQUESTS], * next_timer = NULL;	/* next_timer是定时器队列头指针 */
+void add_timer(struct timer_list * timer)
+{
+	unsigned long flags;
 
-/*
- * 添加定时器。输入参数为指定的定时值（滴答数）和相应的处理程序指针。软盘驱动程序（floppy.c）利用该函数执行启动或关闭马达的延时操作。
- * 参数jiffies-以10毫秒计的滴答数；*fn()-定时时间到时执行的函数
+	save_flags(flags);
+	cli();
+	if (timer->pprev) {
+		printk("add_timer: timer already added\n\r");
+	} else {
+		internal_add_timer(timer);
+	}
+	restore_flags(flags);
+}
+
+/**
+ * 删除定时器
+ * @param[in]	timer	定时器
+ * @retval		定时器原来已添加返回1，否则返回0
  */
-void add_timer(long jiffies, void (*fn)(void))
+int del_timer(struct timer_list * timer)
 {
-	struct timer_list * p;
+	unsigned long flags;
+	int ret = 0;
 
-	/* 如果定时处理程序指针为空，则退出。否则关中断 */
-	if (!fn) {
-		return;
+	save_flags(flags);
+	cli();
+	if (timer->pprev) {
+		detach_timer(timer);
+		ret = 1;
 	}
+	restore_flags(flags);
+	return ret;
+}
+
+/**
+ * 修改定时器的到期时刻
+ * 定时器没有添加时就添加它。
+ * @param[in]	timer	定时器
+ * @param[in]	expires	新的到期时刻
+ * @retval		void
+ */
+void mod_timer(struct timer_list * timer, unsigned long expires)
+{
+	unsigned long flags;
+
+	save_flags(flags);
 	cli();
-	/* 如果定时值<=0，则立刻调用其处理程序。并且该定时器不加入链表中 */
-	if (jiffies <= 0) {
-		(fn)();
-	} else {
-	/* 否则从定时器数组中，找一个空闲项 */
-		for (p = timer_list ; p < timer_list + TIME_REQUESTS ; p++) {
-			if (!p->fn) {
-				break;
-			}
+	if (timer->pprev) {
+		detach_timer(timer);
+	}
+	timer->expires = expires;
+	internal_add_timer(timer);
+	restore_flags(flags);
+}
+
+/* 把第n级tvn中槽index的定时器重新分配到低一级中，返回index */
+static int cascade(int n, int index)
+{
+	struct timer_list * timer, * next;
+
+	timer = tvn[n][index];
+	tvn[n][index] = NULL;
+	while (timer) {
+		next = timer->next;
+		internal_add_timer(timer);
+		timer = next;
+	}
+	return index;
+}
+
+/*
+ * 处理到期的定时器，在时钟中断中被do_timer()调用(此时中断是关闭的)。先把当前槽的链表整个取下并
+ * 推进timer_jiffies，这样处理函数中重新添加的已到期定时器会放到下一个槽，不会在这里循环。
+ */
+static void run_timers(void)
+{
+	struct timer_list * work, * timer;
+	void (*fn)(unsigned long);
+	int index;
+
+	while ((long) (jiffies - timer_jiffies) >= 0) {
+		index = timer_jiffies & TVR_MASK;
+		if (!index && !cascade(0, INDEX(0)) && !cascade(1, INDEX(1)) &&
+		    !cascade(2, INDEX(2))) {
+			cascade(3, INDEX(3));
 		}
-		/* 如果已经用完了定时器数组，则系统崩溃。否则向定时器数据结构填入相应信息，并链入链表头 */
-		if (p >= timer_list + TIME_REQUESTS) {
-			panic("No more time requests free");
+		if ((work = tv1[index])) {
+			work->pprev = &work;
 		}
-		p->fn = fn;
-		p->jiffies = jiffies;
-		p->next = next_timer;
-		next_timer = p;
-		/* 链表项按定时值从小到大排序。在排序时减去排在前面需要的滴答数，这样在处理定时器时只要查看链表头的第一项的定时是否到期即可 */
-		while (p->next && p->next->jiffies < p->jiffies) {
-			p->jiffies -= p->next->jiffies;
-			fn = p->fn;
-			p->fn = p->next->fn;
-			p->next->fn = fn;
-			jiffies = p->jiffies;
-			p->jiffies = p->next->jiffies;
-			p->next->jiffies = jiffies;
-			p = p->next;
+		tv1[index] = NULL;
+		timer_jiffies++;
+		while ((timer = work)) {
+			fn = timer->function;
+			detach_timer(timer);
+			fn(timer->data);
 		}
 	}
-	sti();
+}
+
+/*
+ * 进程的超时定时值timeout和报警定时值alarm各用任务结构中的一个定时器实现。timeout由各处直接赋值，
+ * 调用schedule()时才按它设置定时器，定时器到期时若timeout没有被推迟就清零它并唤醒可中断睡眠的任
+ * 务；alarm由sys_alarm()设置，到期时向任务发送SIGALRM信号。
+ */
+static void process_timeout(unsigned long data)
+{
+	struct task_struct * p = (struct task_struct *) data;
+
+	if (!p->timeout || p->timeout == TIMEOUT_FOREVER) {
+		return;
+	}
+	if (!timeout_expired(p->timeout)) {
+		mod_timer(&p->timeout_timer, p->timeout);
+		return;
+	}
+	p->timeout = 0;
+	if (p->state == TASK_INTERRUPTIBLE) {
+		wake_up_process(p);
+	}
+}
+
+static void it_real_fn(unsigned long data)
+{
+	struct task_struct * p = (struct task_struct *) data;
+
+	p->signal |= (1 << (SIGALRM - 1));
+	p->alarm = 0;
+	signal_wake_up(p);
+}
+
+/**
+ * 初始化任务结构中的定时器
+ * 新任务的任务结构复制自其他任务，在fork中调用本函数使定时器处于未添加状态。
+ * @param[in]	p		任务结构指针
+ * @retval		void
+ */
+void init_task_timers(struct task_struct * p)
+{
+	init_timer(&p->timeout_timer);
+	p->timeout_timer.data = (unsigned long) p;
+	p->timeout_timer.function = process_timeout;
+	init_timer(&p->real_timer);
+	p->real_timer.data = (unsigned long) p;
+	p->real_timer.function = it_real_fn;
 }
 
 /*
@@ -555,9 +865,10 @@ void add_timer(long jiffies, void (*fn)(void))
  * 对于一个进程由于执行时间片用完时，则进行任务切换，并执行一个计时更新工作。在sys_call.s中
  * 的timer_interrupt被调用。
  * @param[in]	cpl		当前特权级，是时钟中断发生时正被执行的代码选择符中的特权级
+ * @param[in]	eip		时钟中断发生时正被执行的代码的eip
  * @retval		void
  */
-void do_timer(long cpl)
+void do_timer(long cpl, unsigned long eip)
 {
 	static int blanked = 0;
 
@@ -595,22 +906,9 @@ void do_timer(long cpl)
 	} else {
 		current->stime++;
 	}
-	/* 如果有定时器存在，则将链表第1个定时器的值减1，如果已经等于0，则调用相应的处理程序，并将该处理程序指针置为空。然后去掉该项定时器 */
-	if (next_timer) {	/* 定时器链表的头指针 */
-		next_timer->jiffies--;
-		while (next_timer && next_timer->jiffies <= 0) {
-			void (*fn)(void);		/* 这里插入了一个函数指针定义 */
-			
-			fn = next_timer->fn;
-			next_timer->fn = NULL;
-			next_timer = next_timer->next;
-			(fn)();					/* 调用定时处理函数 */
-		}
-	}
-	/* 如果当前软盘控制器FDC的数字输出寄存器DOR中马达启动位有置位的，则执行软盘定时程序 */
-	if (current_DOR & 0xf0) {
-		do_floppy_timer();
-	}
+	profile_tick(cpl, eip);
+	/* 处理到期的定时器 */
+	run_timers();
 	/*
 	 * 如果任务运行时间还没有用完，则退出这里继续运行该任务。否则置当前任务运行计数值为0.并且若发生时钟中断时正在内核代码中运行则返回
 	 * 否则表示在执行用户程序，于是调用函数尝试执行任务切换操作 
@@ -645,6 +943,11 @@ int sys_alarm(long seconds)
 		old = (old - jiffies) / HZ;
 	}
 	current->alarm = (seconds > 0) ? (jiffies + HZ * seconds) : 0;
+	if (current->alarm) {
+		mod_timer(&current->real_timer, current->alarm);
+	} else {
+		del_timer(&current->real_timer);
+	}
 	return (old);
 }
 
@@ -716,6 +1019,7 @@ void sched_init(void)
 	 * 定义在include/linux/sched.h中；gdt是一个描述符表数组（include/linux/head.h），实际上对应程序head.s中的全局描述符表基址（gdt）。因此
 	 * gdt+FIRST_TSS_ENTRY即为gdt[FIRST_TSS_ENTRY]（即是gdt[4]），也即gdt数组第4项的地址。（include/asm/system.h）
 	 */
+	init_task_timers(&init_task.task);
 	set_tss_desc(gdt+FIRST_TSS_ENTRY, &(init_task.task.tss));
 	set_ldt_desc(gdt+FIRST_LDT_ENTRY, &(init_task.task.ldt));
 	/* 清任务数组和描述符表现（注意从i=1开始，所以初始任务的描述符还在）。描述符项结构定义在文件include/linux/head.h中 */
@@ -727,6 +1031,7 @@ void sched_init(void)
 		p->a = p->b = 0;
 		p++;
 	}
+	pid_init();						/* 空闲任务槽栈 */
 /* Clear NT, so that we won't have troubles with that later on */
 /* 清楚标志寄存器中的位NT，这样以后就不会有麻烦 */
 /* EFLAGS中的NT标志位用于控制任务的嵌套调用。当NT位置位时，那么当前中断任务执行IRET指令时就会引起任务切换。NT指出TSS中的back_link字段是否有效。NT=0时无效*/
@@ -0,0 +1,151 @@
+/*
+ *  linux/kernel/scstat.c
+ */
+
+/*
+ * 按系统调用号统计系统调用的开销。
+ *
+ * sc_account不为0时，system_call在调用C处理函数之前把时间戳保存在current->sc_start中，返回后
+ * 调用syscall_account()累加统计。sc_account为0时system_call只多一次比较。任务结构中没有地方
+ * 放下整个统计表，所以进程的统计表另占一页内存，在该进程第一次被统计时分配，fork()出的子进程
+ * 从零开始统计，进程被释放时一起释放。
+ */
+#include <errno.h>			/* 错误号头文件。包含系统中各种出错号 */
+
+#include <linux/sched.h>	/* 调度程序头文件。定义了任务结构task_struct、任务0数据等 */
+#include <linux/kernel.h>	/* 内核头文件。含有一些内核常用函数的原型定义 */
+#include <linux/mm.h>		/* 内存管理头文件。含有页面大小定义和一些页面释放函数原型 */
+#include <asm/segment.h>	/* 段操作头文件。定义了有关段寄存器操作的嵌入式汇编函数 */
+#include <asm/system.h>		/* 系统头文件。定义了设置或修改描述符/中断门等的嵌入式汇编宏 */
+#include <sys/scstat.h>		/* 系统调用统计头文件 */
+#include <string.h>			/* 字符串头文件。字符串或内存字节序列操作函数 */
+
+int sc_account = 0;							/* 是否在统计，system_call中使用 */
+
+static struct sc_stat sc_total[NR_SCSTAT];	/* 全系统的统计表 */
+
+/* 把一次调用累加到统计项s中 */
+static inline void sc_add(struct sc_stat * s, unsigned long long cycles, long ret)
+{
+	unsigned long long total;
+
+	s->count++;
+	if (ret < 0) {
+		s->errors++;
+	}
+	total = ((unsigned long long) s->cycles_hi << 32 | s->cycles_lo) + cycles;
+	s->cycles_lo = total;
+	s->cycles_hi = total >> 32;
+	if (cycles > 0xffffffffULL) {
+		s->max = 0xffffffff;
+	} else if (cycles > s->max) {
+		s->max = cycles;
+	}
+}
+
+/**
+ * 统计一次系统调用
+ * 统计打开时由system_call在C处理函数返回后调用。
+ * @param[in]	ret		系统调用的返回值
+ * @param[in]	nr		系统调用号
+ * @retval		void
+ */
+void syscall_account(long ret, unsigned long nr)
+{
+	unsigned long lo, hi;
+	unsigned long long cycles;
+
+	rdtsc(lo, hi);
+	if (nr >= NR_SCSTAT) {
+		return;
+	}
+	cycles = ((unsigned long long) hi << 32 | lo) -
+		((unsigned long long) current->sc_start[1] << 32 | current->sc_start[0]);
+	sc_add(sc_total + nr, cycles, ret);
+	if (!current->sc_stats &&
+	    !(current->sc_stats = (struct sc_stat *) get_free_page())) {
+		return;
+	}
+	sc_add(current->sc_stats + nr, cycles, ret);
+}
+
+/**
+ * 释放进程的统计表
+ * 在release()中调用。
+ * @param[in]	p		任务结构指针
+ * @retval		void
+ */
+void scstat_release(struct task_struct * p)
+{
+	if (p->sc_stats) {
+		free_page((unsigned long) p->sc_stats);
+		p->sc_stats = NULL;
+	}
+}
+
+/* 统计表清零 */
+static void scstat_reset(void)
+{
+	struct task_struct ** p;
+
+	memset(sc_total, 0, sizeof(sc_total));
+	for (p = &FIRST_TASK; p <= &LAST_TASK; p++) {
+		if (*p && (*p)->sc_stats) {
+			memset((*p)->sc_stats, 0, NR_SCSTAT * sizeof(struct sc_stat));
+		}
+	}
+}
+
+/* 把统计表s复制到用户缓冲区buf */
+static int scstat_read(struct sc_stat * s, struct sc_stat * buf)
+{
+	unsigned long * from = (unsigned long *) s;
+	unsigned long * to = (unsigned long *) buf;
+	int i;
+
+	verify_area(buf, NR_SCSTAT * sizeof(struct sc_stat));
+	for (i = 0; i < NR_SCSTAT * sizeof(struct sc_stat) / 4; i++) {
+		put_fs_long(*from++, to++);
+	}
+	return NR_SCSTAT;
+}
+
+/**
+ * 系统调用统计控制
+ * @param[in]	cmd		SCSTAT_ON、SCSTAT_OFF、SCSTAT_RESET或SCSTAT_READ
+ * @param[in]	pid		SCSTAT_READ读取的进程，0表示全系统
+ * @param[in]	buf		SCSTAT_READ的用户缓冲区
+ * @retval		SCSTAT_READ返回读出的项数，其他命令返回0，出错返回错误号
+ */
+int sys_scstat(int cmd, int pid, struct sc_stat * buf)
+{
+	struct task_struct * p;
+
+	if (cmd == SCSTAT_READ) {
+		if (!pid) {
+			return scstat_read(sc_total, buf);
+		}
+		if (!(p = find_task_by_pid(pid))) {
+			return -ESRCH;
+		}
+		return p->sc_stats ? scstat_read(p->sc_stats, buf) : 0;
+	}
+	if (!suser()) {
+		return -EPERM;
+	}
+	switch (cmd) {
+		case SCSTAT_ON:
+			if (!cpu_has_tsc()) {
+				return -EINVAL;
+			}
+			sc_account = 1;
+			return 0;
+		case SCSTAT_OFF:
+			sc_account = 0;
+			return 0;
+		case SCSTAT_RESET:
+			scstat_reset();
+			return 0;
+	}
+	return -EINVAL;
+}
@@ -248,8 +248,10 @@ int do_signal(long signr,long eax,long ebx, long ecx, long edx, long orig_eax,
 			current->state = TASK_STOPPED;
 			current->exit_code = signr;
 			if (!(current->p_pptr->sigaction[SIGCHLD-1].sa_flags & 
-					SA_NOCLDSTOP))
+					SA_NOCLDSTOP)) {
 				current->p_pptr->signal |= (1<<(SIGCHLD-1));
+				signal_wake_up(current->p_pptr);
+			}
 			return(1);  /* Reschedule another event */
 		/*
 		 * 如果信号时一下6种信号之一，那么若信号产生了core dump，则以退出码为signr|0x80调用do_exit()退出。否则退出码就是信号值。do_exit()的参数
@@ -63,11 +63,6 @@ int sys_rename()
 	return -ENOSYS;
 }
 
-int sys_prof()
-{
-	return -ENOSYS;
-}
-
 /*
  * This is done BSD-style, with no consideration of the saved gid, except
  * that if you set the effective gid, it sets the saved gid too.  This 
@@ -323,7 +318,7 @@ int sys_brk(unsigned long end_data_seg)
  */
 int sys_setpgid(int pid, int pgid)
 {
-	int i; 
+	struct task_struct * p;
 
 	/*
 	 * 如果参数pid为0，则pid取值为当前进程的进程号pid。如果参数pgid为0，则pgid也取值为当前进程的pid。【这里与POSIX标准的描述有出入】
@@ -336,23 +331,22 @@ int sys_setpgid(int pid, int pgid)
 	if (pgid < 0)
 		return -EINVAL;
 	/*
-	 * 扫描任务数组，查找指定进程号pid的任务。如果找到了进程号是pid的进程，并且该进程的父进程就是当前进程或者该进程就是当前进程，那么若该任务已经
+	 * 在pid hash表中查找指定进程号pid的任务。如果找到了进程号是pid的进程，并且该进程的父进程就是当前进程或者该进程就是当前进程，那么若该任务已经
 	 * 是会话首领，则出错返回。若该任务的会话号（session）与当前进程的不同，或者指定的进程组号pgid与pid不同并且pgid进程组号所属会话号与当前进程所属
 	 * 会话号不同，则也出错返回。否则把查找到的进程的pgrp设置为pgid，并返回0，若没有找到指定pid的进程，则返回进程不存在的出错码
 	 */
-	for (i=0 ; i<NR_TASKS ; i++)
-		if (task[i] && (task[i]->pid == pid) &&
-		    ((task[i]->p_pptr == current) || 
-		     (task[i] == current))) {
-			if (task[i]->leader)
-				return -EPERM;
-			if ((task[i]->session != current->session) ||
-			    ((pgid != pid) && 
-			     (session_of_pgrp(pgid) != current->session)))
-				return -EPERM;
-			task[i]->pgrp = pgid;
-			return 0;
-		}
+	if ((p = find_task_by_pid(pid)) &&
+	    ((p->p_pptr == current) || 
+	     (p == current))) {
+		if (p->leader)
+			return -EPERM;
+		if ((p->session != current->session) ||
+		    ((pgid != pid) && 
+		     (session_of_pgrp(pgid) != current->session)))
+			return -EPERM;
+		set_pgrp(p, pgid);
+		return 0;
+	}
 	return -ESRCH;
 }
 
@@ -372,7 +366,8 @@ int sys_setsid(void)
 	if (current->leader && !suser())
 		return -EPERM;
 	current->leader = 1;
-	current->session = current->pgrp = current->pid;
+	set_session(current, current->pid);
+	set_pgrp(current, current->pid);
 	current->tty = -1;			/* 表示当前进程没有控制终端 */
 	return current->pgrp;
 }
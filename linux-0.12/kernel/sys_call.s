@@ -86,6 +86,7 @@ priority = 8	# 运行优先数。任务开始运行时counter=priority，越大
 signal	= 12	# 信号位图，每个比特位代表一种信号，信号值=位偏移值+1
 sigaction = 16		# MUST be 16 (=len of sigaction)	# sigaction结构长度必须是16字节
 blocked = (33*16)	# 受阻塞信号位图的偏移值
+sc_start = (33*16+4)	# 系统调用开始时的时间戳（kernel/scstat.c）
 
 # 以下是定义sigaction结构中各字段的偏移值（include/signal.h）
 # offsets within sigaction
@@ -121,6 +122,23 @@ reschedule:
 	pushl $ret_from_sys_call	# 将ret_from_sys_call的地址入栈
 	jmp schedule
 
+# 统计开销的系统调用路径。ebx、ecx和edx已经入栈，返回时从栈中恢复，这里可以随意使用。开始时的时间戳
+# 保存在任务结构中而不是栈上，使C处理函数看到的栈与正常路径完全相同（sys_fork和sys_execve依赖它）
+.align 4
+account_sys_call:
+	movl %eax,%ecx
+	rdtsc
+	movl current,%ebx
+	movl %eax,sc_start(%ebx)
+	movl %edx,sc_start+4(%ebx)
+	call *sys_call_table(,%ecx,4)
+	pushl %eax						# 系统调用返回值，与正常路径相同
+	pushl ORIG_EAX(%esp)			# syscall_account(返回值, 调用号)
+	pushl %eax
+	call syscall_account
+	addl $8,%esp
+	jmp 2f
+
 # int0x80 -- linux系统调用入口点（调用中断int0x80，eax中是调用号）
 .align 4
 system_call:
@@ -142,6 +160,8 @@ system_call:
 	mov %dx,%fs
 	cmpl NR_syscalls,%eax	# 调用号如果超出范围的话就跳转
 	jae bad_sys_call
+	cmpl $0,sc_account		# 正在统计系统调用开销时走account_sys_call
+	jne account_sys_call
 	# 下面这句操作数的含义是：调用地址=[sys_call_table + %eax * 4]
 	# sys_call_table[]是一个指针数组，定义在include/linux/sys.h中，该数组中设置了内核所有82个系统调用C处理函数的地址
 	call *sys_call_table(,%eax,4)	# 间接调用指定功能C函数
@@ -256,7 +276,7 @@ device_not_available:
 	ret					# 这里的ret将跳转到ret_from_sys_call
 
 # int32 -- （int 0x20）时钟中断处理程序。中断频率设置为100Hz（include/linux/sched.h），定时芯片8253/8254是在（kernel/sched.c）初始化的。因此这里
-# jiffies每10毫秒加1.这段代码将jiffies增1，发送结束中断指令给8259控制器，然后用当前特权级作为参数调用C函数do_timer(long CPL)。当调用返回时转去检测并处理信号
+# jiffies每10毫秒加1.这段代码将jiffies增1，发送结束中断指令给8259控制器，然后用当前特权级和eip作为参数调用C函数do_timer(long CPL, unsigned long EIP)。当调用返回时转去检测并处理信号
 .align 4
 timer_interrupt:
 	push %ds		# save ds,es and put kernel data space
@@ -278,11 +298,13 @@ timer_interrupt:
 	movb $0x20,%al		# EOI to interrupt controller #1
 	outb %al,$0x20
 	# 下面从堆栈中取出执行系统调用代码的选择符（CS段寄存器值）中的当前特权级别（0或3）并压入堆栈，作为do_timer的参数。do_timer()函数执行任务切换、计时等工作（kernel/sched.c中实现）
-	movl CS(%esp),%eax
+	# 被中断代码的eip作为第2个参数，供采样使用（kernel/profile.c）
+	pushl EIP(%esp)
+	movl CS+4(%esp),%eax
 	andl $3,%eax		# %eax is CPL (0 or 3, 0=supervisor)
 	pushl %eax
 	call do_timer		# 'do_timer(long CPL)' does everything from
-	addl $4,%esp		# task switching to accounting ...
+	addl $8,%esp		# task switching to accounting ...
 	jmp ret_from_sys_call
 
 # 这是sys_execve()系统调用。取中断调用程序的代码指针作为参数调用C函数do_execve()，do_execve()在fs/exec.c中
@@ -0,0 +1,125 @@
+/*
+ *  linux/kernel/trace.c
+ */
+
+/*
+ * 内核事件跟踪的环形缓冲区。
+ *
+ * 跟踪点可能在中断处理程序中执行(例如end_request())，所以写记录和读出记录时都要关中断。记录按
+ * 序号存放在第seq % TRACE_EVENTS项，trace_head是下一条记录的序号，trace_tail是下一条要读出
+ * 的记录的序号。读者跟不上时trace_tail被推到最早仍在缓冲区中的记录。
+ */
+#include <errno.h>			/* 错误号头文件。包含系统中各种出错号 */
+
+#include <linux/sched.h>	/* 调度程序头文件。定义了任务结构task_struct、任务0数据等 */
+#include <linux/kernel.h>	/* 内核头文件。含有一些内核常用函数的原型定义 */
+#include <linux/mm.h>		/* 内存管理头文件。含有页面大小定义和一些页面释放函数原型 */
+#include <linux/trace.h>	/* 事件跟踪头文件 */
+#include <asm/segment.h>	/* 段操作头文件。定义了有关段寄存器操作的嵌入式汇编函数 */
+#include <asm/system.h>		/* 系统头文件。定义了设置或修改描述符/中断门等的嵌入式汇编宏 */
+
+#define TRACE_ORDER		3											/* 缓冲区占2^3页 */
+#define TRACE_EVENTS	((PAGE_SIZE << TRACE_ORDER) / sizeof(struct trace_event))
+
+unsigned long trace_mask = 0;				/* 打开的事件位图 */
+
+static struct trace_event * trace_buf = NULL;
+static unsigned long trace_head = 0;
+static unsigned long trace_tail = 0;
+static int has_tsc = 0;
+
+/**
+ * 记录一个事件
+ * 由trace()在事件打开时调用。
+ * @param[in]	type	事件类型
+ * @param[in]	a0,a1,a2	事件参数
+ * @retval		void
+ */
+void do_trace(int type, unsigned long a0, unsigned long a1, unsigned long a2)
+{
+	struct trace_event * e;
+	unsigned long flags;
+
+	if (!trace_buf) {
+		return;
+	}
+	save_flags(flags);
+	cli();
+	e = trace_buf + trace_head % TRACE_EVENTS;
+	e->seq = trace_head++;
+	if (trace_head - trace_tail > TRACE_EVENTS) {
+		trace_tail = trace_head - TRACE_EVENTS;
+	}
+	if (has_tsc) {
+		rdtsc(e->tsc_lo, e->tsc_hi);
+	} else {
+		e->tsc_lo = e->tsc_hi = 0;
+	}
+	e->jiffies = jiffies;
+	e->type = type;
+	e->pid = current->pid;
+	e->arg[0] = a0;
+	e->arg[1] = a1;
+	e->arg[2] = a2;
+	restore_flags(flags);
+}
+
+/**
+ * 读出跟踪记录(/dev/trace)
+ * 只读出整条记录，没有记录时立即返回0。
+ * @param[in]	buf		用户缓冲区
+ * @param[in]	count	缓冲区字节数
+ * @retval		读出的字节数
+ */
+int trace_read(char * buf, int count)
+{
+	struct trace_event e;
+	unsigned long * p;
+	int i, n = 0;
+
+	if (count < sizeof(e)) {
+		return -EINVAL;
+	}
+	verify_area(buf, count);
+	while (count - n >= sizeof(e)) {
+		cli();
+		if (trace_tail == trace_head) {
+			sti();
+			break;
+		}
+		e = trace_buf[trace_tail++ % TRACE_EVENTS];
+		sti();
+		for (p = (unsigned long *) &e, i = 0; i < sizeof(e) / 4; i++) {
+			put_fs_long(*p++, (unsigned long *) (buf + n) + i);
+		}
+		n += sizeof(e);
+	}
+	return n;
+}
+
+/**
+ * 设置事件位图(/dev/trace)
+ * @param[in]	buf		用户缓冲区，开头是新的事件位图
+ * @param[in]	count	字节数
+ * @retval		成功返回写入的字节数，出错返回错误号
+ */
+int trace_write(char * buf, int count)
+{
+	if (count != sizeof(unsigned long)) {
+		return -EINVAL;
+	}
+	if (!suser()) {
+		return -EPERM;
+	}
+	trace_mask = get_fs_long((unsigned long *) buf) & ((1 << NR_TRACE_EVENTS) - 2);
+	return count;
+}
+
+/* 分配跟踪缓冲区，在内存管理初始化以后调用 */
+void trace_init(void)
+{
+	if (!(trace_buf = (struct trace_event *) __get_free_pages(TRACE_ORDER))) {
+		panic("Unable to allocate trace buffer");
+	}
+	has_tsc = cpu_has_tsc();
+}
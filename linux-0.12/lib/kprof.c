@@ -0,0 +1,17 @@
+/*
+ *  linux/lib/kprof.c
+ */
+
+#define __LIBRARY__
+#include <unistd.h>     /* Linux标准头文件。定义了各种符号常数和类型，并声明了各种函数。若定义了__LIBRARY__，则含有系统调用号和内嵌汇编syscal0()等 */
+#include <sys/profile.h>
+
+/**
+ * 控制内核态采样
+ * 下面该宏对应函数原型：int kprof(int cmd, char * buf, int arg)。命令见include/sys/profile.h
+ * @param[in]	cmd		KPROF_START、KPROF_STOP、KPROF_READ或KPROF_FREE
+ * @param[in]	buf		KPROF_READ的缓冲区
+ * @param[in]	arg		KPROF_START的粒度，KPROF_READ的缓冲区字节数
+ * @retval		KPROF_READ返回读出的字节数，其他命令返回0，失败返回-1并设置errno
+ */
+_syscall3(int, kprof, int, cmd, char *, buf, int, arg)
@@ -81,18 +81,25 @@
 #include <asm/system.h>		/* 系统头文件。定义了设置或修改描述符/中断门等的嵌入式汇编宏 */
 
 /* 存储桶描述符结构 */
-struct bucket_desc {					/* 16 bytes */
+struct bucket_desc {					/* 24 bytes */
 	void				*page;          /* 该桶描述符对应的内存页面指针 */
 	struct bucket_desc	*next;          /* 下一个描述符指针 */
+	struct bucket_desc	*prev;          /* 前一个描述符指针 */
 	void				*freeptr;       /* 指向本桶中空闲内存位置的指针 */
+	struct _bucket_dir	*dir;           /* 本桶所属的桶目录项 */
 	unsigned short		refcnt;         /* 引用计数 */
 	unsigned short		bucket_size;    /* 本描述符对应存储桶的大小 */
 };
 
-/* 存储桶描述符目录结构 */
-struct _bucket_dir {					/* 8 bytes */
+/*
+ * 存储桶描述符目录结构
+ * chain上只链接还有空闲对象的桶，装满的桶从chain上取下，只能通过page_bucket[]找到，直到有对象被
+ * 释放时再链回。这样malloc()总是取chain的第一个桶，不必逐个查看。
+ */
+struct _bucket_dir {					/* 12 bytes */
 	int			size;           		/* 该存储桶的大小（字节数） */
 	struct bucket_desc	*chain;         /* 该存储桶目录项的桶描述符链表指针 */
+	int			nr_pages;				/* 该大小的桶占用的页面数 */
 };
 
 /*
@@ -116,16 +123,16 @@ struct _bucket_dir {					/* 8 bytes */
  */
 /* 存储桶目录列表（数组）*/
 struct _bucket_dir bucket_dir[] = {
-	{ 16,	(struct bucket_desc *) 0},      /* 16B长度的内存块 */
-	{ 32,	(struct bucket_desc *) 0},      /* 32B长度的内存块 */
-	{ 64,	(struct bucket_desc *) 0},      /* 64B长度的内存块 */
-	{ 128,	(struct bucket_desc *) 0},      /* 128B长度的内存块 */
-	{ 256,	(struct bucket_desc *) 0},      /* 256B长度的内存块 */
-	{ 512,	(struct bucket_desc *) 0},      /* 512B长度的内存块 */
-	{ 1024,	(struct bucket_desc *) 0},      /* 1024B长度的内存块 */
-	{ 2048, (struct bucket_desc *) 0},      /* 2048B长度的内存块 */
-	{ 4096, (struct bucket_desc *) 0},      /* 4096B（1页）的内存块 */
-	{ 0,    (struct bucket_desc *) 0}};   	/* End of list marker */
+	{ 16,	(struct bucket_desc *) 0, 0},      /* 16B长度的内存块 */
+	{ 32,	(struct bucket_desc *) 0, 0},      /* 32B长度的内存块 */
+	{ 64,	(struct bucket_desc *) 0, 0},      /* 64B长度的内存块 */
+	{ 128,	(struct bucket_desc *) 0, 0},      /* 128B长度的内存块 */
+	{ 256,	(struct bucket_desc *) 0, 0},      /* 256B长度的内存块 */
+	{ 512,	(struct bucket_desc *) 0, 0},      /* 512B长度的内存块 */
+	{ 1024,	(struct bucket_desc *) 0, 0},      /* 1024B长度的内存块 */
+	{ 2048, (struct bucket_desc *) 0, 0},      /* 2048B长度的内存块 */
+	{ 4096, (struct bucket_desc *) 0, 0},      /* 4096B（1页）的内存块 */
+	{ 0,    (struct bucket_desc *) 0, 0}};   	/* End of list marker */
 
 /*
  * This contains a linked list of free bucket descriptor blocks
@@ -133,6 +140,34 @@ struct _bucket_dir bucket_dir[] = {
 /* 下面是含有空闲桶描述符内存块的链表 */
 struct bucket_desc *free_bucket_desc = (struct bucket_desc *) 0;
 
+/* 主内存区每个页面对应的桶描述符，页面不是存储桶时为NULL。free_s()由此直接找到对象所在的桶 */
+static struct bucket_desc *page_bucket[PAGING_PAGES];
+
+/* 把桶描述符插入其目录项chain的头部 */
+static inline void bucket_link(struct bucket_desc *bdesc)
+{
+	struct _bucket_dir *bdir = bdesc->dir;
+
+	bdesc->prev = (struct bucket_desc *) 0;
+	if ((bdesc->next = bdir->chain)) {
+		bdesc->next->prev = bdesc;
+	}
+	bdir->chain = bdesc;
+}
+
+/* 把桶描述符从其目录项的chain中取下 */
+static inline void bucket_unlink(struct bucket_desc *bdesc)
+{
+	if (bdesc->next) {
+		bdesc->next->prev = bdesc->prev;
+	}
+	if (bdesc->prev) {
+		bdesc->prev->next = bdesc->next;
+	} else {
+		bdesc->dir->chain = bdesc->next;
+	}
+}
+
 /*
  * This routine initializes a bucket description page.
  */
@@ -183,6 +218,7 @@ void *malloc(unsigned int len)
 	struct _bucket_dir	*bdir;
 	struct bucket_desc	*bdesc;
 	void				*retval;
+	unsigned long		flags;
 
 	/*
 	 * First we search the bucket_dir to find the right bucket change
@@ -205,15 +241,10 @@ void *malloc(unsigned int len)
 	/*
 	 * Now we search for a bucket descriptor which has free space
 	 */
-	/* 现在我们来搜索具有空闲空间的桶描述符 */
+	/* 现在我们来取具有空闲空间的桶描述符。chain上的桶都有空闲对象，取第一个即可 */
+	save_flags(flags);
 	cli();		/* Avoid race conditions */ /* 为了避免出现竞争条件，首先关中断 */
-	/* 在桶目录项对应的描述符链表查找具有空闲空间的桶描述符 */
-	/* 如果桶描述符的空闲内存指针freeptr不为空，则表示找到了相应的桶描述符 */
-	for (bdesc = bdir->chain; bdesc; bdesc = bdesc->next) {
-		if (bdesc->freeptr) {
-			break;
-		}
-	}
+	bdesc = bdir->chain;
 	/*
 	 * If we didn't find a bucket with free space, then we'll
 	 * allocate a new one.
@@ -240,6 +271,7 @@ void *malloc(unsigned int len)
 		/* 初始化该新的桶描述符 */
 		bdesc->refcnt = 0;
 		bdesc->bucket_size = bdir->size;
+		bdesc->dir = bdir;
 		bdesc->page = bdesc->freeptr = (void *) (cp = (char *)get_free_page());
 		/*
 		 * 如果申请内存页面操作失败，则显示出错信息，死机。否则以该桶目录项指定的桶大小为对象长度，对该页内存进行划分，
@@ -247,6 +279,8 @@ void *malloc(unsigned int len)
 		 */
 		if (!cp)
 			panic("Out of memory in kernel malloc()");
+		page_bucket[MAP_NR((unsigned long) cp)] = bdesc;
+		bdir->nr_pages++;
 		/* Set up the chain of free objects */
         /* 在该页空闲内存中建立空闲对象链表 */
 		/* 以该桶目录项指定的桶大小对该页内存进行划分，并使每个对象的开始4字节设置成指向下一对象的指针 */
@@ -256,34 +290,24 @@ void *malloc(unsigned int len)
 		}
 		*((char **) cp) = 0;
 		/* 将该描述符插入到描述符链表头处 */
-		/*
-		 * 然后让该桶描述符的下一描述符指针字段指向对应桶目录项指针chain所指的描述符，而桶目录的chain指向该桶描述符，
-		 * 也即将该描述符插入到描述符链链头处
-		 */
-		bdesc->next = bdir->chain; 		/* OK, link it in! */	/* OK，将其链入 */
-		bdir->chain = bdesc;
+		bucket_link(bdesc);		/* OK, link it in! */	/* OK，将其链入 */
     }
 	/* 返回该描述符对应页面的当前空闲指针，然后调整该空闲指针指向下一个空闲对象 */
-	/* 并使描述符中对应页面中对象引用计数增1。最后开发中断，并返回指向空闲内存对象的指针 */
+	/* 并使描述符中对应页面中对象引用计数增1。桶被装满时把它从chain上取下 */
 	retval = (void *) bdesc->freeptr;
 	bdesc->freeptr = *((void **) retval);	/* 前4个字节为下一个空闲对象的指针 */
 	bdesc->refcnt++;
+	if (!bdesc->freeptr) {
+		bucket_unlink(bdesc);
+	}
 
-	sti();		/* OK, we're safe again */
-				/* OK，现在我们又安全了 */
+	restore_flags(flags);	/* OK, we're safe again */
+							/* OK，现在我们又安全了 */
 	return(retval);
 }
 
 /*
- * Here is the free routine.  If you know the size of the object that you
- * are freeing, then free_s() will use that information to speed up the
- * search for the bucket descriptor.
- *
- * We will #define a macro so that "free(x)" is becomes "free_s(x, 0)"
- */
-/*
- * 下面是释放子程序。如果你知道释放对象的大小，则free_s()将使用该信息加快搜寻对应桶描述符
- * 的速度。
+ * 下面是释放子程序。对象所在页面的桶描述符直接由page_bucket[]查出，不必搜索桶链表。
  *
  * 我们将定义一个宏，使得“free(x)”成为“free_s(x, 0)”。
  */
@@ -291,76 +315,53 @@ void *malloc(unsigned int len)
 /**
  * 释放存储桶对象
  * @param[in]	obj		对应对象指针
- * @param[in]	size	大小
+ * @param[in]	size	大小，为0时不检查
  */
 void free_s(void *obj, int size)
 {
-	void				*page;
-	struct _bucket_dir	*bdir;
-	struct bucket_desc	*bdesc, *prev;
+	unsigned long		page, flags;
+	struct bucket_desc	*bdesc;
 
 	/* Calculate what page this object lives in */
     /* 计算该对象所在页面 */
-	page = (void *)  ((unsigned long) obj & 0xfffff000);
-	/* Now search the buckets looking for that page */
-    /* 现在搜索存储桶目录项所链接的桶描述符，寻找该页面 */
-	for (bdir = bucket_dir; bdir->size; bdir++) {
-		prev = 0;
-		/* If size is zero then this conditional is always false */
-		/* 如果参数size是0，则下面条件肯定是false */
-		if (bdir->size < size)
-			continue;
-		/* 搜索对应目录项中链接的所有描述符，查找对应页面 */
-		/*
-		 * 如果某描述符页面指针等于page则表示找到了相应描述符，跳转到found。如果描述符不含有对应page，则让描述符指针prev指向
-		 * 该描述符。若搜索了对应目录项的所有描述符都没有找到指定的页面，则显示出错信息，死机
-		 */
-		for (bdesc = bdir->chain; bdesc; bdesc = bdesc->next) {
-			if (bdesc->page == page)
-				goto found;
-			prev = bdesc;
-		}
-	}
-	panic("Bad address passed to kernel free_s()");
-found:
-	/* 找到对应的桶描述符后，首先关中断，然后将该对象内存块链入空闲块对象链表中，并使该描述符的对象引用计数增1 */
+	page = (unsigned long) obj & 0xfffff000;
+	if (page < LOW_MEM || page >= HIGH_MEMORY)
+		panic("Bad address passed to kernel free_s()");
+	save_flags(flags);
 	cli();		/* To avoid race conditions */	/* 为了避免竞争条件 */
+	if (!(bdesc = page_bucket[MAP_NR(page)]) || bdesc->bucket_size < size)
+		panic("Bad address passed to kernel free_s()");
+	/* 装满的桶不在chain上，现在它又有了空闲对象，重新链入 */
+	if (!bdesc->freeptr)
+		bucket_link(bdesc);
 	/* 然后将该对象内存块链入空闲块对象链表中，并使该描述符的对象引用计数减1。*/
 	*((void **)obj) = bdesc->freeptr;
 	bdesc->freeptr = obj;
 	bdesc->refcnt--;
 	if (bdesc->refcnt == 0) { /* 引用计数等于0，则需要释放对应的内存页面和该桶描述符 */
-		/*
-		 * We need to make sure that prev is still accurate.  It
-		 * may not be, if someone rudely interrupted us....
-		 */
-		/* 我们需要确信prev仍然是正确的，若某程序粗鲁地中断了我们就有可能不是了 */
-		/* prev已经不是搜索到的描述符的前一个描述符，则重新搜索当前描述符的前一个描述符 */
-		if ((prev && (prev->next != bdesc)) || (!prev && (bdir->chain != bdesc))) {
-			for (prev = bdir->chain; prev; prev = prev->next)
-				if (prev->next == bdesc)
-					break;
-		}
-		/*
-		 * 如果找到该前一个描述符，则从描述符链中删除当前描述符
-		 */
-		if (prev)
-			prev->next = bdesc->next;
-		else {	/* 如果prev==NULL，则说明当前描述符是该目录项第1个描述符 */
-			/*
-			 * 即目录项中chain应该直接指向当前描述符bdesc，否则表示链表有问题，则显示出错信息，死机。因此
-			 * 为了将当前描述符从链表中删除，应该让chain指向下一个描述符
-			 */
-			if (bdir->chain != bdesc)
-				panic("malloc bucket chains corrupted");
-			bdir->chain = bdesc->next;
-		}
+		bucket_unlink(bdesc);
+		page_bucket[MAP_NR(page)] = (struct bucket_desc *) 0;
+		bdesc->dir->nr_pages--;
 		/* 释放当前描述符所操作的内存页面，并将该描述符插入空闲描述符表开始处 */
-		free_page((unsigned long) bdesc->page);
+		free_page(page);
 		bdesc->next = free_bucket_desc;
 		free_bucket_desc = bdesc;
 	}
-	sti();		/* 开中断，返回 */
+	restore_flags(flags);		/* 恢复中断状态，返回 */
 	return;
 }
 
+/**
+ * 显示各种大小存储桶占用的页面数(由show_mem()调用)
+ * @retval		void
+ */
+void malloc_info(void)
+{
+	struct _bucket_dir	*bdir;
+
+	printk("malloc buckets:");
+	for (bdir = bucket_dir; bdir->size; bdir++) {
+		printk(" %d*%d", bdir->nr_pages, bdir->size);
+	}
+	printk("\n\r");
+}
@@ -0,0 +1,31 @@
+/*
+ *  linux/lib/profil.c
+ */
+
+#define __LIBRARY__
+#include <unistd.h>     /* Linux标准头文件。定义了各种符号常数和类型，并声明了各种函数。若定义了__LIBRARY__，则含有系统调用号和内嵌汇编syscal0()等 */
+#include <sys/profile.h>
+
+/* sys_prof()的参数超过3个，只传递指向参数块的指针 */
+static _syscall1(int, prof, unsigned long *, args)
+
+/**
+ * 设置用户态采样
+ * 把4个参数依次放入参数块，再调用系统调用prof。参数的含义见include/sys/profile.h
+ * @param[in]	buf		计数器数组
+ * @param[in]	bufsiz	计数器数组的字节数
+ * @param[in]	offset	采样的起始代码地址
+ * @param[in]	scale	比例因子，为0或1时停止采样
+ * @retval		成功返回0，失败返回-1并设置errno
+ */
+int profil(unsigned short * buf, unsigned long bufsiz, unsigned long offset,
+	unsigned long scale)
+{
+	unsigned long args[4];
+
+	args[0] = (unsigned long) buf;
+	args[1] = bufsiz;
+	args[2] = offset;
+	args[3] = scale;
+	return prof(args);
+}
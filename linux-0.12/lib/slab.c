@@ -0,0 +1,153 @@
+/*
+ *  linux/lib/slab.c
+ */
+
+/*
+ * 建在malloc()存储桶之上的对象缓存。
+ *
+ * 缓存中的每个对象后面附加一个链接字，对象空闲时用它链入缓存的空闲链表，所以空闲对象的内容(构造
+ * 函数设置的状态)不会被破坏。缓存最多保留大约一页的空闲对象，多出来的还给malloc()，以免某种对象
+ * 的一次使用高峰长期占住内存。
+ */
+#include <linux/kernel.h>	/* 内核头文件。含有一些内核常用函数的原型定义 */
+#include <linux/mm.h>		/* 内存管理头文件。含有页面大小定义和一些页面管理函数原型 */
+#include <linux/slab.h>		/* 对象缓存头文件 */
+#include <asm/system.h>		/* 系统头文件。定义了设置或修改描述符/中断门等的嵌入式汇编宏 */
+
+struct kmem_cache {
+	const char * name;					/* 缓存名，显示统计信息用 */
+	unsigned int size;					/* 对象长度(按4字节对齐) */
+	unsigned int objsize;				/* 对象长度加链接字，即向malloc()申请的长度 */
+	void (*ctor)(void *);				/* 构造函数，可以为NULL */
+	void * freelist;					/* 空闲对象链表 */
+	int nr_free;						/* 空闲对象数 */
+	int limit;							/* 空闲对象数上限 */
+	int nr_active;						/* 正在使用的对象数 */
+	int peak;							/* nr_active曾经达到的最大值 */
+	unsigned long nr_allocs;			/* 累计分配次数 */
+	unsigned long nr_grows;				/* 其中从malloc()新取对象的次数 */
+	struct kmem_cache * next;			/* 所有缓存组成的链表 */
+};
+
+/* 对象obj的链接字 */
+#define obj_link(cachep, obj)	(*(void **) ((char *) (obj) + (cachep)->size))
+
+static struct kmem_cache * cache_chain = NULL;
+
+/**
+ * 建立对象缓存
+ * 在初始化时调用，缓存建立后不再撤销。
+ * @param[in]	name	缓存名
+ * @param[in]	size	对象长度
+ * @param[in]	ctor	构造函数，可以为NULL
+ * @retval		缓存指针，没有内存时返回NULL
+ */
+struct kmem_cache * kmem_cache_create(const char * name, unsigned int size,
+	void (*ctor)(void *))
+{
+	struct kmem_cache * cachep;
+	unsigned long flags;
+
+	size = (size + 3) & ~3;
+	if (size + sizeof(void *) > PAGE_SIZE) {
+		panic("kmem_cache_create: object too large");
+	}
+	if (!(cachep = (struct kmem_cache *) malloc(sizeof(struct kmem_cache)))) {
+		return NULL;
+	}
+	cachep->name = name;
+	cachep->size = size;
+	cachep->objsize = size + sizeof(void *);
+	cachep->ctor = ctor;
+	cachep->freelist = NULL;
+	cachep->nr_free = 0;
+	cachep->limit = PAGE_SIZE / cachep->objsize;
+	cachep->nr_active = cachep->peak = 0;
+	cachep->nr_allocs = cachep->nr_grows = 0;
+	save_flags(flags);
+	cli();
+	cachep->next = cache_chain;
+	cache_chain = cachep;
+	restore_flags(flags);
+	return cachep;
+}
+
+/**
+ * 从缓存中分配一个对象
+ * 缓存空闲链表为空时向malloc()申请新对象并调用构造函数。可以在中断中调用，此时构造函数也不能睡眠。
+ * @param[in]	cachep	缓存指针
+ * @retval		对象指针，没有内存时返回NULL
+ */
+void * kmem_cache_alloc(struct kmem_cache * cachep)
+{
+	void * obj;
+	unsigned long flags;
+	int grown = 0;
+
+	save_flags(flags);
+	cli();
+	if ((obj = cachep->freelist)) {
+		cachep->freelist = obj_link(cachep, obj);
+		cachep->nr_free--;
+	}
+	restore_flags(flags);
+	if (!obj) {
+		if (!(obj = malloc(cachep->objsize))) {
+			return NULL;
+		}
+		if (cachep->ctor) {
+			cachep->ctor(obj);
+		}
+		grown = 1;
+	}
+	save_flags(flags);
+	cli();
+	cachep->nr_allocs++;
+	cachep->nr_grows += grown;
+	if (++cachep->nr_active > cachep->peak) {
+		cachep->peak = cachep->nr_active;
+	}
+	restore_flags(flags);
+	return obj;
+}
+
+/**
+ * 把对象释放回缓存
+ * 对象应已恢复到构造后的状态。空闲对象已达上限时对象直接还给malloc()。
+ * @param[in]	cachep	缓存指针
+ * @param[in]	obj		对象指针
+ * @retval		void
+ */
+void kmem_cache_free(struct kmem_cache * cachep, void * obj)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	cachep->nr_active--;
+	if (cachep->nr_free >= cachep->limit) {
+		free_s(obj, cachep->objsize);
+	} else {
+		obj_link(cachep, obj) = cachep->freelist;
+		cachep->freelist = obj;
+		cachep->nr_free++;
+	}
+	restore_flags(flags);
+}
+
+/**
+ * 显示各缓存的使用统计(由show_mem()调用)
+ * @retval		void
+ */
+void kmem_cache_info(void)
+{
+	struct kmem_cache * cachep;
+
+	printk("cache      size active  free  peak    allocs    grows\n\r");
+	for (cachep = cache_chain; cachep; cachep = cachep->next) {
+		printk("%-10s %4d %6d %5d %5d %9d %8d\n\r", cachep->name, cachep->size,
+			cachep->nr_active, cachep->nr_free, cachep->peak,
+			cachep->nr_allocs, cachep->nr_grows);
+	}
+	malloc_info();
+}
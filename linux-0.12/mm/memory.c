@@ -54,6 +54,8 @@
 #include <linux/sched.h>	/* 调度程序头文件。定义了任务结构task_struct、任务0的数据等 */
 #include <linux/head.h>		/* head头文件，定义了段描述符的简单结构，和几个选择符常量 */
 #include <linux/kernel.h>	/* 内核头文件。含有一些内核常用函数的原型定义 */
+#include <linux/slab.h>		/* 对象缓存头文件 */
+#include <linux/trace.h>	/* 事件跟踪头文件 */
 
 /* 用于判断给定线性地址是否位于当前进程的代码段中，“(((addr)+4095)&~4095)”用于取得线性
  地址addr所在内存页面的末端地址 */
@@ -72,6 +74,125 @@ unsigned long HIGH_MEMORY = 0;
  */
 unsigned char mem_map [ PAGING_PAGES ] = {0, };
 
+/*
+ * 伙伴系统空闲块链表。空闲块本身没有别的用处，所以链表指针直接存放在块的第1个页面开头；
+ * free_order[]记录每个空闲块首页面的阶数加1，其余页面(包括空闲块内部的页面)为0，用来在释放时
+ * 判断伙伴块是否空闲。空闲块中所有页面的mem_map[]项都是0，分配出去的每个页面都是1，所以
+ * 引用计数的用法(free_page()、copy_page_tables()等)与原来完全一样。
+ *
+ * 这些函数不会睡眠，而且中断处理程序不分配也不释放页面，因此不需要关中断。
+ */
+struct mem_list {
+	struct mem_list * next;
+	struct mem_list * prev;
+};
+
+static struct mem_list free_area[NR_MEM_LISTS];
+static unsigned char free_order[PAGING_PAGES];
+int nr_free_pages = 0;			/* 空闲页面总数 */
+
+#define page_list(nr) ((struct mem_list *) (LOW_MEM + ((nr) << 12)))
+
+/* 把以页面nr开始的2^order页空闲块加入第order个链表头部 */
+static inline void add_mem_list(int order, unsigned long nr)
+{
+	struct mem_list * head = free_area + order;
+	struct mem_list * p = page_list(nr);
+
+	p->prev = head;
+	p->next = head->next;
+	head->next->prev = p;
+	head->next = p;
+	free_order[nr] = order + 1;
+}
+
+/* 把以页面nr开始的空闲块从所在链表中取下 */
+static inline void del_mem_list(unsigned long nr)
+{
+	struct mem_list * p = page_list(nr);
+
+	p->prev->next = p->next;
+	p->next->prev = p->prev;
+	free_order[nr] = 0;
+}
+
+/**
+ * 释放一个空闲块并与空闲的伙伴块合并
+ * 阶数为order的块nr的伙伴是nr^(1<<order)。只要伙伴块也是同阶的空闲块，就把两者合成高一阶的块
+ * 继续向上合并。主内存区以外的页面从不进入链表，所以不会被合并进来。
+ * @param[in]	nr		块的首页面号(按2^order对齐)
+ * @param[in]	order	块的阶数
+ * @retval		void
+ */
+static void free_pages_ok(unsigned long nr, int order)
+{
+	unsigned long buddy;
+
+	nr_free_pages += 1 << order;
+	while (order < NR_MEM_LISTS - 1) {
+		buddy = nr ^ (1 << order);
+		if (buddy >= PAGING_PAGES || free_order[buddy] != order + 1) {
+			break;
+		}
+		del_mem_list(buddy);
+		nr &= buddy;
+		order++;
+	}
+	add_mem_list(order, nr);
+}
+
+/**
+ * 分配连续的2^order个物理页面
+ * 从第order个链表开始向上找到第一个非空的链表，取下其中一块；若它比需要的大，就反复对半分开，
+ * 把高地址的一半放回低一阶的链表。分配到的每个页面的mem_map[]项都置为1，可以用free_page()
+ * 逐页释放，也可以用free_pages()一次释放。页面内容不清零。
+ * @param[in]	order	阶数(0 ~ NR_MEM_LISTS-1)
+ * @retval		起始物理地址，没有足够大的空闲块时返回0
+ */
+unsigned long __get_free_pages(int order)
+{
+	struct mem_list * head;
+	unsigned long nr;
+	int i;
+
+	if (order < 0 || order >= NR_MEM_LISTS) {
+		return 0;
+	}
+	for (i = order, head = free_area + order; head->next == head; head++) {
+		if (++i >= NR_MEM_LISTS) {
+			return 0;
+		}
+	}
+	nr = MAP_NR((unsigned long) head->next);
+	del_mem_list(nr);
+	while (i > order) {
+		i--;
+		add_mem_list(i, nr + (1 << i));
+	}
+	nr_free_pages -= 1 << order;
+	for (i = 0; i < (1 << order); i++) {
+		mem_map[nr + i] = 1;
+	}
+	return LOW_MEM + (nr << 12);
+}
+
+/**
+ * 释放__get_free_pages()分配的连续页面
+ * 逐页减少引用计数，计数降为0的页面各自回到伙伴系统并与伙伴合并，因此块中某些页面仍被共享
+ * 也没有关系。
+ * @param[in]	addr	起始物理地址
+ * @param[in]	order	分配时的阶数
+ * @retval		void
+ */
+void free_pages(unsigned long addr, int order)
+{
+	int i;
+
+	for (i = 0; i < (1 << order); i++) {
+		free_page(addr + (i << 12));
+	}
+}
+
 /*
  * Free a page of memory at physical address 'addr'. Used by
  * 'free_page_tables()'
@@ -105,12 +226,15 @@ void free_page(unsigned long addr)
 	/* 页面号 = (addr-LOW_MEM)/4096 */
 	addr -= LOW_MEM;
 	addr >>= 12;
-	if (mem_map[addr]--) {
-		return;
+	if (!mem_map[addr]) {
+		/* 执行到此处表示要释放原本已经空闲的页面，内核存在问题 */
+		panic("trying to free free page");
+	}
+	/* 引用计数降为0时把页面还给伙伴系统，它占用的交换缓存页面也一并释放 */
+	if (!--mem_map[addr]) {
+		delete_from_swap_cache(addr);
+		free_pages_ok(addr, 0);
 	}
-	/* 执行到此处表示要释放原本已经空闲的页面，内核存在问题 */
-	mem_map[addr] = 0;
-	panic("trying to free free page");
 }
 
 /*
@@ -170,6 +294,12 @@ int free_page_tables(unsigned long from, unsigned long size)
 			continue;
 		}
 		pg_table = (unsigned long *) (0xfffff000 & *dir);		/* 取页表地址 */
+		/* 页表还与别的进程共享时，页表项映射的页面归共享者所有，只减少页表的引用计数 */
+		if (mem_map[MAP_NR((unsigned long) pg_table)] > 1) {
+			free_page((unsigned long) pg_table);
+			*dir = 0;
+			continue;
+		}
 		for (nr = 0 ; nr < 1024 ; nr++) {
 			if (*pg_table) {		/* 若所指页表项内容不为0，则若该项有效，则释放对应页。否则释放交换设备中对应页 */
 				if (1 & *pg_table) {	/* 在物理内存中  */
@@ -217,15 +347,28 @@ int free_page_tables(unsigned long from, unsigned long size)
  * 面也已经超出我们的需求,但这不会占用更多的内存,在低1MB内存范围内不执行写时复制操作，所以这些页面
  * 可以与内核共享。因此这是nr=xxxx的特殊情况(nr在程序中指页面数)。
  */
+/*
+ * 页表本身也写时复制。from不为0时只复制页目录项：两个目录项指向同一个页表，都置为只读，页表所在
+ * 页面的引用计数加1，页表项和页面引用计数都不动。用户态访问时页面的权限是目录项与页表项权限的
+ * "与"，所以此后两个进程对这4MB的任何写操作都会引起写保护异常，由unshare_page_table()为写的进程
+ * 复制页表。这样fork()的开销只与页目录项数有关，与父进程用了多少内存无关；fork()之后马上execve()
+ * 的子进程只需在free_page_tables()中减少页表的引用计数，父进程随后写时发现页表已不再共享，只需
+ * 恢复目录项的可写标志，连页面也不用复制。
+ *
+ * 因此共享页表中的页表项可能是可写的，凡是修改页表项的地方都要先看目录项：写用户页面(写时复制、
+ * write_verify())之前要先复制页表；只读地换入或映射页面时可以直接修改共享页表，结果对共享它的
+ * 进程都是正确的。
+ */
+
 /**
  * 复制目录表项和页表项（用于写时复制机制）
- * 复制指定线性地址和长度内存对应的页目录项和页表项，从而被复制的页目录和页表对应的原物理内存页面区
- * 被两套页表映射而共享使用。复制时，需申请新页面来存放新页表，原物理内存区将被共享。此后两个进程(父
- * 进程和其子进程)将共享内存区，直到有一个进程执行写操作时，内核才会为写操作进程分配新的内存页。
+ * 复制指定线性地址和长度内存对应的页目录项，让父子进程共享页表和页表映射的物理内存页面，直到有一个
+ * 进程执行写操作时，内核才会为写操作进程复制页表和分配新的内存页。from为0(任务0创建任务1)时内核
+ * 页表不在主内存区中，仍为新进程申请页表并复制前160个页表项。
  * @param[in]	from	源线性地址
  * @param[in]	to		目标线性地址
  * @param[in]	size	需要复制的长度(单位是字节)
- * @return		0
+ * @return		成功返回0，内存不够返回-1
  */
 int copy_page_tables(unsigned long from, unsigned long to, long size)
 {
@@ -262,6 +405,13 @@ int copy_page_tables(unsigned long from, unsigned long to, long size)
 		if (!(1 & *from_dir)) {
 			continue;
 		}
+		/* 共享页表：两个目录项都只读，页表引用计数加1 */
+		if (from) {
+			*from_dir &= ~PAGE_RW;
+			*to_dir = *from_dir;
+			mem_map[MAP_NR(0xfffff000 & *from_dir)]++;
+			continue;
+		}
 		/*
 		 * 在验证了当前源目录项和目的项正常之后，我们取源目录项中页表地址from_page_table。为了保存目的目录项对应的页表，需要在主内存区中
 		 * 申请1页空闲内存页。如果取空闲页面函数get_free_page()返回0，则说明没有申请到空闲内存页面，可能是内存不够。于是返回-1值退出
@@ -300,7 +450,7 @@ int copy_page_tables(unsigned long from, unsigned long to, long size)
 				if (!(new_page = get_free_page())) {
 					return -1;
 				}
-				read_swap_page(this_page >> 1, (char *) new_page);
+				swap_read(this_page >> 1, (char *) new_page);
 				*to_page_table = this_page;
 				*from_page_table = new_page | (PAGE_DIRTY | 7);
 				continue;
@@ -461,6 +611,7 @@ unsigned long put_dirty_page(unsigned long page, unsigned long address)
 
 	/* 即如果该内存页面此时只被一个进程使用，就直接把属性改为可写即可 */
 	if (old_page >= LOW_MEM && mem_map[MAP_NR(old_page)] == 1) {
+		delete_from_swap_cache(MAP_NR(old_page));	/* 页面要被修改，交换设备上的副本作废 */
 		*table_entry |= 2;
 		invalidate();
 		return;
@@ -475,10 +626,71 @@ unsigned long put_dirty_page(unsigned long page, unsigned long address)
 	将指定页表项值更新为新页面地址 */
 	if (!(new_page = get_free_page()))
 		oom();							/* 内存不够处理 */
-	if (old_page >= LOW_MEM)
-		mem_map[MAP_NR(old_page)]--;
+	/*
+	 * get_free_page()可能睡眠，其间原页面可能被换出，共享者也可能已经释放了它。页表项变了就让进程重新
+	 * 执行写操作；否则复制后用free_page()释放原页面，引用计数降为0时页面能正常回到伙伴系统
+	 */
+	if ((0xfffff000 & *table_entry) != old_page || !(PAGE_PRESENT & *table_entry)) {
+		free_page(new_page);
+		return;
+	}
 	copy_page(old_page, new_page);
 	*table_entry = new_page | 7;
+	free_page(old_page);
+	invalidate();
+}
+
+/**
+ * 取消页表共享
+ * 目录项dir指向的页表被fork()共享，当前进程要写这4MB中的页面时调用。页表只剩当前进程使用时只需恢复
+ * 目录项的可写标志；否则为当前进程复制一份页表，页表项置为只读，页面引用计数加1，就像不共享页表的
+ * fork()所做的那样，此后再由un_wp_page()按页写时复制。
+ *
+ * 交换设备上的页面没有引用计数，不能让两个页表项都指向它，所以先把它们换入(换入到共享页表中，对
+ * 共享者都有效)。换入和申请页面都可能睡眠，睡眠期间页表可能被换出页面，共享者也可能已经退出或复制
+ * 了自己的页表，所以每次睡眠后都从头检查。复制页表项时不会睡眠。
+ * @param[in]	dir		当前进程的页目录项指针
+ * @retval		void
+ */
+static void unshare_page_table(unsigned long * dir)
+{
+	unsigned long * from_table, * to_table, this_page, new_table = 0;
+	int nr;
+
+repeat:
+	from_table = (unsigned long *) (0xfffff000 & *dir);
+	if (mem_map[MAP_NR((unsigned long) from_table)] == 1) {
+		free_page(new_table);
+		*dir |= PAGE_RW;
+		invalidate();
+		return;
+	}
+	for (nr = 0 ; nr < 1024 ; nr++) {
+		if (from_table[nr] && !(1 & from_table[nr])) {
+			swap_in(from_table + nr);
+			goto repeat;
+		}
+	}
+	if (!new_table) {
+		if (!(new_table = get_free_page())) {
+			oom();
+		}
+		goto repeat;
+	}
+	to_table = (unsigned long *) new_table;
+	for (nr = 0 ; nr < 1024 ; nr++) {
+		if (!(this_page = from_table[nr])) {
+			continue;
+		}
+		this_page &= ~PAGE_RW;
+		to_table[nr] = this_page;
+		if (this_page > LOW_MEM) {
+			from_table[nr] = this_page;
+			mem_map[MAP_NR(this_page)]++;
+		}
+	}
+	free_page((unsigned long) from_table);
+	*dir = new_table | 7;
 	invalidate();
 }
 
@@ -506,6 +718,9 @@ unsigned long put_dirty_page(unsigned long page, unsigned long address)
  */
 void do_wp_page(unsigned long error_code, unsigned long address)
 {
+	unsigned long * dir, * pte;
+
+	trace(TRACE_WP_PAGE, address, error_code, 0);
 	/*
 	 * 首先判断CPU控制寄存器CR2给出的引起页面异常的线性地址在什么范围中。如果address小于TASK_SIZE（0x4000000，即64MB），表示异常页面位置在内核
 	 * 或任务0和任务1所处的线性地址范围内，于是发出警告信息”内核范围内存被写保护“；如果（address-当前进程代码其实地址）大于一个进程的长度（64MB），表示
@@ -540,11 +755,19 @@ void do_wp_page(unsigned long error_code, unsigned long address)
 	 * "(0xffffff000 & *((unsigned long *)(((address >> 22) & 0x3ff) << 2)))"。
 	 * ③由①中页表项在页表中偏移地址，加上②中目录表项内容中对应页表的地址即可得到页表项的指针。然后这里对共享的页面进行复制操作
 	 */
-	/* 根据线性地址计算物理页面地址 */
-	un_wp_page((unsigned long *)
-		(((address >> 10) & 0xffc) + (0xfffff000 &
-		*((unsigned long *) ((address >> 20) & 0xffc)))));
-
+	/* 页表还是共享的(目录项只读)，先复制页表 */
+	dir = (unsigned long *) ((address >> 20) & 0xffc);
+	if (!(*dir & PAGE_RW)) {
+		unshare_page_table(dir);
+	}
+	/*
+	 * 然后对页表项进行写时复制。复制页表时可能睡眠，页面可能已被换出；页表不再共享时页表项也可能
+	 * 本来就是可写的。这两种情况都直接返回，让进程重新执行写操作
+	 */
+	pte = (unsigned long *) (((address >> 10) & 0xffc) + (0xfffff000 & *dir));
+	if ((*pte & (PAGE_PRESENT | PAGE_RW)) == PAGE_PRESENT) {
+		un_wp_page(pte);
+	}
 }
 
 /**
@@ -567,6 +790,11 @@ void write_verify(unsigned long address)
 	if (!( (page = *((unsigned long *) ((address >> 20) & 0xffc)) ) & 1)) {
 		return;
 	}
+	/* 页表是共享的，先复制一份(内核写用户空间时不检查目录项的读写位) */
+	if (!(page & PAGE_RW)) {
+		unshare_page_table((unsigned long *) ((address >> 20) & 0xffc));
+		page = *((unsigned long *) ((address >> 20) & 0xffc));
+	}
 	page &= 0xfffff000;
 	/* 得到页表项的物理地址 */
 	page += ((address >> 10) & 0xffc);
@@ -580,6 +808,35 @@ void write_verify(unsigned long address)
 	return;
 }
 
+/**
+ * 把当前进程的一个页面以写时复制方式共享出去
+ * 与copy_page_tables()对共享页面的处理相同：页表项置为只读，页面引用计数加1。此后进程再写该页面时，
+ * 若页面仍被共享就由do_wp_page()复制一份，若共享者已经释放了它，就只需恢复可写标志。用于管道的
+ * 页面捐赠(fs/pipe.c)。
+ * @param[in]	address		页面的线性地址
+ * @retval		页面的物理地址。页面不存在(未映射或已换出)或不在主内存区时返回0
+ */
+unsigned long share_user_page(unsigned long address)
+{
+	unsigned long page, * table;
+
+	if (!((page = *((unsigned long *) ((address >> 20) & 0xffc))) & 1)) {
+		return 0;
+	}
+	table = (unsigned long *) ((page & 0xfffff000) + ((address >> 10) & 0xffc));
+	if (!(*table & PAGE_PRESENT)) {
+		return 0;
+	}
+	page = *table & 0xfffff000;
+	if (page < LOW_MEM || page >= HIGH_MEMORY) {
+		return 0;
+	}
+	*table &= ~PAGE_RW;
+	mem_map[MAP_NR(page)]++;
+	invalidate();
+	return page;
+}
+
 /**
  * 取得一页空闲的物理内存并映射到指定线性地址处
  * get_free_page()仅是申请取得了主内存区的一页物理内存。而本函数则不仅是获取到一页物理内存页面，还进一步调用put_page()，将
@@ -791,6 +1048,7 @@ void do_no_page(unsigned long error_code, unsigned long address)
 	int block, i;
 	struct m_inode * inode;
 
+	trace(TRACE_NO_PAGE, address, error_code, 0);
 	/*
 	 * 首先判断CPU控制寄存器CR2给出的引起页面异常的线性地址在什么范围中。如果address小于TASK_SIZE（0x4000000，即64MB），
 	 * 表示异常页面位置在内核或任务0和任务1所处的线性地址范围内，于是发出警告信息“内核范围内存被写保护”；如果（address-当前
@@ -917,7 +1175,7 @@ void do_no_page(unsigned long error_code, unsigned long address)
  */
 void mem_init(long start_mem, long end_mem)
 {
-	int i;
+	int i, j;
 
 	/*
 	 * 首先将1MB到16MB范围内所有内存页面对应的内存映射字节数组项置为已占用状态，紧急各项字节值全部设置成USED（100）
@@ -941,9 +1199,14 @@ void mem_init(long start_mem, long end_mem)
 	end_mem -= start_mem;
 	end_mem >>= 12;
 
-	/* 将主内存区对应的页面的使用数置0，即未使用 */
+	/* 将主内存区对应的页面的使用数置0，即未使用，并逐页放入伙伴系统(相邻页面会自动合并成大块) */
+	for (j = 0; j < NR_MEM_LISTS; j++) {
+		free_area[j].next = free_area[j].prev = free_area + j;
+	}
+	nr_free_pages = 0;
 	while (end_mem-- > 0) {
-		mem_map[i++] = 0;
+		mem_map[i] = 0;
+		free_pages_ok(i++, 0);
 	}
 }
 
@@ -976,6 +1239,16 @@ void show_mem(void)
 	}
 	printk("%d free pages of %d\n\r", free, total);
 	printk("%d pages shared\n\r", shared);
+	/* 各阶空闲块的数量 */
+	for (i = 0; i < NR_MEM_LISTS; i++) {
+		struct mem_list * p;
+
+		for (j = 0, p = free_area[i].next; p != free_area + i; p = p->next) {
+			j++;
+		}
+		printk("%d*%dkB ", j, 4 << i);
+	}
+	printk("= %dkB free\n\r", nr_free_pages << 2);
 	/* 统计分页管理的逻辑页面数 */
 	/*
 	 * 页目录表前4项内核代码使用，不列为统计范围。方法从第5项开始循环处理所有目录项。若对应的页表存在，
@@ -1029,5 +1302,7 @@ void show_mem(void)
 		}
 	}
 	/* 最后显示系统中正在使用的内存页面和主内存区中总的内存页面数 */
-	printk("Memory found: %d (%d)\n\r\n\r", free - shared, total);
+	printk("Memory found: %d (%d)\n\r", free - shared, total);
+	kmem_cache_info();
+	printk("\n\r");
 }
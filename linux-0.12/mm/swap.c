@@ -17,6 +17,7 @@
 #include <linux/sched.h>    /* 调度程序头文件。定义了任务结构task_struct、任务0的数据，还有一些有关描述符参数设置和获取的嵌入汇编函数宏语句 */
 #include <linux/head.h>     /* head头文件，定义了段描述符的简单结构，和几个选择符常量 */
 #include <linux/kernel.h>   /* 内核头文件。含有一些内核常用函数的原型定义 */
+#include <linux/trace.h>    /* 事件跟踪头文件 */
 
 /* 1页(4096B)共有32768个位。最多可管理32768个页面，对应128MB内存容量 */
 #define SWAP_BITS (4096 << 3)       /* 定义一个页面含有的交换比特位数量 */
@@ -53,6 +54,25 @@ bitop(clrbit, "r")			/* clrbit(char * addr, unsigned int nr) */
 static char * swap_bitmap = NULL;
 int SWAP_DEV = 0;		/* 内核初始化时设置的交换设备号 */
 
+/*
+ * 交换页面锁位图。正在读写的交换页面在这里置位，swap_in()等读入页面前要等它写完，分配交换页面时
+ * 也跳过它们(进程退出时，还在写出的交换页面可能已被释放)。
+ */
+static char * swap_lockmap = NULL;
+static struct task_struct * swap_lock_wait = NULL;
+
+/*
+ * 交换页面按簇分配：一次找出SWAP_CLUSTER个连续的空闲页面，随后的分配依次从簇中取，这样同一次
+ * swap_out()换出的页面在交换设备上是连续的，可以一次写出，以后也能一次读入。lowest_free是空闲页面
+ * 号的下限，比它小的页面都已被占用，查找从这里开始。
+ */
+unsigned short swap_cache[PAGING_PAGES];	/* 物理页面对应的交换页面号，0表示不在交换缓存中 */
+
+static int swap_pages = 0;			/* 交换页面总数 */
+static int lowest_free = 1;
+static int cluster_next = 0;		/* 当前簇中下一个页面 */
+static int cluster_nr = 0;			/* 当前簇中剩余的页面数 */
+
 /*
  * We never page the pages in task[0] - kernel memory.
  * We page all other pages.
@@ -68,10 +88,61 @@ int SWAP_DEV = 0;		/* 内核初始化时设置的交换设备号 */
 
 #define VM_PAGES (LAST_VM_PAGE - FIRST_VM_PAGE) /* 1032192（从0开始计） */
 
+/* 交换页面nr空闲并且没有正在读写 */
+#define slot_free(nr) (bit(swap_bitmap, (nr)) && !bit(swap_lockmap, (nr)))
+
+/**
+ * 从lowest_free起查找len个连续的空闲交换页面
+ * 整个32位字都被占用时一次跳过32个页面。
+ * @param[in]   len     页面数
+ * @retval      第一个页面号，找不到时返回0
+ */
+static int find_free_cluster(int len)
+{
+    int nr, run = 0;
+
+    while (lowest_free < swap_pages && !bit(swap_bitmap, lowest_free)) {
+        lowest_free++;
+    }
+    for (nr = lowest_free; nr < swap_pages; nr++) {
+        if (!(nr & 31) && !((unsigned long *) swap_bitmap)[nr >> 5]) {
+            run = 0;
+            nr += 31;
+            continue;
+        }
+        if (!slot_free(nr)) {
+            run = 0;
+            continue;
+        }
+        if (++run == len) {
+            return nr - len + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * 清空交换缓存
+ * 交换空间用完时调用。缓存中的页面仍然映射着，以后换出时要重新分配交换页面并写盘。
+ * @retval      释放的交换页面数
+ */
+static int shrink_swap_cache(void)
+{
+    int i, freed = 0;
+
+    for (i = 0; i < PAGING_PAGES; i++) {
+        if (swap_cache[i]) {
+            delete_from_swap_cache(i);
+            freed++;
+        }
+    }
+    return freed;
+}
+
 /**
  * 申请1页交换页面
- * 扫描整个交换映射位图(除对应位图本身的位0以外)，复位值为1的第一个比特位号
- * 并返回其位置值，即目前空闲的交换页面号。
+ * 先从当前簇中取，簇用完后另找一个空闲簇；交换空间零碎得找不到整簇时，退回到从lowest_free起逐个
+ * 查找。交换空间用完时收回交换缓存占用的交换页面再找一次。
  * @param[in]   void
  * @retval      成功返回交换页面号，失败返回0
  */
@@ -82,11 +153,28 @@ static int get_swap_page(void)
     if (!swap_bitmap) {
         return 0;
     }
-    for (nr = 1; nr < SWAP_BITS; nr++) {
-        if (clrbit(swap_bitmap, nr)) {
+    while (cluster_nr > 0) {
+        cluster_nr--;
+        nr = cluster_next++;
+        if (!bit(swap_lockmap, nr) && clrbit(swap_bitmap, nr)) {
+            return nr;
+        }
+    }
+repeat:
+    if ((nr = find_free_cluster(SWAP_CLUSTER))) {
+        cluster_next = nr + 1;
+        cluster_nr = SWAP_CLUSTER - 1;
+        clrbit(swap_bitmap, nr);
+        return nr;
+    }
+    for (nr = lowest_free; nr < swap_pages; nr++) {
+        if (!bit(swap_lockmap, nr) && clrbit(swap_bitmap, nr)) {
             return nr;      /* 返回目前空闲的交换页面号 */
         }
     }
+    if (shrink_swap_cache()) {
+        goto repeat;
+    }
     return 0;
 }
 
@@ -104,6 +192,9 @@ void swap_free(int swap_nr)
     }
     if (swap_bitmap && swap_nr < SWAP_BITS) {
         if (!setbit(swap_bitmap, swap_nr)) {
+            if (swap_nr < lowest_free) {
+                lowest_free = swap_nr;
+            }
             return;
         }
     }
@@ -111,17 +202,48 @@ void swap_free(int swap_nr)
     return;
 }
 
+/* 锁住交换页面nr，它正在读写时等待 */
+static inline void lock_swap_page(int nr)
+{
+    while (setbit(swap_lockmap, nr)) {
+        sleep_on(&swap_lock_wait);
+    }
+}
+
+/* 解锁交换页面nr。调用者在解锁一批页面后wake_up(&swap_lock_wait) */
+static inline void unlock_swap_page(int nr)
+{
+    clrbit(swap_lockmap, nr);
+}
+
+/**
+ * 读入一个交换页面，不释放交换页面
+ * 用于fork时复制已被换出的页面。页面正在写出时先等它写完。
+ * @param[in]   swap_nr     交换页面号
+ * @param[in]   buffer      页面地址
+ * @retval      void
+ */
+void swap_read(int swap_nr, char * buffer)
+{
+    lock_swap_page(swap_nr);
+    read_swap_page(swap_nr, buffer);
+    unlock_swap_page(swap_nr);
+    wake_up(&swap_lock_wait);
+}
+
 /**
  * 把指定页面交换进内存中
- * 把指定页表项的对应页面从交换设备中读入到新申请的内存页面中。修改交换位图中对应位(置位)，同
- * 时修改页表项内容，让它指向该内存页面，并设置相应标志。
+ * 把指定页表项的对应页面从交换设备中读入到新申请的内存页面中，修改页表项内容，让它指向该内存
+ * 页面。交换页面并不释放，而是把页面放入交换缓存，以只读方式映射，页面被写之前再换出时不必写盘。
+ * 同一页表中紧接在后面的页表项如果依次换出到了紧接着的交换页面(它们通常是同一次swap_out()换出
+ * 的)，就一起读入，最多SWAP_CLUSTER页。
  * @param[in]	table_ptr   页表项指针
  * @retval		void
  */
 void swap_in(unsigned long *table_ptr)
 {
-    int swap_nr;
-    unsigned long page;
+    int swap_nr, nr, i;
+    char * pages[SWAP_CLUSTER];
 
     /*
      * 首先检查交换位图和参数有效性。如果交换位图不存在，或者指定页表项对应的页面已存在于内存中，或者
@@ -142,31 +264,106 @@ void swap_in(unsigned long *table_ptr)
         printk("No swap page in swap_in\n\r");
         return;
     }
+    trace(TRACE_SWAP_IN, swap_nr, (unsigned long) table_ptr, 0);
+    /*
+     * 锁住要读入的交换页面。缺页的页面正在写出时要等待；预读的页面不等待，遇到正在读写的页面就停止
+     * 预读。页表项不在同一页表中(指针跨过页边界)时也停止
+     */
+    lock_swap_page(swap_nr);
+    if (*table_ptr != (unsigned long) swap_nr << 1) {  /* 等待时共享页表的进程已把页面换入 */
+        unlock_swap_page(swap_nr);
+        wake_up(&swap_lock_wait);
+        return;
+    }
+    for (nr = 1; nr < SWAP_CLUSTER; nr++) {
+        if (!((unsigned long) (table_ptr + nr) & 0xfff)) {
+            break;
+        }
+        if (table_ptr[nr] != (unsigned long) (swap_nr + nr) << 1) {
+            break;
+        }
+        if (setbit(swap_lockmap, swap_nr + nr)) {
+            break;
+        }
+    }
     /*
-     * 然后申请一页物理内存并从交换设备中读入页面号为swap_nr的页面。在用read_swap_page()把页面交换进来后，
-     * 就把交换位图中对应比特位置位。如果其原本就是置位的，说明此次是再次从交换设备中读入相同的页面，于是显示
-     * 一下警告信息。最后让页表项指向该物理页面，并设置页面已修改、用户可读写和存在标志（Dirty、U/S、R/W、P）
+     * 然后为每个页面申请一页物理内存。缺页的页面申请不到就是内存耗尽；预读的页面申请不到就少读几页。
+     * 申请内存和读盘时可能睡眠。页表可能与别的进程共享(见memory.c中的copy_page_tables())，它们
+     * 在这期间可能缺页并换入同样的页面，所以页表项要在读完后再检查
      */
-    if (!(page = get_free_page())) {
+    for (i = 0; i < nr; i++) {
+        if (!(pages[i] = (char *) get_free_page())) {
+            break;
+        }
+    }
+    if (!i) {
         oom();
     }
-    read_swap_page(swap_nr, (char *) page);     /* 在include/linux/mm.h中定义 */
-    if (setbit(swap_bitmap, swap_nr)) {
-        printk("swapping in multiply from same page\n\r");
+    while (nr > i) {
+        unlock_swap_page(swap_nr + --nr);
+    }
+    ll_rw_swap(READ, SWAP_DEV, swap_nr, pages, nr);
+    /*
+     * 读入后把页面放入交换缓存，让页表项指向该物理页面，并设置页面已修改、用户只读和存在标志（Dirty、U/S、P）。
+     * 页面内容并不比交换设备上的新，但交换缓存可能被shrink_swap_cache()清空，那时页面只能写到新的交换
+     * 页面中，所以仍然置Dirty，以免被当作可以从执行文件重新读入的页面而丢弃。页表项已被别的进程改变
+     * 的页面不再需要，直接释放
+     */
+    for (i = 0; i < nr; i++) {
+        if (table_ptr[i] == (unsigned long) (swap_nr + i) << 1) {
+            swap_cache[MAP_NR((unsigned long) pages[i])] = swap_nr + i;
+            table_ptr[i] = (unsigned long) pages[i] | (PAGE_DIRTY | PAGE_USER | PAGE_PRESENT);
+        } else {
+            free_page((unsigned long) pages[i]);
+        }
+        unlock_swap_page(swap_nr + i);
     }
-    /* 让页表指向该物理页面，并设置标志位(Dirty,U/S,R/W,P)。*/
-    *table_ptr = page | (PAGE_DIRTY | 7);
+    wake_up(&swap_lock_wait);
+}
+
+/*
+ * swap_out()中等待写出的页面。页面在交换设备上是连续的，一次写出；写完后才释放这些物理页面，
+ * 在这之前它们的交换页面是锁住的。
+ */
+struct swap_batch {
+    int first;                      /* 第一个页面的交换页面号 */
+    int nr;                         /* 页面数 */
+    char * pages[SWAP_CLUSTER];     /* 物理页面 */
+};
+
+/**
+ * 写出一批页面并释放它们
+ * @param[in]   batch   待写出的页面
+ * @retval      void
+ */
+static void flush_swap_batch(struct swap_batch * batch)
+{
+    int i;
+
+    if (!batch->nr) {
+        return;
+    }
+    ll_rw_swap(WRITE, SWAP_DEV, batch->first, batch->pages, batch->nr);
+    for (i = 0; i < batch->nr; i++) {
+        free_page((unsigned long) batch->pages[i]);
+        unlock_swap_page(batch->first + i);
+    }
+    batch->nr = 0;
+    wake_up(&swap_lock_wait);
 }
 
 /**
  * 尝试把页面交换出去(仅在swap_out中被调用)
  * 1. 页面未被修改过，则不必换出，直接释放即可，因为对应页面还可以再直接从相应映像文件中读入
- * 2. 页面被修改过，则尝试换出。
+ * 2. 页面在交换缓存中，交换设备上已有相同的内容，只需让页表项指向它的交换页面
+ * 3. 页面被修改过，则为它分配交换页面并放入batch，由swap_out()成批写出。
  * 此时交换页面号要保存在对应页表项中，并且仍需要保持页表项存在位P=0
  * @param[in]   table_ptr   页表项指针
- * @return      页面换或释放成功返回1，失败返回0
+ * @param[in]   batch       待写出的页面
+ * @return      页面被释放或放入batch返回1，不能换出返回0，batch已满或分配到的交换页面与batch不连续
+ *              时返回-1，此时应先写出batch再重试
  */
-/*static*/ int try_to_swap_out(unsigned long * table_ptr)
+/*static*/ int try_to_swap_out(unsigned long * table_ptr, struct swap_batch * batch)
 {
     unsigned long page;
     unsigned long swap_nr;
@@ -191,19 +388,39 @@ void swap_in(unsigned long *table_ptr)
         if (mem_map[MAP_NR(page)] != 1) {   /* 页面又是被共享的，不宜换出 */
             return 0;
         }
+        if ((swap_nr = swap_cache[MAP_NR(page)])) {     /* 交换缓存中的页面，不用写盘 */
+            swap_cache[MAP_NR(page)] = 0;
+            trace(TRACE_SWAP_OUT, swap_nr, (unsigned long) table_ptr, 0);
+            *table_ptr = swap_nr << 1;
+            invalidate();
+            free_page(page);
+            return 1;
+        }
+        if (batch->nr >= SWAP_CLUSTER) {
+            return -1;
+        }
         if (!(swap_nr = get_swap_page())) {     /* 申请交换页面号 */
             return 0;
         }
+        if (batch->nr && swap_nr != batch->first + batch->nr) {
+            swap_free(swap_nr);
+            return -1;
+        }
         /*
          * 对于要到交换设备中的页面，相应页表项中将存放的是（swap_nr<<1）。乘2（左移1位）是为了空出原来页表项的存在位（P）
          * 只存在位P=0并且页表项内容不为0的页面才会在交换设备中。Intel手册中明确指出，当一个表项的存在位P=0时（无效页表项），
-         * 所有其他位（位31-1）可供随意使用。下面写交换页函数write_swap_page(nr, buffer)被定义位ll_rw_page(WRITE,(nr),(buffer))
+         * 所有其他位（位31-1）可供随意使用。页面在flush_swap_batch()写出之前交换页面一直锁着，其间缺页的
+         * swap_in()会等待写出完成
          */
         /* 换出页面的页表项的内容为(swap_nr << 1)|(P = 0) */
+        setbit(swap_lockmap, swap_nr);
+        trace(TRACE_SWAP_OUT, swap_nr, (unsigned long) table_ptr, 1);
         *table_ptr = swap_nr << 1;
         invalidate();       /* 刷新CPU页变换高速缓冲 */
-        write_swap_page(swap_nr, (char *) page);
-        free_page(page);
+        if (!batch->nr) {
+            batch->first = swap_nr;
+        }
+        batch->pages[batch->nr++] = (char *) page;
         return 1;
     }
     /* 执行到这表明页面没有修改过，直接释放即可 */
@@ -214,76 +431,76 @@ void swap_in(unsigned long *table_ptr)
 }
 
 /*
- * Ok, this has a rather intricate logic - the idea is to make good
- * and fast machine code. If we didn't worry about that, things would
- * be easier.
- */
-/*
- * OK,这个函数中有一个非常复杂的逻辑，用于产生逻辑性好并且速度快的机器码。如果我们不对此操心
- * 的话，那么事情可能更容易些。
+ * 换出页面的选择采用二次机会的CLOCK算法。时钟指针(dir_entry, page_entry)在除任务0以外的线性
+ * 空间的页表项上循环移动。CPU访问页面时会置位页表项的访问位PAGE_ACCESSED，指针扫到访问位置位的
+ * 页面时只清除该位，给它第二次机会；扫到访问位已清除的页面，说明它在指针转一圈的时间内没有被访问
+ * 过，才尝试换出它。TLB中缓存的页表项不会再次置位访问位，所以清除访问位后要刷新TLB。
+ *
+ * 每次调用回收SWAP_CLUSTER个页面后才返回，多出的页面留给随后的get_free_page()使用，免得内存紧
+ * 张时每申请一页都要扫描一遍页表。被修改过的页面分配到连续的交换页面，攒成一批一次写出。
  */
+
 /**
  * 把内存页面交换到交换设备中(仅在get_free_page被调用)
- * 从线性地址64MB对应的目录项(FIRST_VM_PAGE>>10)开始，搜索整个4GB线性空间，对有效页目录
- * 二级页表指定的物理内存页面执行交换到交换设备中去的尝试。
- * @return  成功返回1，失败返回0
+ * 从时钟指针处开始扫描页表项，回收最近没有被访问的页面，回收了SWAP_CLUSTER个页面或指针已转过两
+ * 圈时返回。第一圈可能只是清除了所有页面的访问位，所以最多要转两圈。
+ * @return  回收了页面返回1，否则返回0
  */
 /*static*/ int swap_out(void)
 {
-    static int dir_entry = FIRST_VM_PAGE >> 10;	/* 即任务1的第1个目录项索引 */
-    static int page_entry = -1;
-    int counter = VM_PAGES;			/* 表示除去任务0以外的其他任务的所有页数目 */
-    int pg_table;
+    static int dir_entry = FIRST_VM_PAGE >> 10;	/* 时钟指针：页目录项索引，从任务1的第1个目录项开始 */
+    static int page_entry = -1;					/* 时钟指针：页表项索引 */
+    int counter = 2 * VM_PAGES;
+    int freed = 0, cleared = 0, ret;
+    unsigned long pg_table, * pte;
+    struct swap_batch batch;
 
-    /* 首先搜索页目录表，查找第一个有效的页目录项pg_table */
+    batch.nr = 0;
     while (counter > 0) {
-        pg_table = pg_dir[dir_entry];       /* 页目录项内容 */
-        if (pg_table & 1) {
-            break;
-        }
-        counter -= 1024;    /* 1个页表对应1024个页帧 */
-        dir_entry++;    /* 下一目录项 */
-        if (dir_entry >= 1024) {
-            /* 检索完整个页目录表，重新从头开始检索（执行不到） */
-            dir_entry = FIRST_VM_PAGE >> 10;
-        }
-    }
-    /*
-     * 在取得当前目录项中的页表指针和，针对该页表中的所有1024个页面，逐一调用交换函数try_to_swap_out()尝试把它交换出来
-     * 一旦某个页面成功交换到交换设备中就返回1。若对所有目录项的所有页表都已尝试失败，则显示“交换内存用完”的警告，并返回0
-     */
-    /* 对取到页目录项对应页表中的页表项开始逐一调用交换函数 */
-    pg_table &= 0xfffff000;     /* 页表指针（地址） */
-    while (counter-- > 0) {
-        page_entry++;       /* 页表项索引（初始为-1） */
-        /*
-         * 如果已经尝试处理完当前页表中的所有项，但还是没有找到一个能够成功地交换出的页面，即此时页表项索引大于等于1024，
-         * 则使用如同前面相同的处理方式来选出下一个存在的二级页表
-         */
-        if (page_entry >= 1024) {
-            /* 页表项索引>=1024，则取下一个有效的页目录项 */
+        if (++page_entry >= 1024) {
             page_entry = 0;
-        repeat:
-            dir_entry++;
-            if (dir_entry >= 1024) {
-                /* 检索完整个页目录表，重新从头开始检索（执行不到） */
+            if (++dir_entry >= 1024) {
                 dir_entry = FIRST_VM_PAGE >> 10;
-            }
-            pg_table = pg_dir[dir_entry];       /* 页目录结构 */
-            if (!(pg_table & 1)) {
-                if ((counter -= 1024) > 0) {
-                    goto repeat;
-                } else {
-                    break;
+                /* 指针转完一圈，下一圈要再次看到访问位，必须先刷新TLB */
+                if (cleared) {
+                    invalidate();
+                    cleared = 0;
                 }
             }
-            pg_table &= 0xfffff000;     /* 页表指针 */
         }
-        if (try_to_swap_out(page_entry + (unsigned long *) pg_table)) {
-            /* 成功换出一个页面即退出 */
-            return 1;
+        pg_table = pg_dir[dir_entry];
+        if (!(pg_table & 1)) {      /* 页表不存在，跳过整个目录项 */
+            page_entry = 1023;
+            counter -= 1024;
+            continue;
+        }
+        counter--;
+        pte = page_entry + (unsigned long *) (pg_table & 0xfffff000);
+        if (!(*pte & PAGE_PRESENT)) {
+            continue;
+        }
+        if (*pte & PAGE_ACCESSED) {     /* 最近被访问过，清除访问位，暂不换出 */
+            *pte &= ~PAGE_ACCESSED;
+            cleared = 1;
+            continue;
+        }
+        if ((ret = try_to_swap_out(pte, &batch)) < 0) {
+            /* 先写出已攒的页面，再重新检查这个页表项(写出时可能睡眠，页表项可能已改变) */
+            flush_swap_batch(&batch);
+            page_entry--;
+            continue;
+        }
+        if (ret && ++freed >= SWAP_CLUSTER) {
+            break;
         }
     }
+    flush_swap_batch(&batch);
+    if (cleared) {
+        invalidate();
+    }
+    if (freed) {
+        return 1;
+    }
     printk("Out of swap-memory\n\r");
     return 0;
 }
@@ -302,49 +519,30 @@ void swap_in(unsigned long *table_ptr)
  */
 /*
  * 在主内存中申请取得一空闲物理页面
- * 如果已经没有可用物理内存页面，则调用执行交换处理，然后再次申请页面
- * 输入：%1(ax=0) - 0；%2（LOW_MEM）字节位图管理的内存起始位置；%3（cx=PAGING_PAGES）；%4（edi=mem_map+PAGING_PAGES-1）
- * 输出：返回%0（ax=物理页面起始地址），即函数返回新页面的物理内存地址
- * 上面%4寄存器实际指向内存字节位图meme_map[]的最后一个字节。本函数从位图末端开始向前描述所有页面标志（页面总数为PAGINE_PAGES），若
- * 有页面空闲（内存位图字节为0）则返回页面地址。注意！本函数只是指出在主内存区的一页空闲物理页面，但并没有映射到某个进程的地址空间中去。
- * memory.c程序中put_page()函数即是用于把指定页面映射到某个进程的地址空间中。当然对于内核使用本函数时并不需要再使用put_page()进行映射
+ * 页面取自伙伴系统的0阶空闲链表(见memory.c中的__get_free_pages())，不再需要扫描mem_map[]。
+ * 如果已经没有可用物理内存页面，则调用执行交换处理，然后再次申请页面。注意！本函数只是指出在主内存区
+ * 的一页空闲物理页面，但并没有映射到某个进程的地址空间中去。memory.c程序中put_page()函数即是用于把
+ * 指定页面映射到某个进程的地址空间中。当然对于内核使用本函数时并不需要再使用put_page()进行映射
  * 因为内核代码和数据空间（16MB）已经对等地映射到物理地址空间中。
- * 
  */
 unsigned long get_free_page(void)
 {
-    /* 
-     * 定义一个局部寄存器变量。该变量将被保存在eax寄存器中，以便于高效访问和操作。这种定义变量的方法主要用于嵌入式汇编程序中，
-     */
-	register unsigned long __res;
+    unsigned long page;
+    int d0, d1;
 
-/* 在内存映射字节位图中从尾到头地查找值为0的字节项，然后把对应物理内存页面清零 */
-/*
- * 如果得到的页面地址大于实际物理内存容量则重新寻找。如果没有找到空闲页面则去调用执行交换处理，并重新查找，最后返回空闲物理页面地址
- */
 repeat:
-    __asm__("std ; repne ; scasb\n\t"       /* 置方向位；al(0)与对应每个页面的（di）内容比较 */
-        "jne 1f\n\t"                        /* 如果没有等于0的字节，则跳转结束（返回0） */
-        "movb $1,1(%%edi)\n\t"              /* 1 =>[1+edi]，将对应页面内存映像比特位置1 */
-        "sall $12,%%ecx\n\t"                /* 页面数*4k=相对页面起始地址 */
-        "addl %2,%%ecx\n\t"                 /* 再加上低端内存地址，得页面实际物理起始地址 */
-        "movl %%ecx,%%edx\n\t"              /* 将页面实际起始地址->edx寄存器 */
-        "movl $1024,%%ecx\n\t"              /* 寄存器ecx置计数值1024 */
-        "leal 4092(%%edx),%%edi\n\t"        /* 将4092+edx的位置->edi（该页面的末端） */
-        "rep ; stosl\n\t"                   /* 将edi所指内存清零（反方向，即将该页面清零） */
-        "movl %%edx,%%eax\n"                /* 将页面起始地址->eax（返回值） */
-        "1:"
-        :"=a" (__res)
-        :"0" (0), "i" (LOW_MEM), "c" (PAGING_PAGES),
-        "D" (mem_map + PAGING_PAGES - 1)
-        );
-    if (__res >= HIGH_MEMORY) {	/* 页面地址大于实际内存容量，重新寻找 */
-        goto repeat;
-    }
-    if (!__res && swap_out()) {	/* 没有得到空闲页面则执行交换处理,并重新查找 */
-        goto repeat;
+    if (!(page = __get_free_pages(0))) {
+        if (swap_out()) {       /* 没有得到空闲页面则执行交换处理,并重新申请 */
+            goto repeat;
+        }
+        return 0;
     }
-    return __res;       /* 返回空闲物理页面地址 */
+    /* 把页面清零 */
+    __asm__ __volatile__("cld ; rep ; stosl"
+        :"=&c" (d0), "=&D" (d1)
+        :"a" (0), "0" (1024), "1" (page)
+        :"memory");
+    return page;        /* 返回空闲物理页面地址 */
 }
 
 /**
@@ -395,7 +593,11 @@ void init_swapping(void)
         swap_size = SWAP_BITS;
     }
     swap_bitmap = (char *) get_free_page();
-    if (!swap_bitmap) {
+    swap_lockmap = (char *) get_free_page();    /* 页面已清零，即所有交换页面都没有锁住 */
+    if (!swap_bitmap || !swap_lockmap) {
+        free_page((long) swap_bitmap);          /* 0 is ok - ignored */
+        free_page((long) swap_lockmap);
+        swap_bitmap = swap_lockmap = NULL;
         printk("Unable to start swapping: out of memory :-)\n\r");
         return;
     }
@@ -409,7 +611,8 @@ void init_swapping(void)
     if (strncmp("SWAP-SPACE", swap_bitmap + 4086, 10)) {
         printk("Unable to find swap-space signature\n\r");
         free_page((long) swap_bitmap);
-        swap_bitmap = NULL;
+        free_page((long) swap_lockmap);
+        swap_bitmap = swap_lockmap = NULL;
         return;
     }
     memset(swap_bitmap + 4086, 0, 10);
@@ -430,7 +633,8 @@ void init_swapping(void)
         if (bit(swap_bitmap, i)) {
             printk("Bad swap-space bit-map\n\r");
             free_page((long) swap_bitmap);
-            swap_bitmap = NULL;
+            free_page((long) swap_lockmap);
+            swap_bitmap = swap_lockmap = NULL;
             return;
         }
     }
@@ -447,8 +651,10 @@ void init_swapping(void)
     }
     if (!j) {
         free_page((long) swap_bitmap);
-        swap_bitmap = NULL;
+        free_page((long) swap_lockmap);
+        swap_bitmap = swap_lockmap = NULL;
         return;
     }
+    swap_pages = swap_size;
     printk("Swap device ok: %d pages (%d bytes) swap-space\n\r", j, j*4096);
 }
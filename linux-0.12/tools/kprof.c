@@ -0,0 +1,152 @@
+/*
+ *  linux/tools/kprof.c
+ */
+
+/*
+ * 在主机上按函数汇总内核采样结果。
+ *
+ * 用法：kprof <采样文件> [System.map [显示行数]]
+ *
+ * 采样文件是在Linux中用kprof(KPROF_READ, ...)读出后原样写到文件中的数据(见include/sys/profile.h)，
+ * 可以用bench/kprofdump生成。
+ * System.map是链接内核时ld -M的输出。map中形如"0x地址  符号名"的行给出了全局符号的地址，每个计
+ * 数器归到起始地址不大于它的最后一个符号名下。链接时使用了-x，静态函数不在map中，它们的采样会算
+ * 到前面最近的全局函数上。
+ */
+
+#include <stdio.h>				/* 使用其中的 fprintf()函数。 */
+#include <string.h>				/* 字符串操作函数。*/
+#include <stdlib.h>				/* 含 exit、malloc、qsort 函数原型说明。*/
+#include <ctype.h>				/* 字符类型判断。*/
+
+#define KPROF_MAGIC 	0x4b50524f	/* 与include/sys/profile.h中的相同 */
+#define MAX_SYMS		4096
+
+/* 采样文件中的值都是32位小端整数，这里按字节读，与主机的字长无关 */
+static unsigned long get32(const unsigned char * p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned long) p[3] << 24);
+}
+
+struct sym {
+	unsigned long addr;
+	unsigned long count;
+	char name[64];
+};
+
+static struct sym syms[MAX_SYMS];
+static int nr_syms = 0;
+
+void die(char * str)
+{
+	fprintf(stderr, "%s\n", str);
+	exit(1);
+}
+
+static int by_addr(const void * a, const void * b)
+{
+	const struct sym * x = a, * y = b;
+
+	return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+static int by_count(const void * a, const void * b)
+{
+	const struct sym * x = a, * y = b;
+
+	return x->count < y->count ? 1 : x->count > y->count ? -1 : 0;
+}
+
+/* 读入map中limit以下的符号，按地址排序 */
+static void read_map(const char * name, unsigned long limit)
+{
+	char line[256], sym[256], rest[256];
+	unsigned long addr;
+	FILE * f;
+
+	if (!(f = fopen(name, "r"))) {
+		die("Unable to open map file");
+	}
+	while (fgets(line, sizeof(line), f)) {
+		/* 段和输入文件的行以".段名"开头，赋值语句多于两项，都不是符号 */
+		if (!isspace((unsigned char) line[0]) ||
+		    sscanf(line, " 0x%lx %255s %255s", &addr, sym, rest) != 2) {
+			continue;
+		}
+		if (!isalpha((unsigned char) sym[0]) && sym[0] != '_') {
+			continue;
+		}
+		if (addr >= limit || nr_syms >= MAX_SYMS) {
+			continue;
+		}
+		syms[nr_syms].addr = addr;
+		syms[nr_syms].count = 0;
+		sprintf(syms[nr_syms].name, "%.63s", sym);
+		nr_syms++;
+	}
+	fclose(f);
+	qsort(syms, nr_syms, sizeof(struct sym), by_addr);
+}
+
+int main(int argc, char ** argv)
+{
+	unsigned char * data;
+	unsigned long shift, nr_bins, samples, count, addr, other = 0;
+	long size;
+	int i, j, lines = 30;
+	FILE * f;
+
+	if (argc < 2 || argc > 4) {
+		die("Usage: kprof profile [System.map [lines]]");
+	}
+	if (argc == 4) {
+		lines = atoi(argv[3]);
+	}
+	if (!(f = fopen(argv[1], "rb"))) {
+		die("Unable to open profile");
+	}
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+	if (size < 16 || !(data = malloc(size)) || fread(data, 1, size, f) != size) {
+		die("Unable to read profile");
+	}
+	fclose(f);
+	if (get32(data) != KPROF_MAGIC) {
+		die("Bad magic number in profile");
+	}
+	shift = get32(data + 4);
+	nr_bins = get32(data + 8);
+	samples = get32(data + 12);
+	if (shift > 12 || size < 16 + nr_bins * 4) {
+		die("Profile is truncated");
+	}
+	read_map(argc > 2 ? argv[2] : "System.map", nr_bins << shift);
+	for (i = 0, j = -1; i < nr_bins; i++) {
+		if (!(count = get32(data + 16 + i * 4))) {
+			continue;
+		}
+		addr = (unsigned long) i << shift;
+		while (j + 1 < nr_syms && syms[j + 1].addr <= addr) {
+			j++;
+		}
+		if (j < 0) {
+			other += count;
+		} else {
+			syms[j].count += count;
+		}
+	}
+	qsort(syms, nr_syms, sizeof(struct sym), by_count);
+	printf("%lu samples, %lu bytes per bin\n", samples, 1UL << shift);
+	if (!samples) {
+		return 0;
+	}
+	for (i = 0; i < nr_syms && i < lines && syms[i].count; i++) {
+		printf("%8lu %5.1f%%  %08lx %s\n", syms[i].count,
+			100.0 * syms[i].count / samples, syms[i].addr, syms[i].name);
+	}
+	if (other) {
+		printf("%8lu %5.1f%%  (no symbol)\n", other, 100.0 * other / samples);
+	}
+	return 0;
+}
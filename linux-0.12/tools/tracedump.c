@@ -0,0 +1,168 @@
+/*
+ *  linux/tools/tracedump.c
+ */
+
+/*
+ * 在主机上解码从/dev/trace读出的事件跟踪记录(见include/linux/trace.h)。
+ *
+ * 用法：tracedump [-q] [-m MHz] 记录文件
+ *
+ * 逐条打印记录，时间是相对第一条记录的时钟周期数(给出-m时换算成微秒)；CPU没有时间戳计数器时
+ * 改用滴答数。最后汇总各类事件的次数，以及块设备请求项从入队到完成的延迟。-q只打印汇总。记录
+ * 序号不连续说明中间的记录在读出之前已被覆盖。
+ */
+
+#include <stdio.h>				/* 使用其中的 fprintf()函数。 */
+#include <string.h>				/* 字符串操作函数。*/
+#include <stdlib.h>				/* 含 exit 函数原型说明。*/
+
+#define EVENT_SIZE		32		/* struct trace_event的大小 */
+#define NR_EVENTS		9
+#define NR_REQUEST		32		/* 与kernel/blk_drv/blk.h中的相同 */
+
+#define TRACE_SWITCH	1
+#define TRACE_BLK_ISSUE	2
+#define TRACE_BLK_DONE	3
+
+static char * names[NR_EVENTS] = {
+	"?", "switch", "blk_issue", "blk_done", "no_page", "wp_page",
+	"swap_in", "swap_out", "getblk"
+};
+
+/* 记录中的值都是32位小端整数，按字节读，与主机的字长无关 */
+static unsigned long get32(const unsigned char * p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned long) p[3] << 24);
+}
+
+struct event {
+	unsigned long seq;
+	unsigned long long time;		/* 时钟周期数，没有TSC时是滴答数 */
+	unsigned long jiffies;
+	unsigned int type, pid;
+	unsigned long arg[3];
+};
+
+static void decode(const unsigned char * p, struct event * e, int use_tsc)
+{
+	e->seq = get32(p);
+	if (use_tsc) {
+		e->time = get32(p + 4) | ((unsigned long long) get32(p + 8) << 32);
+	} else {
+		e->time = get32(p + 12);
+	}
+	e->jiffies = get32(p + 12);
+	e->type = p[16] | (p[17] << 8);
+	e->pid = p[18] | (p[19] << 8);
+	e->arg[0] = get32(p + 20);
+	e->arg[1] = get32(p + 24);
+	e->arg[2] = get32(p + 28);
+}
+
+void die(char * str)
+{
+	fprintf(stderr, "%s\n", str);
+	exit(1);
+}
+
+int main(int argc, char ** argv)
+{
+	unsigned char rec[EVENT_SIZE];
+	struct event e;
+	unsigned long long start = 0, issued[NR_REQUEST], lat, max_lat = 0, sum_lat = 0;
+	unsigned long count[NR_EVENTS], next_seq = 0, lost = 0, nr_lat = 0, slot;
+	int quiet = 0, first = 1, use_tsc = 1, i;
+	double mhz = 0;
+	FILE * f;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (!strcmp(argv[i], "-q")) {
+			quiet = 1;
+		} else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+			mhz = atof(argv[++i]);
+		} else {
+			break;
+		}
+	}
+	if (i != argc - 1) {
+		die("Usage: tracedump [-q] [-m MHz] tracefile");
+	}
+	if (!(f = fopen(argv[i], "rb"))) {
+		die("Unable to open trace file");
+	}
+	memset(count, 0, sizeof(count));
+	memset(issued, 0, sizeof(issued));
+	while (fread(rec, EVENT_SIZE, 1, f) == 1) {
+		if (first) {
+			/* 时间戳为0说明CPU没有TSC，全部改用滴答数 */
+			use_tsc = get32(rec + 4) || get32(rec + 8);
+			decode(rec, &e, use_tsc);
+			start = e.time;
+			next_seq = e.seq;
+			first = 0;
+		} else {
+			decode(rec, &e, use_tsc);
+		}
+		if (e.seq != next_seq) {
+			if (!quiet) {
+				printf("*** %lu events lost\n", e.seq - next_seq);
+			}
+			lost += e.seq - next_seq;
+		}
+		next_seq = e.seq + 1;
+		if (e.type >= NR_EVENTS) {
+			e.type = 0;
+		}
+		count[e.type]++;
+		slot = (e.arg[0] >> 16) % NR_REQUEST;
+		if (e.type == TRACE_BLK_ISSUE) {
+			issued[slot] = e.time + 1;
+		} else if (e.type == TRACE_BLK_DONE && issued[slot]) {
+			lat = e.time + 1 - issued[slot];
+			issued[slot] = 0;
+			sum_lat += lat;
+			nr_lat++;
+			if (lat > max_lat) {
+				max_lat = lat;
+			}
+		}
+		if (quiet) {
+			continue;
+		}
+		if (mhz > 0 && use_tsc) {
+			printf("%12.1f", (e.time - start) / mhz);
+		} else {
+			printf("%12llu", e.time - start);
+		}
+		printf(" %5u %-9s", e.pid, names[e.type]);
+		switch (e.type) {
+			case TRACE_SWITCH:
+				printf(" -> %lu (state %lu)\n", e.arg[0], e.arg[1]);
+				break;
+			case TRACE_BLK_ISSUE:
+				printf(" req %lu dev %04lx sector %lu %s %lu\n", e.arg[0] >> 16,
+					e.arg[0] & 0xffff, e.arg[1], (e.arg[2] >> 16) ? "write" : "read",
+					e.arg[2] & 0xffff);
+				break;
+			case TRACE_BLK_DONE:
+				printf(" req %lu dev %04lx%s\n", e.arg[0] >> 16, e.arg[0] & 0xffff,
+					e.arg[1] ? "" : " error");
+				break;
+			default:
+				printf(" %08lx %08lx %08lx\n", e.arg[0], e.arg[1], e.arg[2]);
+		}
+	}
+	fclose(f);
+	printf("\n%-9s %8s\n", "event", "count");
+	for (i = 1; i < NR_EVENTS; i++) {
+		printf("%-9s %8lu\n", names[i], count[i]);
+	}
+	if (lost) {
+		printf("%-9s %8lu\n", "lost", lost);
+	}
+	if (nr_lat) {
+		printf("\nblock request latency (%s): avg %llu max %llu over %lu requests\n",
+			use_tsc ? "cycles" : "ticks", sum_lat / nr_lat, max_lat, nr_lat);
+	}
+	return 0;
+}